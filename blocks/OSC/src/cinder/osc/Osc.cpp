@@ -31,6 +31,12 @@
 #include "Osc.h"
 #include "cinder/Log.h"
 
+#include <map>
+
+#if defined( __linux__ )
+#include <sys/socket.h>
+#endif
+
 using namespace std;
 using namespace asio;
 using namespace asio::ip;
@@ -888,7 +894,8 @@ void Bundle::setTimetag( uint64_t ntp_time )
 	uint64_t a = htonll( ntp_time );
 	ByteArray<8> b;
 	memcpy( b.data(), reinterpret_cast<uint8_t*>( &a ), 8 );
-	mDataBuffer->insert( mDataBuffer->begin() + 12, b.begin(), b.end() );
+	// Overwrite the immediate tag written by initializeBuffer rather than inserting a second one
+	std::copy( b.begin(), b.end(), mDataBuffer->begin() + 12 );
 }
 	
 void Bundle::initializeBuffer()
@@ -912,6 +919,11 @@ ByteBufferRef Bundle::getSharedBuffer() const
 	return mDataBuffer;
 }
 	
+////////////////////////////////////////////////////////////////////////////////////////
+//// BundleWriter
+
+constexpr size_t BundleWriter::HEADER_SIZE;
+	
 ////////////////////////////////////////////////////////////////////////////////////////
 //// SenderBase
 	
@@ -1114,8 +1126,10 @@ void ReceiverBase::setListener( const std::string &address, ListenerFn listener
 	});
 	if( foundListener != mListeners.end() )
 		foundListener->second = listener;
-	else
+	else {
 		mListeners.push_back( { address, listener } );
+		compileListeners();
+	}
 }
 
 void ReceiverBase::removeListener( const std::string &address )
@@ -1125,8 +1139,69 @@ void ReceiverBase::removeListener( const std::string &address )
 	[address]( const std::pair<std::string, ListenerFn> &listener ) {
 		  return address == listener.first;
 	});
-	if( foundListener != mListeners.end() )
+	if( foundListener != mListeners.end() ) {
 		mListeners.erase( foundListener );
+		compileListeners();
+	}
+}
+
+void ReceiverBase::compileListeners()
+{
+	mPatternListeners.clear();
+	
+	// Build with sorted child maps first, then flatten so each node's edges sit together
+	std::vector<std::map<char, uint32_t>> children( 1 );
+	std::vector<int32_t> listeners( 1, -1 );
+	
+	for( size_t i = 0; i < mListeners.size(); ++i ) {
+		auto &address = mListeners[i].first;
+		if( address.find_first_of( "?*[]{}" ) != std::string::npos ) {
+			mPatternListeners.push_back( i );
+			continue;
+		}
+		
+		uint32_t node = 0;
+		for( char c : address ) {
+			auto found = children[node].find( c );
+			if( found == children[node].end() ) {
+				uint32_t child = static_cast<uint32_t>( children.size() );
+				children[node][c] = child;
+				children.emplace_back();
+				listeners.push_back( -1 );
+				node = child;
+			}
+			else
+				node = found->second;
+		}
+		listeners[node] = static_cast<int32_t>( i );
+	}
+	
+	mTrieNodes.assign( children.size(), TrieNode() );
+	mTrieEdges.clear();
+	for( size_t node = 0; node < children.size(); ++node ) {
+		mTrieNodes[node].firstEdge = static_cast<uint32_t>( mTrieEdges.size() );
+		mTrieNodes[node].edgeCount = static_cast<uint32_t>( children[node].size() );
+		mTrieNodes[node].listener = listeners[node];
+		for( auto &edge : children[node] )
+			mTrieEdges.push_back( { edge.first, edge.second } );
+	}
+}
+
+int32_t ReceiverBase::findListener( const std::string &address ) const
+{
+	if( mTrieNodes.empty() )
+		return -1;
+	
+	uint32_t node = 0;
+	for( char c : address ) {
+		auto begin = mTrieEdges.begin() + mTrieNodes[node].firstEdge;
+		auto end = begin + mTrieNodes[node].edgeCount;
+		auto edge = std::find_if( begin, end, [c]( const TrieEdge &e ) { return e.character == c; } );
+		if( edge == end )
+			return -1;
+		node = edge->node;
+	}
+	return mTrieNodes[node].listener;
 }
 
 void ReceiverBase::dispatchMethods( uint8_t *data, uint32_t size, const asio::ip::address &senderIpAddress )
@@ -1137,17 +1212,28 @@ void ReceiverBase::dispatchMethods( uint8_t *data, uint32_t size, const asio::ip
 		return;
 	
 	std::lock_guard<std::mutex> lock( mListenerMutex );
-	// iterate through all the messages and find matches with registered methods
+	// find the exact listener in the trie, and pattern match only the listeners with wildcards
 	for( auto & message : messages ) {
 		bool dispatchedOnce = false;
 		auto &address = message.getAddress();
 		message.mSenderIpAddress = senderIpAddress;
-		for( auto & listener : mListeners ) {
-			if( patternMatch( address, listener.first ) ) {
-				listener.second( message );
+		int32_t exact = findListener( address );
+		for( auto index : mPatternListeners ) {
+			// keep registration order between the two kinds
+			if( exact >= 0 && static_cast<size_t>( exact ) < index ) {
+				mListeners[exact].second( message );
+				dispatchedOnce = true;
+				exact = -1;
+			}
+			if( patternMatch( address, mListeners[index].first ) ) {
+				mListeners[index].second( message );
 				dispatchedOnce = true;
 			}
 		}
+		if( exact >= 0 ) {
+			mListeners[exact].second( message );
+			dispatchedOnce = true;
+		}
 		if( ! dispatchedOnce ) {
 			if( mDisregardedAddresses.count( address ) == 0 ) {
 				mDisregardedAddresses.insert( address );
@@ -1159,13 +1245,17 @@ void ReceiverBase::dispatchMethods( uint8_t *data, uint32_t size, const asio::ip
 	
 bool ReceiverBase::decodeData( uint8_t *data, uint32_t size, std::vector<Message> &messages, uint64_t timetag ) const
 {
-	if( ! memcmp( data, "#bundle\0", 8 ) ) {
+	if( size >= 16 && ! memcmp( data, "#bundle\0", 8 ) ) {
 		data += 8; size -= 8;
 		
 		uint64_t timestamp;
 		memcpy( &timestamp, data, 8 ); data += 8; size -= 8;
 		
 		while( size != 0 ) {
+			if( size < 4 ) {
+				CI_LOG_E( "Problem Parsing Bundle: Truncated segment size." );
+				return false;
+			}
 			uint32_t seg_size;
 			memcpy( &seg_size, data, 4 );
 			data += 4; size -= 4;
@@ -1313,6 +1403,8 @@ ReceiverUdp::ReceiverUdp( UdpSocketRef socket )
 {
 }
 	
+ReceiverUdp::~ReceiverUdp() = default;
+	
 void ReceiverUdp::bindImpl()
 {
 	asio::error_code ec;
@@ -1330,6 +1422,99 @@ void ReceiverUdp::setAmountToReceive( uint32_t amountToReceive )
 	mAmountToReceive.store( amountToReceive );
 }
 
+bool ReceiverUdp::handleSocketError( const asio::error_code &error, const protocol::endpoint &endpoint, const OnSocketErrorFn &onSocketErrorFn )
+{
+	if( onSocketErrorFn )
+		return onSocketErrorFn( error, endpoint );
+	
+	CI_LOG_E( "Udp Message: " << error.message() << " - Code: " << error.value()
+			  << ", Endpoint: " << endpoint.address().to_string() );
+	CI_LOG_W( "Exiting Listen loop." );
+	return false;
+}
+
+#if defined( __linux__ )
+
+struct ReceiveBatch {
+	static const size_t SIZE = 32;
+	
+	ReceiveBatch( size_t datagramSize )
+	: datagramSize( datagramSize ), data( SIZE * ( datagramSize + 1 ) ), endpoints( SIZE )
+	{
+		for( size_t i = 0; i < SIZE; ++i ) {
+			vectors[i].iov_base = datagram( i );
+			vectors[i].iov_len = datagramSize;
+			headers[i].msg_hdr = msghdr();
+			headers[i].msg_hdr.msg_iov = &vectors[i];
+			headers[i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+	
+	//! Every datagram gets a spare byte so it can be null terminated, like the streambuf path.
+	uint8_t* datagram( size_t i ) { return data.data() + i * ( datagramSize + 1 ); }
+	
+	//! recvmmsg overwrites the name lengths, so they are reset before every call.
+	void prepare()
+	{
+		for( size_t i = 0; i < SIZE; ++i ) {
+			headers[i].msg_hdr.msg_name = endpoints[i].data();
+			headers[i].msg_hdr.msg_namelen = static_cast<socklen_t>( endpoints[i].capacity() );
+		}
+	}
+	
+	size_t								datagramSize;
+	std::vector<uint8_t>				data;
+	std::array<mmsghdr, SIZE>			headers;
+	std::array<iovec, SIZE>				vectors;
+	std::vector<udp::endpoint>			endpoints;
+};
+
+void ReceiverUdp::listen( OnSocketErrorFn onSocketErrorFn )
+{
+	if ( ! mSocket->is_open() )
+		return;
+	
+	uint32_t prepareAmount = mAmountToReceive.load();
+	if( ! mBatch || mBatch->datagramSize != prepareAmount )
+		mBatch.reset( new ReceiveBatch( prepareAmount ) );
+	
+	// Only wait for the socket to become readable, then take everything queued on it in batches.
+	mSocket->async_receive( asio::null_buffers(),
+	[&, onSocketErrorFn]( const asio::error_code &error, size_t ) {
+		if( error ) {
+			if( ! handleSocketError( error, udp::endpoint(), onSocketErrorFn ) )
+				return;
+		}
+		else {
+			int received;
+			do {
+				mBatch->prepare();
+				received = ::recvmmsg( mSocket->native_handle(), mBatch->headers.data(), ReceiveBatch::SIZE, MSG_DONTWAIT, nullptr );
+				for( int i = 0; i < received; ++i ) {
+					auto &endpoint = mBatch->endpoints[i];
+					endpoint.resize( mBatch->headers[i].msg_hdr.msg_namelen );
+					
+					auto size = mBatch->headers[i].msg_len;
+					auto data = mBatch->datagram( i );
+					data[ size ] = 0;
+					dispatchMethods( data, size, endpoint.address() );
+				}
+			} while( received == static_cast<int>( ReceiveBatch::SIZE ) );
+			
+			if( received < 0 && errno != EAGAIN && errno != EWOULDBLOCK ) {
+				if( ! handleSocketError( asio::error_code( errno, asio::error::get_system_category() ), udp::endpoint(), onSocketErrorFn ) )
+					return;
+			}
+		}
+		listen( std::move( onSocketErrorFn ) );
+	});
+}
+
+#else
+
+struct ReceiveBatch {
+};
+
 void ReceiverUdp::listen( OnSocketErrorFn onSocketErrorFn )
 {
 	if ( ! mSocket->is_open() )
@@ -1341,16 +1526,8 @@ void ReceiverUdp::listen( OnSocketErrorFn onSocketErrorFn )
 	mSocket->async_receive_from( tempBuffer, *uniqueEndpoint,
 	[&, uniqueEndpoint, onSocketErrorFn]( const asio::error_code &error, size_t bytesTransferred ) {
 		if( error ) {
-			if( onSocketErrorFn ) {
-				if( ! onSocketErrorFn( error, *uniqueEndpoint ) )
-					return;
-			}
-			else {
-				CI_LOG_E( "Udp Message: " << error.message() << " - Code: " << error.value()
-						  << ", Endpoint: " << uniqueEndpoint->address().to_string() );
-				CI_LOG_W( "Exiting Listen loop." );
+			if( ! handleSocketError( error, *uniqueEndpoint, onSocketErrorFn ) )
 				return;
-			}
 		}
 		else {
 			mBuffer.commit( bytesTransferred );
@@ -1363,6 +1540,8 @@ void ReceiverUdp::listen( OnSocketErrorFn onSocketErrorFn )
 		listen( std::move( onSocketErrorFn ) );
 	});
 }
+
+#endif
 	
 void ReceiverUdp::closeImpl()
 {
@@ -36,6 +36,8 @@
 
 #include <set>
 #include <mutex>
+#include <cstring>
+#include <initializer_list>
 
 #include "cinder/Buffer.h"
 #include "cinder/app/App.h"
@@ -421,6 +423,133 @@ class Bundle {
 	friend class SenderUdp;
 };
 	
+namespace detail {
+	
+//! Rounds n up to the 4 byte alignment OSC uses for every field.
+constexpr size_t pad4( size_t n ) { return ( n + 3 ) & ~size_t( 3 ); }
+	
+constexpr size_t sum( std::initializer_list<size_t> sizes )
+{
+	size_t total = 0;
+	for( auto size : sizes )
+		total += size;
+	return total;
+}
+	
+inline uint8_t* writeBigEndian32( uint8_t *out, uint32_t v )
+{
+	out[0] = uint8_t( v >> 24 ); out[1] = uint8_t( v >> 16 ); out[2] = uint8_t( v >> 8 ); out[3] = uint8_t( v );
+	return out + 4;
+}
+	
+inline uint8_t* writeBigEndian64( uint8_t *out, uint64_t v )
+{
+	return writeBigEndian32( writeBigEndian32( out, uint32_t( v >> 32 ) ), uint32_t( v ) );
+}
+	
+//! Type tag, encoded size and encoding of the fixed size argument types MessageWriter supports.
+template<typename T> struct WriterArg;
+template<> struct WriterArg<int32_t> {
+	static constexpr char tag = 'i'; static constexpr size_t size = 4;
+	static uint8_t* write( uint8_t *out, int32_t v ) { return writeBigEndian32( out, uint32_t( v ) ); }
+};
+template<> struct WriterArg<int64_t> {
+	static constexpr char tag = 'h'; static constexpr size_t size = 8;
+	static uint8_t* write( uint8_t *out, int64_t v ) { return writeBigEndian64( out, uint64_t( v ) ); }
+};
+template<> struct WriterArg<float> {
+	static constexpr char tag = 'f'; static constexpr size_t size = 4;
+	static uint8_t* write( uint8_t *out, float v ) { uint32_t bits; std::memcpy( &bits, &v, 4 ); return writeBigEndian32( out, bits ); }
+};
+template<> struct WriterArg<double> {
+	static constexpr char tag = 'd'; static constexpr size_t size = 8;
+	static uint8_t* write( uint8_t *out, double v ) { uint64_t bits; std::memcpy( &bits, &v, 8 ); return writeBigEndian64( out, bits ); }
+};
+	
+} // namespace detail
+	
+//! Encodes messages with a fixed argument list straight into a caller supplied buffer,
+//! for addresses that are sent every frame. The address and type tag are laid out once
+//! on construction, the type tag and argument sizes are known at compile time, and
+//! write() only copies that prefix and the arguments, so nothing is allocated per message.
+//! Supports int32_t, int64_t, float and double arguments. Use Message for anything else.
+template<typename... Args>
+class MessageWriter {
+  public:
+	//! ',' then one tag per argument, null terminated and padded.
+	static constexpr size_t TYPE_TAG_SIZE = detail::pad4( sizeof...( Args ) + 2 );
+	static constexpr size_t ARGS_SIZE = detail::sum( { size_t( 0 ), detail::WriterArg<Args>::size... } );
+	
+	MessageWriter() = default;
+	explicit MessageWriter( const std::string &address )
+	: mPrefix( detail::pad4( address.size() + 1 ) + TYPE_TAG_SIZE, 0 )
+	{
+		std::copy( address.begin(), address.end(), mPrefix.begin() );
+		
+		const char tags[] = { ',', detail::WriterArg<Args>::tag... };
+		std::copy( tags, tags + sizeof( tags ), mPrefix.end() - TYPE_TAG_SIZE );
+	}
+	
+	//! Returns the encoded size of every message this writer produces, without the size prefix.
+	size_t size() const { return mPrefix.size() + ARGS_SIZE; }
+	
+	//! Writes the message to \a out, which must have room for size() bytes. Returns one past the last byte written.
+	uint8_t* write( uint8_t *out, Args... args ) const
+	{
+		std::memcpy( out, mPrefix.data(), mPrefix.size() );
+		return writeArgs( out + mPrefix.size(), args... );
+	}
+	
+  private:
+	static uint8_t* writeArgs( uint8_t *out ) { return out; }
+	template<typename T, typename... Rest>
+	static uint8_t* writeArgs( uint8_t *out, T v, Rest... rest ) { return writeArgs( detail::WriterArg<T>::write( out, v ), rest... ); }
+	
+	ByteBuffer mPrefix;
+};
+	
+template<typename... Args> constexpr size_t MessageWriter<Args...>::TYPE_TAG_SIZE;
+template<typename... Args> constexpr size_t MessageWriter<Args...>::ARGS_SIZE;
+	
+//! Lays out a bundle in a caller supplied buffer, for use with MessageWriter.
+class BundleWriter {
+  public:
+	//! "#bundle" and the timetag.
+	static constexpr size_t HEADER_SIZE = 16;
+	
+	BundleWriter() = default;
+	//! Starts a bundle in \a data, which must have room for at least HEADER_SIZE bytes and outlive the writer.
+	BundleWriter( uint8_t *data, size_t capacity, uint64_t timetag )
+	: mData( data ), mCapacity( capacity ), mSize( HEADER_SIZE )
+	{
+		std::memcpy( mData, "#bundle", 8 );
+		detail::writeBigEndian64( mData + 8, timetag );
+	}
+	
+	//! Appends a size prefixed message. Returns false, writing nothing, if it doesn't fit.
+	template<typename... Args>
+	bool append( const MessageWriter<Args...> &message, Args... args )
+	{
+		size_t size = message.size();
+		if( ! mData || mSize + 4 + size > mCapacity )
+			return false;
+		
+		message.write( detail::writeBigEndian32( mData + mSize, uint32_t( size ) ), args... );
+		mSize += 4 + size;
+		return true;
+	}
+	
+	//! Returns the number of bytes written so far, header included.
+	size_t size() const { return mSize; }
+	//! Returns true if nothing has been appended since the header.
+	bool empty() const { return mSize <= HEADER_SIZE; }
+	
+  private:
+	uint8_t		*mData = nullptr;
+	size_t		mCapacity = 0;
+	size_t		mSize = 0;
+};
+	
 using PacketFramingRef = std::shared_ptr<class PacketFraming>;
 	
 class PacketFraming {
@@ -665,17 +794,41 @@ public:
 	bool decodeMessage( uint8_t *data, uint32_t size, std::vector<Message> &messages, uint64_t timetag = 0 ) const;
 	//! Matches the addresses of messages based on the OSC spec.
 	bool patternMatch( const std::string &lhs, const std::string &rhs ) const;
+	//! Rebuilds the address trie from mListeners. Called with mListenerMutex held whenever the listeners change.
+	void compileListeners();
+	//! Returns the index in mListeners of the listener registered for exactly \a address, or -1.
+	int32_t findListener( const std::string &address ) const;
 	
 	//! Abstract bind implementation function.
 	virtual void bindImpl() = 0;
 	//! Abstract close implementation function.
 	virtual void closeImpl() = 0;
 	
+	//! Node of the compiled address trie. A node's edges are contiguous in mTrieEdges.
+	struct TrieNode {
+		uint32_t	firstEdge = 0;
+		uint32_t	edgeCount = 0;
+		int32_t		listener = -1;
+	};
+	struct TrieEdge {
+		char		character;
+		uint32_t	node;
+	};
+	
 	Listeners				mListeners;
 	std::mutex				mListenerMutex;
 	std::set<std::string>	mDisregardedAddresses;
+	
+	//! Listener addresses without wildcards, looked up one character at a time.
+	std::vector<TrieNode>	mTrieNodes;
+	std::vector<TrieEdge>	mTrieEdges;
+	//! Indices into mListeners of the addresses with wildcards, which still need patternMatch.
+	std::vector<size_t>		mPatternListeners;
 };
 	
+//! Preallocated buffers for batched UDP receives, see ReceiverUdp::listen.
+struct ReceiveBatch;
+	
 //! Represents an OSC Receiver(called a \a client in the OSC spec) and implements the UDP transport
 //!	networking layer.
 class ReceiverUdp : public ReceiverBase {
@@ -699,10 +852,12 @@ class ReceiverUdp : public ReceiverBase {
 	//! constructed udp::socket shared_ptr \a socket. Use this for extra configuration and or sharing sockets
 	//! between sender and receiver.
 	ReceiverUdp( UdpSocketRef socket );
-	virtual ~ReceiverUdp() = default;
+	virtual ~ReceiverUdp();
 	
 	//! Commits the socket to asynchronously listen and begin to receive from outside connections.
-	//! /a onSocketErrorFn will be called in the case that any socket error is propagated.
+	//! /a onSocketErrorFn will be called in the case that any socket error is propagated. On Linux
+	//! every datagram waiting when the socket becomes readable is taken with as few recvmmsg calls
+	//! as possible, into buffers that are reused from one batch to the next.
 	void listen( OnSocketErrorFn onSocketErrorFn );
 	//! Sets the amount of bytes to reserve for the datagrams being received.
 	void setAmountToReceive( uint32_t amountToReceive );
@@ -716,10 +871,13 @@ class ReceiverUdp : public ReceiverBase {
 	//! Closes the underlying UDP socket. If an error occurs, the SocketTranportErrorFn will be called with a
 	//! default constructed endpoint.
 	void closeImpl() override;
+	//! Reports \a error through \a onSocketErrorFn, or logs it. Returns true if listening should continue.
+	bool handleSocketError( const asio::error_code &error, const protocol::endpoint &endpoint, const OnSocketErrorFn &onSocketErrorFn );
 	
 	UdpSocketRef						mSocket;
 	asio::ip::udp::endpoint				mLocalEndpoint;
 	asio::streambuf						mBuffer;
+	std::unique_ptr<ReceiveBatch>		mBatch;
 	
 	std::atomic<uint32_t>				mAmountToReceive;
 	
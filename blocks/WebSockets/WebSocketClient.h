@@ -36,6 +36,7 @@
 #pragma once
 
 #include "WebSocketConnection.h"
+#include "WebSocketMessagePool.h"
 
 #include "websocketpp/config/asio_no_tls_client.hpp"
 #include "websocketpp/client.hpp"
@@ -43,11 +44,15 @@
 class WebSocketClient : public WebSocketConnection
 {
 public:
-	typedef websocketpp::client<websocketpp::config::asio_client>	Client;
+	// Incoming messages are recycled rather than allocated per frame, see WebSocketMessagePool.h
+	typedef websocketpp::client<WebSocketPooledClientConfig>		Client;
 	typedef Client::connection_ptr									ConnectionRef;
-	typedef websocketpp::config::asio_client::message_type::ptr		MessageRef;
+	typedef WebSocketPooledClientConfig::message_type::ptr			MessageRef;
 
 	WebSocketClient();
+	// Runs on an io_service driven elsewhere, e.g. a shared thread pool. Handlers are then
+	// called on that service's threads and poll() does nothing.
+	WebSocketClient( asio::io_service& service );
 	~WebSocketClient();
 
 	void			connect( const std::string& uri );
@@ -62,6 +67,9 @@ public:
 	const Client&	getClient() const;
 protected:
 	Client			mClient;
+	bool			mExternalService;
+	
+	void			init();
 	
 	void			onClose( Client* client, websocketpp::connection_hdl handle );
 	void			onFail( Client* client, websocketpp::connection_hdl handle );
@@ -77,7 +77,7 @@ using namespace std;
 WebSocketConnection::WebSocketConnection()
 : mCloseEventHandler( nullptr ), mFailEventHandler( nullptr ), 
 mHttpEventHandler( nullptr ), mInterruptEventHandler( nullptr ), 
-mMessageEventHandler( nullptr ), mOpenEventHandler( nullptr ), 
+mMessageEventHandler( nullptr ), mMessageViewEventHandler( nullptr ), mOpenEventHandler( nullptr ), 
 mPingEventHandler( nullptr ), /*mSocket( nullptr ),*/ mSocketInitEventHandler( nullptr ),
 mTcpPostInitEventHandler( nullptr ), mTcpPreInitEventHandler( nullptr ), 
 mValidateEventHandler( nullptr ), mWriteEventHandler( nullptr )
@@ -91,6 +91,7 @@ WebSocketConnection::~WebSocketConnection()
 	disconnectHttpEventHandler();
 	disconnectInterruptEventHandler();
 	disconnectMessageEventHandler();
+	disconnectMessageViewEventHandler();
 	disconnectOpenEventHandler();
 	disconnectPingEventHandler();
 	disconnectSocketInitEventHandler();
@@ -160,6 +161,16 @@ void WebSocketConnection::disconnectMessageEventHandler()
 	mMessageEventHandler = nullptr;
 }
 
+void WebSocketConnection::connectMessageViewEventHandler( const function<void( const WebSocketMessageView& )>& eventHandler )
+{
+	mMessageViewEventHandler = eventHandler;
+}
+
+void WebSocketConnection::disconnectMessageViewEventHandler()
+{
+	mMessageViewEventHandler = nullptr;
+}
+
 void WebSocketConnection::connectOpenEventHandler( const function<void()>& eventHandler )
 {
 	mOpenEventHandler = eventHandler;
@@ -50,12 +50,24 @@
 #define _WEBSOCKETPP_CPP11_RANDOM_DEVICE_
 #define BOOST_DATE_TIME_NO_LIB
 #define BOOST_REGEX_NO_LIB
+#if ! defined( ASIO_STANDALONE )
+	#define ASIO_STANDALONE 1
+#endif
 
 //#include "asio.hpp"
 #include "websocketpp/common/random.hpp"
 #include "websocketpp/common/thread.hpp"
 #include "websocketpp/common/connection_hdl.hpp"
 
+#include <cstdint>
+
+// A received message, borrowed from the connection. Only valid until the handler returns.
+struct WebSocketMessageView
+{
+	const uint8_t*	data;
+	size_t			size;
+};
+
 class WebSocketConnection
 {
 public:
@@ -109,6 +121,15 @@ public:
 	void		connectMessageEventHandler( const std::function<void( std::string )>& eventHandler );
 	void		disconnectMessageEventHandler();
 
+	// Takes precedence over the message handler and doesn't copy the payload
+	template<typename T, typename Y>
+	inline void	connectMessageViewEventHandler( T eventHandler, Y* eventHandlerObject )
+	{
+		connectMessageViewEventHandler( std::bind( eventHandler, eventHandlerObject, std::placeholders::_1 ) );
+	}
+	void		connectMessageViewEventHandler( const std::function<void( const WebSocketMessageView& )>& eventHandler );
+	void		disconnectMessageViewEventHandler();
+
 	template<typename T, typename Y>
 	inline void	connectOpenEventHandler( T eventHandler, Y* eventHandlerObject )
 	{
@@ -173,6 +194,7 @@ protected:
 	std::function<void()>				mHttpEventHandler;
 	std::function<void()>				mInterruptEventHandler;
 	std::function<void( std::string )>	mMessageEventHandler;
+	std::function<void( const WebSocketMessageView& )>	mMessageViewEventHandler;
 	std::function<void()>				mOpenEventHandler;
 	std::function<void( std::string )>	mPingEventHandler;
 	std::function<void()>				mSocketInitEventHandler;
@@ -0,0 +1,216 @@
+#pragma once
+
+// Message recycling for websocketpp. The stock con_msg_manager allocates a fresh
+// message, payload string and shared_ptr control block for every frame. This one
+// keeps a few messages per connection and hands them out again once released, with
+// their payload capacity intact, and places the control blocks in a block pool, so
+// once a connection has seen its largest message, receiving costs no allocations.
+
+#include "WebSocketConnection.h"
+
+#include "websocketpp/config/asio_no_tls_client.hpp"
+#include "websocketpp/message_buffer/message.hpp"
+
+#include <mutex>
+#include <vector>
+
+// Fixed size blocks on a free list. Requests too big for a block, or made while the
+// list is empty, go to the heap. Thread safe, messages are released on any thread.
+class WebSocketBlockPool
+{
+public:
+	static const size_t kBlockSize	= 128;
+	static const size_t kMaxBlocks	= 32;
+
+	WebSocketBlockPool()
+	{
+		mFree.reserve( kMaxBlocks );
+	}
+
+	~WebSocketBlockPool()
+	{
+		for ( void* block : mFree ) {
+			::operator delete( block );
+		}
+	}
+
+	void* allocate( size_t size )
+	{
+		if ( size > kBlockSize ) {
+			return ::operator new( size );
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			if ( !mFree.empty() ) {
+				void* block = mFree.back();
+				mFree.pop_back();
+				return block;
+			}
+		}
+		return ::operator new( kBlockSize );
+	}
+
+	void deallocate( void* block, size_t size )
+	{
+		if ( size <= kBlockSize ) {
+			std::lock_guard<std::mutex> lock( mMutex );
+			if ( mFree.size() < kMaxBlocks ) {
+				mFree.push_back( block );
+				return;
+			}
+		}
+		::operator delete( block );
+	}
+protected:
+	std::mutex			mMutex;
+	std::vector<void*>	mFree;
+};
+
+// Allocator over a shared block pool, used for the shared_ptr control blocks
+template<typename T>
+class WebSocketPoolAllocator
+{
+public:
+	typedef T value_type;
+
+	WebSocketPoolAllocator( const std::shared_ptr<WebSocketBlockPool>& pool ) : mPool( pool ) {}
+	template<typename U>
+	WebSocketPoolAllocator( const WebSocketPoolAllocator<U>& other ) : mPool( other.mPool ) {}
+
+	T*		allocate( size_t n ) { return static_cast<T*>( mPool->allocate( n * sizeof( T ) ) ); }
+	void	deallocate( T* p, size_t n ) { mPool->deallocate( p, n * sizeof( T ) ); }
+
+	template<typename U>
+	bool	operator==( const WebSocketPoolAllocator<U>& other ) const { return mPool == other.mPool; }
+	template<typename U>
+	bool	operator!=( const WebSocketPoolAllocator<U>& other ) const { return mPool != other.mPool; }
+
+	std::shared_ptr<WebSocketBlockPool>	mPool;
+};
+
+// Connection message manager, one per connection as with the stock one
+template<typename message>
+class WebSocketMessagePool : public websocketpp::lib::enable_shared_from_this<WebSocketMessagePool<message>>
+{
+public:
+	typedef WebSocketMessagePool<message>		type;
+	typedef websocketpp::lib::shared_ptr<type>	ptr;
+	typedef websocketpp::lib::weak_ptr<type>	weak_ptr;
+	typedef typename message::ptr				message_ptr;
+
+	static const size_t kMaxMessages	= 8;
+	static const size_t kPayloadSize	= 16384;	// Reserved up front, matches the connection's read buffer
+
+	WebSocketMessagePool()
+	: mBlocks( std::make_shared<WebSocketBlockPool>() )
+	{
+		mFree.reserve( kMaxMessages );
+	}
+
+	~WebSocketMessagePool()
+	{
+		for ( message* msg : mFree ) {
+			delete msg;
+		}
+	}
+
+	message_ptr get_message()
+	{
+		return wrap( take() );
+	}
+
+	message_ptr get_message( websocketpp::frame::opcode::value op, size_t size )
+	{
+		message* msg = take();
+		msg->set_opcode( op );
+		msg->get_raw_payload().reserve( size );
+		return wrap( msg );
+	}
+
+	// Called when the last reference to a message goes. Returns false if the pool is full
+	// and the message should be deleted instead.
+	bool recycle( message* msg )
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if ( mFree.size() >= kMaxMessages ) {
+			return false;
+		}
+		mFree.push_back( msg );
+		return true;
+	}
+protected:
+	// Returns messages to whichever pool is still alive, or deletes them
+	struct Recycler
+	{
+		weak_ptr mPool;
+
+		void operator()( message* msg ) const
+		{
+			ptr pool = mPool.lock();
+			if ( !pool || !pool->recycle( msg ) ) {
+				delete msg;
+			}
+		}
+	};
+
+	message* take()
+	{
+		message* msg = nullptr;
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			if ( !mFree.empty() ) {
+				msg = mFree.back();
+				mFree.pop_back();
+			}
+		}
+
+		if ( msg == nullptr ) {
+			msg = new message( type::shared_from_this() );
+			msg->get_raw_payload().reserve( kPayloadSize );
+			return msg;
+		}
+
+		// Back to how a new message starts out, keeping the payload's capacity
+		msg->set_prepared( false );
+		msg->set_fin( true );
+		msg->set_terminal( false );
+		msg->set_compressed( false );
+		msg->set_header( std::string() );
+		msg->get_raw_payload().clear();
+		return msg;
+	}
+
+	message_ptr wrap( message* msg )
+	{
+		return message_ptr( msg, Recycler{ type::shared_from_this() }, WebSocketPoolAllocator<message>( mBlocks ) );
+	}
+
+	std::mutex								mMutex;
+	std::vector<message*>					mFree;
+	std::shared_ptr<WebSocketBlockPool>		mBlocks;
+};
+
+// Endpoint message manager, hands each connection its own pool
+template<typename con_msg_manager>
+class WebSocketEndpointPool
+{
+public:
+	typedef typename con_msg_manager::ptr con_msg_man_ptr;
+
+	con_msg_man_ptr get_manager() const
+	{
+		return con_msg_man_ptr( websocketpp::lib::make_shared<con_msg_manager>() );
+	}
+};
+
+// The stock asio client with pooled messages
+struct WebSocketPooledClientConfig : public websocketpp::config::asio_client
+{
+	typedef WebSocketPooledClientConfig	type;
+	typedef websocketpp::config::asio_client base;
+
+	typedef websocketpp::message_buffer::message<WebSocketMessagePool>	message_type;
+	typedef WebSocketMessagePool<message_type>							con_msg_manager_type;
+	typedef WebSocketEndpointPool<con_msg_manager_type>					endpoint_msg_manager_type;
+};
@@ -48,6 +48,13 @@ FlowField::FlowField ( Fluid::Sim * fluid )
     }
 }
 
+void FlowField::Bake ( float rate )
+{
+    Alpha.Bake ( rate );
+    ColorWeight.Bake ( rate );
+    Weight.Bake ( rate );
+}
+
 void FlowField::Inspect ( )
 {
     if ( ui::CollapsingHeader ( "Flow Field" ) )
@@ -18,6 +18,7 @@ public:
     FlowField           ( Fluid::Sim * fluid );
     
     void                Draw    ( );
+    void                Bake    ( float rate );
     void                Inspect ( );
 
     Time::FloatProperty Alpha{0.0f};
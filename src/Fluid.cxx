@@ -82,6 +82,36 @@ namespace Fluid
         return tree;
     }
     
+    void EvaluateEmitters ( const Time::EmitterTable& table, float t, std::vector<Force>& forces )
+    {
+        using Table = Time::EmitterTable;
+        
+        std::size_t count = table.Size();
+        forces.resize ( count );
+        
+        // One property at a time, so each pass only walks that property's arrays
+        auto& offsets = table.Offsets();
+        for ( std::size_t i = 0; i < count; i++ ) forces[i].Position = table.Position().At ( i, t ) + offsets[i];
+        for ( std::size_t i = 0; i < count; i++ ) forces[i].Velocity = table.Velocity().At ( i, t );
+        for ( std::size_t i = 0; i < count; i++ ) forces[i].Color = table.Color().At ( i, t );
+        for ( std::size_t i = 0; i < count; i++ ) forces[i].Radius = table.Radius().At ( i, t );
+        for ( std::size_t i = 0; i < count; i++ ) forces[i].Temperature = table.Temperature().At ( i, t );
+        for ( std::size_t i = 0; i < count; i++ ) forces[i].Density = table.Density().At ( i, t );
+        
+        for ( auto& direct : table.Directs() )
+        {
+            const Time::Emitter& e = *table.Emitters()[direct.Index];
+            Force& f = forces[direct.Index];
+            
+            if ( direct.Fields & Table::kPosition )     f.Position      = e.PositionAt ( t );
+            if ( direct.Fields & Table::kVelocity )     f.Velocity      = e.VelocityAt ( t );
+            if ( direct.Fields & Table::kColor )        f.Color         = e.ColorAt ( t );
+            if ( direct.Fields & Table::kRadius )       f.Radius        = e.RadiusAt ( t );
+            if ( direct.Fields & Table::kTemperature )  f.Temperature   = e.TemperatureAt ( t );
+            if ( direct.Fields & Table::kDensity )      f.Density       = e.DensityAt ( t );
+        }
+    }
+    
     ScopedFboDraw::ScopedFboDraw ( const ci::gl::FboRef& buffer )
     : _buffer ( buffer )
     {
@@ -285,6 +315,18 @@ namespace Fluid
         _temporalForces.back().Radius   *= _scale;
     }
     
+    void Sim::AddTemporalForces ( const std::vector<Force>& forces )
+    {
+        std::size_t first = _temporalForces.size();
+        _temporalForces.insert ( _temporalForces.end(), forces.begin(), forces.end() );
+        
+        for ( std::size_t i = first; i < _temporalForces.size(); i++ )
+        {
+            _temporalForces[i].Position *= _scale;
+            _temporalForces[i].Radius   *= _scale;
+        }
+    }
+    
     void Sim::Clear ( float clearAlpha )
     {
         _densityBuffer->Clear();
@@ -298,6 +340,150 @@ namespace Fluid
         ClearBuffer( _velocityAddBuffer );
     }
     
+    static void ReadBuffer ( const gl::FboRef& buffer, GLenum format, int channels, std::vector<float>& result )
+    {
+        result.resize ( buffer->getWidth() * buffer->getHeight() * channels );
+        
+        gl::ScopedFramebuffer fbo { buffer };
+        glPixelStorei ( GL_PACK_ALIGNMENT, 1 );
+        glReadPixels ( 0, 0, buffer->getWidth(), buffer->getHeight(), format, GL_FLOAT, result.data() );
+    }
+    
+    static void WriteTexture ( const gl::TextureRef& texture, GLenum format, const std::vector<float>& data )
+    {
+        gl::ScopedTextureBind tex { texture };
+        glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
+        glTexSubImage2D ( texture->getTarget(), 0, 0, 0, texture->getWidth(), texture->getHeight(), format, GL_FLOAT, data.data() );
+    }
+    
+    void Sim::CaptureState ( State& state ) const
+    {
+        state.Size = ivec2 ( _gridWidth, _gridHeight );
+        
+        ReadBuffer ( _densityBuffer->SourceBuffer(), GL_RGBA, 4, state.Density );
+        ReadBuffer ( _velocityBuffer->SourceBuffer(), GL_RGB, 3, state.Velocity );
+        ReadBuffer ( _temperatureBuffer->SourceBuffer(), GL_RED, 1, state.Temperature );
+    }
+    
+    bool Sim::RestoreState ( const State& state )
+    {
+        std::size_t n = state.Size.x * state.Size.y;
+        
+        if ( state.Size != ivec2 ( _gridWidth, _gridHeight ) ||
+             state.Density.size() != n * 4 || state.Velocity.size() != n * 3 || state.Temperature.size() != n )
+        {
+            std::cout << "Fluid state is " << state.Size << ", simulation is " << ivec2 ( _gridWidth, _gridHeight ) << ". Ignoring.\n";
+            return false;
+        }
+        
+        WriteTexture ( _densityBuffer->SourceTexture(), GL_RGBA, state.Density );
+        WriteTexture ( _velocityBuffer->SourceTexture(), GL_RGB, state.Velocity );
+        WriteTexture ( _temperatureBuffer->SourceTexture(), GL_RED, state.Temperature );
+        
+        return true;
+    }
+    
+    int ChannelCount ( Field field )
+    {
+        switch ( field )
+        {
+            case Field::Density     : return 4;
+            case Field::Velocity    : return 3;
+            case Field::Temperature : return 1;
+        }
+        return 0;
+    }
+    
+    static GLenum PixelFormat ( Field field )
+    {
+        switch ( field )
+        {
+            case Field::Density     : return GL_RGBA;
+            case Field::Velocity    : return GL_RGB;
+            case Field::Temperature : return GL_RED;
+        }
+        return GL_RGBA;
+    }
+    
+    PingPongBuffer& Sim::BufferFor ( Field field ) const
+    {
+        switch ( field )
+        {
+            case Field::Velocity    : return *_velocityBuffer;
+            case Field::Temperature : return *_temperatureBuffer;
+            default                 : return *_densityBuffer;
+        }
+    }
+    
+    void Sim::CaptureField ( Field field, const ivec2& size, std::vector<float>& result )
+    {
+        auto& buffer = BufferFor ( field );
+        
+        if ( size == ivec2 ( _gridWidth, _gridHeight ) )
+        {
+            ReadBuffer ( buffer.SourceBuffer(), PixelFormat ( field ), ChannelCount ( field ), result );
+            return;
+        }
+        
+        if ( !_captureBuffer || _captureBuffer->getSize() != size )
+        {
+            auto fmt = gl::Texture::Format().internalFormat( GL_RGBA32F ).minFilter( GL_LINEAR ).magFilter( GL_LINEAR );
+            _captureBuffer = gl::Fbo::create ( size.x, size.y, gl::Fbo::Format().colorTexture( fmt ).disableDepth() );
+        }
+        
+        {
+            gl::ScopedFramebuffer fbo { _captureBuffer };
+            gl::ScopedViewport viewport { size };
+            gl::ScopedMatrices matrices;
+            gl::ScopedBlend blend { false };
+            gl::setMatricesWindow ( size );
+            gl::draw ( buffer.SourceTexture(), Rectf ( vec2(0), vec2(size) ) );
+        }
+        
+        ReadBuffer ( _captureBuffer, PixelFormat ( field ), ChannelCount ( field ), result );
+    }
+    
+    void Sim::WriteField ( Field field, const ivec2& size, const std::vector<float>& data )
+    {
+        auto& buffer = BufferFor ( field );
+        
+        std::size_t n = static_cast<std::size_t>( size.x * size.y * ChannelCount ( field ) );
+        if ( data.size() != n ) return;
+        
+        if ( size == ivec2 ( _gridWidth, _gridHeight ) )
+        {
+            WriteTexture ( buffer.SourceTexture(), PixelFormat ( field ), data );
+            return;
+        }
+        
+        if ( !_uploadTexture || _uploadTexture->getSize() != size )
+        {
+            auto fmt = gl::Texture::Format().internalFormat( GL_RGBA32F ).minFilter( GL_LINEAR ).magFilter( GL_LINEAR );
+            _uploadTexture = gl::Texture2d::create ( size.x, size.y, fmt );
+        }
+        
+        WriteTexture ( _uploadTexture, PixelFormat ( field ), data );
+        
+        gl::ScopedFramebuffer fbo { buffer.SourceBuffer() };
+        gl::ScopedViewport viewport { buffer.SourceBuffer()->getSize() };
+        gl::ScopedMatrices matrices;
+        gl::ScopedBlend blend { false };
+        gl::setMatricesWindow ( buffer.SourceBuffer()->getSize() );
+        gl::draw ( _uploadTexture, Rectf ( vec2(0), vec2(buffer.SourceBuffer()->getSize()) ) );
+    }
+    
+    void Sim::Bake ( float rate )
+    {
+        Gravity.Bake ( rate );
+        SmokeBuoyancy.Bake ( rate );
+        SmokeWeight.Bake ( rate );
+        AmbientTemperature.Bake ( rate );
+        Alpha.Bake ( rate );
+        Metalness.Bake ( rate );
+        _matCapPerturbation.Bake ( rate );
+        _matCapExponent.Bake ( rate );
+    }
+    
     void Sim::Inspect ( )
     {
         if ( ui::CollapsingHeader( "Rendering Params" ) )
@@ -332,7 +518,7 @@ namespace Fluid
     
     void Sim::UpdateAttractors ( )
     {
-        auto attrs = _sequencer.GetAttractors();
+        auto& attrs = _sequencer.GetAttractors();
         float t = _sequencer.Time();
         
         for ( int i = 0; i < 4; i++ )
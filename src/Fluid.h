@@ -11,6 +11,7 @@
 
 #include "PingPongBuffer.h"
 #include "cinder/Json.h"
+#include <Time/EmitterTable.h>
 #include <Time/Force.h>
 #include <Time/Sequencer.h>
 
@@ -45,6 +46,29 @@ namespace Fluid
             
     };
     
+    // Every emitter in table at sequencer time t, in scene order, written over forces. Each property is
+    // read for all emitters at once from the packed tracks, then the emitters the table lists as direct
+    // fill in their overridden or unbaked properties. Keeps the vector's storage.
+    void                            EvaluateEmitters ( const Time::EmitterTable& table, float t, std::vector<Force>& forces );
+    
+    enum class Field
+    {
+        Density,            // RGBA
+        Velocity,           // RGB
+        Temperature         // R
+    };
+    
+    int                             ChannelCount ( Field field );
+    
+    // CPU copy of the simulation fields at grid resolution, rows bottom up as read from GL
+    struct State
+    {
+        ci::ivec2                   Size;
+        std::vector<float>          Density;        // RGBA
+        std::vector<float>          Velocity;       // RGB
+        std::vector<float>          Temperature;    // R
+    };
+    
     struct ScopedFboDraw
     {
         ScopedFboDraw               ( const ci::gl::FboRef& buffer );
@@ -72,10 +96,21 @@ namespace Fluid
         
         void                        AddConstantForce    ( const Force& force );
         void                        AddTemporalForce    ( const Force& force );
+        void                        AddTemporalForces   ( const std::vector<Force>& forces );
         
         void                        Clear               ( float clearAlpha = 1.0f );
         void                        Update              ( double dt );
         
+        // Bakes the animated parameters at rate samples per second, see Time::PropertyT::Bake
+        void                        Bake                ( float rate );
+        
+        void                        CaptureState        ( State& state ) const;
+        bool                        RestoreState        ( const State& state );
+        
+        // Single field resampled to size, for streaming to viewers
+        void                        CaptureField        ( Field field, const ci::ivec2& size, std::vector<float>& result );
+        void                        WriteField          ( Field field, const ci::ivec2& size, const std::vector<float>& data );
+        
         void                        Draw                ( const ci::Rectf& bounds );
         void                        DrawBuffers         ( );
         void                        DrawVelocity        ( const ci::Rectf& bounds );
@@ -123,6 +158,7 @@ namespace Fluid
         void                        RenderQuad          ( int width, int height ) const;
         void                        ResetGLState        ( ) const;
         void                        ClearBuffer         ( const ci::gl::FboRef& buffer, const ci::ColorAf& clearColor = ci::ColorAf::black() );
+        PingPongBuffer&             BufferFor           ( Field field ) const;
         
         ci::gl::GlslProgRef         _advectShader;
         ci::gl::GlslProgRef         _jacobiShader;
@@ -143,6 +179,9 @@ namespace Fluid
         ci::gl::FboRef              _colorAddBuffer;
         ci::gl::FboRef              _velocityAddBuffer;
         
+        ci::gl::FboRef              _captureBuffer;
+        ci::gl::Texture2dRef        _uploadTexture;
+        
         std::vector<Force>          _constantForces;
         std::vector<Force>          _temporalForces;
         
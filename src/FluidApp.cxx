@@ -19,12 +19,6 @@
 using namespace ci;
 using namespace ci::app;
 
-#ifdef CINDER_COCOA
-static uint64_t kLastWrite = 0;
-#else
-static fs::file_time_type kLastWrite;
-#endif
-
 #define STANDALONE_DEMO
 
 namespace
@@ -45,6 +39,16 @@ namespace
     static std::string       kMetalOSCAddress;
     static std::string       kFlowOSCAddress;
     static std::string       kParticlesOSCAddress;
+    
+    // Slave clock slewing. Errors beyond kMaxSlewError are stepped, anything
+    // smaller is absorbed by nudging the sequencer rate by at most kMaxSlewRate.
+    const float              kMaxSlewError  = 1.0f;
+    const float              kMaxSlewRate   = 0.05f;
+    const float              kSlewGain      = 0.5f;
+    const float              kRateSmoothing = 0.05f;
+    
+    // Seconds mapped elements take to ease back to their animation once the encoders go away
+    const float              kEncoderRelease = 1.0f;
 }
 
 void FluidApp::Init ( app::App::Settings * settings )
@@ -87,7 +91,7 @@ void FluidApp::OnSetup ( )
     #endif
     
     _particles.Init( 9 );
-    _particles.Alpha.ValueAtFrame(0) = 0.0f;
+    _particles.Alpha.MutableValueAtFrame(0) = 0.0f;
     
     _encoders = std::make_unique<RotaryEncoders>();
     
@@ -99,15 +103,47 @@ void FluidApp::OnSetup ( )
         
         auto host   = config["OSCEndpoint"].getValue();
         auto port   = config["OSCPort"].getValue<int>();
-        auto peerIP = config["PeerIP"].getValue();
+        auto peerIP = config.hasChild( "PeerIP" ) ? config["PeerIP"].getValue() : "";
         
+        // Must come before the first channel opens
+        if ( config.hasChild( "NetworkThreads" ) ) Net::Reactor::Configure ( config["NetworkThreads"].getValue<int>() );
+        if ( config.hasChild( "BakeRate" ) ) _sequencer.BakeRate = config["BakeRate"].getValue<float>();
+        
+        _peerIP = peerIP;
         _oscChannel = std::make_unique<Time::OSCChannel>( host, port );
-        _isLeft = config["IsLeft"].getValue<bool>();
-        _edgeInset = config["EdgeInset"].getValue<int>();
+        _sequencer.SetOSCChannel ( _oscChannel.get() );
+        _audioAddresses.fill ( Time::OSCChannel::kInvalidAddress );
+        {
+            Time::SendPolicy policy;
+            policy.Epsilon = config.hasChild( "OSCEpsilon" ) ? config["OSCEpsilon"].getValue<float>() : 0.002f;
+            policy.MinInterval = 1.0f / std::max ( config.hasChild( "OSCMaxRate" ) ? config["OSCMaxRate"].getValue<float>() : 30.0f, 1.0f );
+            
+            _oscChannel->SetDefaultPolicy ( policy );
+            if ( config.hasChild( "OSCLatency" ) ) _oscChannel->BundleLatency = config["OSCLatency"].getValue<float>();
+        }
         _syncFrameInterval = config["SyncFrameInterval"].getValue<int>();
         _encoderMappings.clear();
         
-        Time::Element::kIsLeft = _isLeft;
+        {
+            // Older configs only say which side they are
+            bool isLeft = config.hasChild( "IsLeft" ) && config["IsLeft"].getValue<bool>();
+            int edgeInset = config.hasChild( "EdgeInset" ) ? config["EdgeInset"].getValue<int>() : 0;
+            
+            _slot.Name = config.hasChild( "Slot" ) ? config["Slot"].getValue() : ( isLeft ? "Left" : "Right" );
+            _slot.Obstacles = _slot.Name == "Left" ? "ObstaclesLeft" : "ObstaclesRight";
+            _slot.AudioSide = _slot.Name == "Left" ? "left" : "right";
+            _slot.EdgeInsets = ivec2 ( edgeInset );
+            
+            if ( config.hasChild( "Slots." + _slot.Name ) )
+            {
+                auto& s = config["Slots"][_slot.Name];
+                if ( s.hasChild( "Obstacles" ) ) _slot.Obstacles = s["Obstacles"].getValue();
+                if ( s.hasChild( "AudioSide" ) ) _slot.AudioSide = s["AudioSide"].getValue();
+                if ( s.hasChild( "EdgeInsets" ) ) _slot.EdgeInsets = ivec2 ( s["EdgeInsets"][0].getValue<int>(), s["EdgeInsets"][1].getValue<int>() );
+            }
+            
+            Time::Element::kObstacleSet = _slot.Obstacles;
+        }
         
         if ( config.hasChild( "SceneFile" ) )
         {
@@ -124,28 +160,77 @@ void FluidApp::OnSetup ( )
             _encoderMappings.push_back( mappings );
         }
         
-        if ( _isLeft )
+        int clockPort = config.hasChild( "ClockPort" ) ? config["ClockPort"].getValue<int>() : 9888;
+        
+        // Every node listens. Whoever is master fans /sync and /reload out to the rest.
+        _syncTransport = std::make_unique<Time::OSCChannel> ( "", 9889, Time::OSCChannel::Mode::Incoming );
+        _syncTransport->Listen ( [&] ( float time )
         {
-            _syncTransport = std::make_unique<Time::OSCChannel> ( peerIP, 9889, Time::OSCChannel::Mode::Outgoing );
-        }else
+            if ( _isMaster ) return;
+            
+            // Once the clock sync has locked it takes care of this smoothly
+            float estimate;
+            if ( _syncTransport->EstimatePeerTime ( estimate ) ) return;
+            
+            float delta = std::abs ( _sequencer.Time() - time );
+            if ( delta > 0.5f )
+            {
+                _sequencer.StepTo( time );
+            }
+        });
+        _syncTransport->Listen ( "/reload", [&]
         {
-            _syncTransport = std::make_unique<Time::OSCChannel> ( "", 9889, Time::OSCChannel::Mode::Incoming );
-            _syncTransport->Listen ( [&] ( float time )
+            if ( !_isMaster ) _reloadRequested = true;
+        });
+        _syncTransport->ServeClock ( clockPort );
+        _syncTransport->SyncClock ( "", clockPort );
+        
+        {
+            Net::Cluster::Options options;
+            options.Slot = _slot.Name;
+            options.Priority = _slot.Name == "Left" ? 1 : 0;
+            
+            if ( config.hasChild( "NodeId" ) ) options.Id = config["NodeId"].getValue();
+            if ( config.hasChild( "Priority" ) ) options.Priority = config["Priority"].getValue<int>();
+            if ( config.hasChild( "DiscoveryGroup" ) ) options.Group = config["DiscoveryGroup"].getValue();
+            if ( config.hasChild( "DiscoveryPort" ) ) options.Port = config["DiscoveryPort"].getValue<int>();
+            if ( !peerIP.empty() ) options.StaticPeers.push_back ( peerIP );
+            if ( config.hasChild( "Peers" ) )
             {
-                float delta = std::abs ( _sequencer.Time() - time );
-                if ( delta > 0.5f )
-                {
-                    _sequencer.StepTo( time );
-                }
+                for ( auto& p : config["Peers"] ) options.StaticPeers.push_back ( p.getValue() );
+            }
+            
+            _cluster = std::make_unique<Net::Cluster> ( options );
+            _cluster->OnChange ( std::bind ( &FluidApp::OnClusterChanged, this ) );
+        }
+        
+        {
+            int bootstrapPort = config.hasChild( "BootstrapPort" ) ? config["BootstrapPort"].getValue<int>() : 9890;
+            _bootstrapOnStart = config.hasChild( "BootstrapOnStart" ) ? config["BootstrapOnStart"].getValue<bool>() : true;
+            
+            _bootstrap = std::make_unique<Net::Bootstrap> ( bootstrapPort );
+            _bootstrap->Serve ( [&] ( Net::Snapshot& s )
+            {
+                s.Time = _sequencer.Time();
+                _fluid->CaptureState ( s.Fields );
             });
         }
         
         {
-            std::string dir = _isLeft ? "left" : "right";
+            std::string dir = _slot.AudioSide;
             kSmokeOSCAddress = "/bp/source_volume/FD_Smoke_" + dir + "_48k";
             kMetalOSCAddress = "/bp/source_volume/FD_Metal_" + dir + "_48k";
             kFlowOSCAddress = "/bp/source_volume/FD_FlowField_" + dir + "_48k";
             kParticlesOSCAddress = "/bp/source_volume/FD_Particles_" + dir + "_48k";
+            
+            // Encoded once here so the per frame sends only write the values
+            _audioAddresses =
+            {{
+                _oscChannel->Address ( kSmokeOSCAddress ),
+                _oscChannel->Address ( kMetalOSCAddress ),
+                _oscChannel->Address ( kParticlesOSCAddress ),
+                _oscChannel->Address ( kFlowOSCAddress )
+            }};
         }
         
         
@@ -154,10 +239,14 @@ void FluidApp::OnSetup ( )
         _errorList.push_back( "Error loading config JSON: " + std::string ( e.what() ) );
     }
     
-    if ( _isLeft )
+#ifndef STANDALONE_DEMO
+    _sceneWatcher = std::make_unique<Time::SceneWatcher> ( kFolderToWatch / kFileToWatch, _sequencer.BakeRate );
+#endif
+    
+    _sequencer.OnLoop ( [&]
     {
-        _sequencer.OnLoop ( [&] { _syncTransport->SendEvent( "/sync", _sequencer.Time() ); });
-    }
+        if ( _isMaster && _syncTransport ) _syncTransport->SendEvent( "/sync", _sequencer.Time() );
+    });
 
     _flowField->Alpha = 0.6f;
     _flowField->ColorWeight = 0.85f;
@@ -272,16 +361,14 @@ void FluidApp::InitFluidAtScale ( float scale )
             }
         }
         
-        if ( !topLeft && _edgeInset > 0 )
+        if ( !topLeft && ( _slot.EdgeInsets.x > 0 || _slot.EdgeInsets.y > 0 ) )
         {
             gl::ScopedMatrices m;
             gl::setMatricesWindow ( rect.getSize(), topLeft );
             
-            Rectf box { 0.0f, 0.0f, (float)_edgeInset, (float)_fluid->Size().y };
-            gl::drawSolidRect ( box );
-            
-            box += vec2( rect.getWidth() - _edgeInset, 0 );
-            gl::drawSolidRect ( box );
+            float height = (float)_fluid->Size().y;
+            gl::drawSolidRect ( Rectf { 0.0f, 0.0f, (float)_slot.EdgeInsets.x, height } );
+            gl::drawSolidRect ( Rectf { rect.getWidth() - _slot.EdgeInsets.y, 0.0f, rect.getWidth(), height } );
         }
     };
     
@@ -291,38 +378,45 @@ void FluidApp::InitFluidAtScale ( float scale )
 void FluidApp::OnUpdate ( )
 {
 #ifndef STANDALONE_DEMO
-    if ( app::getElapsedFrames() == 1 || app::getElapsedFrames() % 60 == 0 )
+    if ( _sceneWatcher )
     {
-        try
+        if ( _reloadRequested )
         {
-            auto fullFile = kFolderToWatch / kFileToWatch;
-            if ( fs::exists ( fullFile ) )
-            {
-                auto n = fs::last_write_time( fullFile );
-                if ( n != kLastWrite )
-                {
-                    _sequencer.Load ( fullFile );
-                
-                    JsonTree t { loadFile ( fullFile ) };
-                    if ( t.hasChild ( "Flow.Alpha" ) ) _flowField->Alpha = t["Flow.Alpha"];
-                    if ( t.hasChild ( "Particles.Alpha" ) ) _particles.Alpha = t["Particles.Alpha"];
-                    if ( t.hasChild ( "Density.Alpha" ) ) _fluid->Alpha = t["Density.Alpha"];
-                    if ( t.hasChild ( "Metalness.Alpha" ) ) _fluid->Metalness = t["Metalness.Alpha"];
-                
-                    kLastWrite = n;
-                    OnReload    ( );
-                }
-            }
+            _reloadRequested = false;
+            _sceneWatcher->Reload ( );
         }
-        catch ( const std::exception& e )
+        
+        // Parsed and baked on the watcher's thread, all that's left here is patching in what changed
+        if ( auto scene = _sceneWatcher->Take() )
         {
-            std::cout << e.what() << std::endl;
+            try
+            {
+                auto& t = scene->Tree;
+                if ( t.hasChild ( "Flow.Alpha" ) ) _flowField->Alpha = t["Flow.Alpha"];
+                if ( t.hasChild ( "Particles.Alpha" ) ) _particles.Alpha = t["Particles.Alpha"];
+                if ( t.hasChild ( "Density.Alpha" ) ) _fluid->Alpha = t["Density.Alpha"];
+                if ( t.hasChild ( "Metalness.Alpha" ) ) _fluid->Metalness = t["Metalness.Alpha"];
+            }
+            catch ( const std::exception& e )
+            {
+                std::cout << e.what() << std::endl;
+            }
+            
+            OnReload    ( _sequencer.Apply ( scene ) );
         }
     }
 #else
 
 #endif
     
+    // OnClusterChanged asks the master for its state as soon as it knows who that is. Fall
+    // back to PeerIP if discovery hasn't turned anyone up by now.
+    if ( _bootstrapOnStart && !_bootstrapFallback && !_isMaster && app::getElapsedSeconds() > 3.0 )
+    {
+        _bootstrapFallback = true;
+        if ( RequestPeerState ( ) ) _bootstrapOnStart = false;
+    }
+    
     _fluid->ObstaclesDirty = true;
     
     if ( _running )
@@ -333,7 +427,15 @@ void FluidApp::OnUpdate ( )
         _sequencer.StepBy( 1.0 / 60.0f );
         ApplyEncoders ( );
         
-        if ( _isLeft && _syncFrameInterval > 0 )
+        if ( _isMaster && _syncTransport )
+        {
+            _syncTransport->PublishTime ( _sequencer.Time() );
+        }else
+        {
+            SlewToPeer ( );
+        }
+        
+        if ( _isMaster && _syncFrameInterval > 0 )
         {
             if ( ( app::getElapsedFrames() % ( _syncFrameInterval ) ) == 0 )
             {
@@ -341,12 +443,23 @@ void FluidApp::OnUpdate ( )
             }
         }
         
-        for ( auto& e : _sequencer.GetEmitters() )
-        {
-            _fluid->AddTemporalForce( { e->PositionAt(t), e->VelocityAt(t), e->ColorAt(t), e->RadiusAt(t), e->TemperatureAt(t), e->DensityAt(t) } );
-        }
+        _emitterTable.Update ( _sequencer.GetEmitters() );
+        Fluid::EvaluateEmitters ( _emitterTable, t, _emitterForces );
+        _fluid->AddTemporalForces ( _emitterForces );
 #endif
 
+        // Globals follow the sequencer's bake rate, only ones edited since are resampled, and only
+        // looked at once some property has changed
+        if ( _globalsBakeRate != _sequencer.BakeRate || _globalsRevisions != Time::PropertyRevisions() )
+        {
+            _fluid->Bake ( _sequencer.BakeRate );
+            _particles.Bake ( _sequencer.BakeRate );
+            _flowField->Bake ( _sequencer.BakeRate );
+            
+            _globalsBakeRate = _sequencer.BakeRate;
+            _globalsRevisions = Time::PropertyRevisions();
+        }
+        
         _particles.DensityAlphaMultiplier = _fluid->Alpha.ValueAtTime(t);
         _particles.Update ( 1.0 / 60.0, _fluid->GetVelocity() );
         _fluid->Update ( 1.0 / 60.0 );
@@ -355,6 +468,34 @@ void FluidApp::OnUpdate ( )
     }
 }
 
+void FluidApp::SlewToPeer ( )
+{
+    float peerTime;
+    if ( !_syncTransport || !_syncTransport->EstimatePeerTime ( peerTime ) )
+    {
+        _sequencer.Rate = 1.0f;
+        return;
+    }
+    
+    // Shortest way round the loop
+    float duration = _sequencer.Duration;
+    float error = std::fmod ( _sequencer.Time() - peerTime, duration );
+    if ( error >  duration * 0.5f ) error -= duration;
+    if ( error < -duration * 0.5f ) error += duration;
+    
+    _syncError = error;
+    
+    if ( std::abs ( error ) > kMaxSlewError )
+    {
+        _sequencer.StepTo ( std::fmod ( peerTime + duration, duration ) );
+        _sequencer.Rate = 1.0f;
+    }else
+    {
+        float target = 1.0f - glm::clamp ( error * kSlewGain, -kMaxSlewRate, kMaxSlewRate );
+        _sequencer.Rate = lerp ( _sequencer.Rate, target, kRateSmoothing );
+    }
+}
+
 void FluidApp::ApplyEncoders ( )
 {
     if ( _encoders->IsConnected() )
@@ -365,8 +506,11 @@ void FluidApp::ApplyEncoders ( )
             auto& options = _encoderMappings[i];
             for ( auto& o : options )
             {
-                auto elem = _elementCache[o];
-                if ( elem && elem->RadiusAt(t) > 0.01f )
+                auto it = _elementCache.find ( o );
+                if ( it == _elementCache.end() ) continue;
+                
+                auto& elem = it->second;
+                if ( elem->RadiusAt(t) > 0.01f )
                 {
                     switch ( elem->GetType() )
                     {
@@ -374,14 +518,14 @@ void FluidApp::ApplyEncoders ( )
                         {
                             auto e = std::static_pointer_cast<Time::Emitter>( elem );
                             float a = _encoders->ValueAt ( i ) * M_PI * 2.0f;
-                            e->Velocity().OverrideValue ( vec2 { std::cos( a ), std::sin( a ) } );
+                            e->Velocity().Override ( vec2 { std::cos( a ), std::sin( a ) } );
                             break;
                         }
                             
                         case Time::ElementType::Obstacle :
                         {
                             auto e = std::static_pointer_cast<Time::Obstacle>( elem );
-                            e->Rotation().OverrideValue ( _encoders->ValueAt ( i ) * M_PI * 2.0f );
+                            e->Rotation().Override ( _encoders->ValueAt ( i ) * M_PI * 2.0f );
                             break;
                         }
                             
@@ -390,65 +534,131 @@ void FluidApp::ApplyEncoders ( )
                 }
             }
         }
+        
+        _encodersHeld = true;
+    }else if ( _encodersHeld )
+    {
+        for ( auto& c : _elementCache )
+        {
+            auto& elem = c.second;
+            if ( elem->GetType() == Time::ElementType::Emitter ) std::static_pointer_cast<Time::Emitter>( elem )->Velocity().Release ( kEncoderRelease );
+            if ( elem->GetType() == Time::ElementType::Obstacle ) std::static_pointer_cast<Time::Obstacle>( elem )->Rotation().Release ( kEncoderRelease );
+        }
+        
+        _encodersHeld = false;
     }
 }
 
 void FluidApp::BroadcastOSCChanges ( )
 {
-    static float kLastSmokeValue    = -1.0f;
-    static float kLastMetalValue    = -1.0f;
-    static float kLastParticleValue = -1.0f;
-    static float kLastFlowValue     = -1.0f;
-    
     if ( _oscChannel )
     {
         float t = _sequencer.Time();
         
-        float smoke     = _fluid->Alpha.ValueAtTime( t );
-        float metal     = _fluid->Metalness.ValueAtTime( t );
-        float particles = _particles.Alpha.ValueAtTime( t );
-        float flow      = _flowField->Alpha.ValueAtTime( t );
-        
-        bool smokeChanged       = smoke     != kLastSmokeValue;
-        bool metalChanged       = metal     != kLastMetalValue;
-        bool particlesChanged   = particles != kLastParticleValue;
-        bool flowChanged        = flow      != kLastFlowValue;
-        
-        if ( smokeChanged     ) _oscChannel->SendEvent ( kSmokeOSCAddress, smoke );
-        if ( metalChanged     ) _oscChannel->SendEvent ( kMetalOSCAddress, metal );
-        if ( particlesChanged ) _oscChannel->SendEvent ( kParticlesOSCAddress, particles );
-        if ( flowChanged      ) _oscChannel->SendEvent ( kFlowOSCAddress, flow );
-        
-        kLastSmokeValue    = smoke;
-        kLastMetalValue    = metal;
-        kLastParticleValue = particles;
-        kLastFlowValue     = flow;
+        // Unchanged and sub-threshold values are filtered by the channel, the rest go out as one bundle
+        _oscChannel->Queue ( _audioAddresses[0], _fluid->Alpha.ValueAtTime( t ) );
+        _oscChannel->Queue ( _audioAddresses[1], _fluid->Metalness.ValueAtTime( t ) );
+        _oscChannel->Queue ( _audioAddresses[2], _particles.Alpha.ValueAtTime( t ) );
+        _oscChannel->Queue ( _audioAddresses[3], _flowField->Alpha.ValueAtTime( t ) );
+        _oscChannel->Flush ( );
     }
 }
 
-void FluidApp::OnReload ( )
+void FluidApp::OnClusterChanged ( )
 {
-    std::cout << "Reloading!\n";
+    bool wasMaster = _isMaster;
+    _isMaster = _cluster->IsMaster();
+    
+    std::vector<std::string> peers;
+    for ( auto& p : _cluster->Peers() ) peers.push_back ( p.Address );
+    _syncTransport->SetPeers ( peers );
+    
+    auto master = _cluster->Master();
+    _syncTransport->SetClockPeer ( _isMaster ? "" : master.Address );
     
-    _errorList.clear();
-    _elementCache.clear();
+    // Only once, from a master that isn't us. A node that wins the election keeps waiting in
+    // case it loses it again.
+    if ( _bootstrapOnStart && _cluster->HasMaster() && !_isMaster )
+    {
+        if ( RequestPeerState ( ) ) _bootstrapOnStart = false;
+    }
+    
+    if ( _isMaster )
+    {
+        _sequencer.Rate = 1.0f;
+        _syncTransport->PublishTime ( _sequencer.Time() );
+        _syncTransport->SendEvent( "/sync", _sequencer.Time() );
+    }
     
-    for ( auto& e : _encoderMappings )
+    if ( _isMaster != wasMaster )
+    {
+        std::cout << "This node is now " << ( _isMaster ? "master" : "following " + master.Id ) << std::endl;
+    }
+}
+
+std::string FluidApp::PeerStateSource ( ) const
+{
+    if ( _cluster && _cluster->HasMaster() && !_isMaster )
     {
-        for ( auto& m : e )
+        auto address = _cluster->Master().Address;
+        if ( !address.empty() ) return address;
+    }
+    
+    return _peerIP;
+}
+
+bool FluidApp::RequestPeerState ( )
+{
+    auto source = PeerStateSource();
+    if ( !_bootstrap || source.empty() ) return false;
+    
+    return _bootstrap->Request ( source, [&] ( const Net::Snapshot& s )
+    {
+        if ( _fluid->RestoreState ( s.Fields ) )
         {
-            auto elem = _sequencer.FindElement ( m );
-            if ( elem )
-            {
-                _elementCache[m] = elem;
-            }else
+            _sequencer.StepTo ( s.Time );
+        }
+    });
+}
+
+void FluidApp::OnReload ( const Time::SceneChanges& changes )
+{
+    if ( changes.Empty() ) return;
+    
+    std::cout << "Reloading! " << changes.Changed.size() << " changed, " << changes.Added.size() << " added, "
+              << changes.Removed.size() << " removed, " << changes.Unchanged << " unchanged" << std::endl;
+    
+    for ( auto& name : changes.Added ) std::cout << "  + " << name << std::endl;
+    for ( auto& name : changes.Removed ) std::cout << "  - " << name << std::endl;
+    for ( auto& name : changes.Changed ) std::cout << "  ~ " << name << std::endl;
+    
+    // Elements that survive a reload are the same objects, so the cache only goes stale when names come and go
+    if ( !changes.Added.empty() || !changes.Removed.empty() || !changes.Renamed.empty() )
+    {
+        _errorList.clear();
+        _elementCache.clear();
+        
+        for ( auto& e : _encoderMappings )
+        {
+            for ( auto& m : e )
             {
-                _errorList.push_back( "EncoderMapping: Error finding element '" + m + "' in Sequence" );
+                auto elem = _sequencer.FindElement ( m );
+                if ( elem )
+                {
+                    _elementCache[m] = elem;
+                }else
+                {
+                    _errorList.push_back( "EncoderMapping: Error finding element '" + m + "' in Sequence" );
+                }
             }
         }
     }
     
-    if ( _isLeft ) _syncTransport->SendEvent( "/sync", _sequencer.Time() );
+    if ( _isMaster )
+    {
+        _syncTransport->SendEvent( "/reload" );
+        _syncTransport->SendEvent( "/sync", _sequencer.Time() );
+    }
 }
 
 void FluidApp::HandleKeyDown ( KeyEvent event )
@@ -563,14 +773,41 @@ void FluidApp::RenderUI ( )
     ui::Text ( "Build Configuration: %s", kConfiguration );
     ui::Text ( "OpenGL Version: %s", kVersion );
     ui::Text ( "OpenGL Renderer: %s", kRenderer );
-    ui::Text ( "Layout: %s", _isLeft ? "Left" : "Right" );
+    ui::Text ( "Layout Slot: %s (%s)", _slot.Name.c_str(), _slot.Obstacles.c_str() );
     if ( _oscChannel )
     {
         ui::Text ( "Audio Endpoint: %s:%d", _oscChannel->Endpoint.c_str(), _oscChannel->Port );
+        
+        auto stats = _oscChannel->GetSendStats();
+        ui::Text ( "Audio OSC: %llu queued, %llu sent in %llu packets (%.1f KB), %llu dropped", (unsigned long long)stats.Queued,
+                   (unsigned long long)stats.Messages, (unsigned long long)stats.Packets, stats.Bytes / 1024.0f, (unsigned long long)stats.Dropped );
+        
+        if ( ui::Button ( "Benchmark OSC Encoder" ) ) _encoderTiming = Time::OSCChannel::BenchmarkEncoder ( 100000 );
+        if ( _encoderTiming.Iterations > 0 )
+        {
+            ui::SameLine ( );
+            ui::Text ( "Message %.0fns, Writer %.0fns per message", _encoderTiming.Message, _encoderTiming.Writer );
+        }
     }else
     {
         ui::Text ( "%s", "Invalid Audio Endpoint Supplied" );
     }
+    ui::Text ( "Network Threads: %d", Net::Reactor::Get().Threads() );
+    
+    if ( ui::Button ( "Benchmark Properties" ) ) _propertyTiming = _sequencer.BenchmarkProperties ( 20 );
+    if ( _propertyTiming.Evaluations > 0 )
+    {
+        ui::Text ( "%d properties (%d inline), %d evaluations", _propertyTiming.Properties, _propertyTiming.Inline, _propertyTiming.Evaluations );
+        ui::Text ( "Linear scan %.1fns, playback %.1fns, seek %.1fns per evaluation", _propertyTiming.Reference, _propertyTiming.Playback, _propertyTiming.Seek );
+        ui::Text ( "Max difference from linear scan: %g", _propertyTiming.MaxError );
+        if ( _propertyTiming.BakeRate > 0.0f )
+        {
+            ui::Text ( "Baked at %.0f/s: playback %.1fns, seek %.1fns, max difference %g", _propertyTiming.BakeRate, _propertyTiming.BakedPlayback, _propertyTiming.BakedSeek, _propertyTiming.BakedError );
+        }else
+        {
+            ui::Text ( "%s", "Not baked" );
+        }
+    }
     
     if ( !_errorList.empty() )
     {
@@ -583,6 +820,44 @@ void FluidApp::RenderUI ( )
         }
     }
     
+    if ( _cluster && ui::CollapsingHeader ( "Nodes" ) )
+    {
+        auto master = _cluster->Master();
+        ui::Text ( "%s (%s) - this node%s", _cluster->GetOptions().Id.c_str(), _slot.Name.c_str(), _isMaster ? ", master" : "" );
+        for ( auto& p : _cluster->Peers() )
+        {
+            ui::Text ( "%s (%s) - %s%s", p.Id.c_str(), p.Slot.c_str(), p.Address.c_str(), p.Id == master.Id ? ", master" : "" );
+        }
+    }
+    
+    if ( _syncTransport )
+    {
+        auto sync = _syncTransport->GetSyncStatus();
+        if ( _isMaster )
+        {
+            ui::Text ( "Clock Sync: %s", "Master" );
+        }else if ( sync.Locked )
+        {
+            ui::Text ( "Clock Sync: %.1fms error, rate %.3f", _syncError * 1000.0f, _sequencer.Rate );
+            ui::Text ( "    RTT %.2fms, jitter %.2fms, %d samples", sync.RoundTrip * 1000.0, sync.Jitter * 1000.0, sync.Samples );
+        }else
+        {
+            ui::Text ( "Clock Sync: waiting for master (%d samples)", sync.Samples );
+        }
+    }
+    
+    if ( _bootstrap )
+    {
+        ui::Text ( "Bootstrap: %s:%d", PeerStateSource().c_str(), _bootstrap->Port );
+        if ( _bootstrap->IsPending() )
+        {
+            ui::Text ( "%s", "Requesting peer state..." );
+        }else if ( ui::Button ( "Request Peer State" ) )
+        {
+            RequestPeerState ( );
+        }
+    }
+    
     ui::Text ( "FPS: %.2f", getAverageFps() );
     if ( ui::Button ( "Quit" ) ) quit();
     ui::Dummy( ImVec2(0, 10) );
@@ -628,7 +903,12 @@ void FluidApp::RenderUI ( )
 
 void FluidApp::OnCleanup ( )
 {
-
+    // The sequencer outlives us
+    _sequencer.SetOSCChannel ( nullptr );
+    
+    // Stop network handlers before the objects they call into go away
+    Net::Reactor::Get().Shutdown();
+    _sceneWatcher.reset();
 }
 
 #ifdef CINDER_MSW
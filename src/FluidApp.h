@@ -16,6 +16,9 @@
 #include "FlowField.h"
 #include "Time/Sequencer.h"
 #include "Time/OSCChannel.h"
+#include "Time/SceneWatcher.h"
+#include "Net/Bootstrap.h"
+#include "Net/Cluster.h"
 #include "RotaryEncoders.h"
 
 class FluidApp : public ci::app::App
@@ -36,11 +39,19 @@ protected:
     using ElementCache          = std::unordered_map<std::string, Time::ElementRef>;
     using EncoderMapping        = std::vector<std::vector<std::string>>;
     
+    struct LayoutSlot
+    {
+        std::string             Name;
+        std::string             Obstacles;      // Asset folder the obstacle textures come from
+        std::string             AudioSide;      // Used in the audio OSC addresses
+        ci::ivec2               EdgeInsets;     // Width of the fake obstacles on the left / right edges
+    };
+    
     void                        InitFluidAtScale    ( float scale = 0.5f );
     
     void                        HandleKeyDown       ( ci::app::KeyEvent event );
     
-    void                        OnReload            ( );
+    void                        OnReload            ( const Time::SceneChanges& changes );
     
     void                        RenderScene         ( );
     void                        RenderOverlays      ( );
@@ -48,6 +59,10 @@ protected:
     
     void                        ApplyEncoders       ( );
     void                        BroadcastOSCChanges ( );
+    void                        SlewToPeer          ( );
+    bool                        RequestPeerState    ( );
+    std::string                 PeerStateSource     ( ) const;
+    void                        OnClusterChanged    ( );
     
     Fluid::SimRef               _fluid;
     ParticleSystem              _particles;
@@ -55,16 +70,32 @@ protected:
     RotaryEncodersRef           _encoders;
     
     Time::Sequencer&            _sequencer;
+    Time::EmitterTable          _emitterTable;      // The sequencer's emitters, packed for EvaluateEmitters
+    std::vector<Fluid::Force>   _emitterForces;     // Refilled every frame, kept for its storage
+    float                       _globalsBakeRate{-1.0f};
+    uint32_t                    _globalsRevisions{0};   // Time::PropertyRevisions when the globals last baked
     Time::OSCChannelRef         _oscChannel;
     Time::OSCChannelRef         _syncTransport;
-    bool                        _isLeft{false};
-    int                         _edgeInset{0};
+    std::array<Time::OSCChannel::AddressId, 4> _audioAddresses;   // Smoke, metal, particles, flow
+    Time::EncoderTiming         _encoderTiming;
+    Time::PropertyTiming        _propertyTiming;
+    Net::BootstrapRef           _bootstrap;
+    std::string                 _peerIP;
+    Net::ClusterRef             _cluster;
+    LayoutSlot                  _slot;
+    bool                        _isMaster{false};
+    Time::SceneWatcherRef       _sceneWatcher;
+    bool                        _reloadRequested{false};
     int                         _syncFrameInterval{0};
+    float                       _syncError{0.0f};
+    bool                        _bootstrapOnStart{false};   // Until a startup request has gone out
+    bool                        _bootstrapFallback{false};  // PeerIP has been tried
     
     bool                        _uiEnabled{false};
     bool                        _running{true};
     
     ElementCache                _elementCache;
+    bool                        _encodersHeld{false};   // Mapped elements are overridden by the encoders
     EncoderMapping              _encoderMappings;
     std::vector<std::string>    _errorList;
 };
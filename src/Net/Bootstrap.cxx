@@ -0,0 +1,377 @@
+//
+//  Bootstrap.cxx
+//  Fluid
+//
+
+#include <Net/Bootstrap.h>
+#include "cinder/app/App.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+using namespace ci;
+using asio::ip::tcp;
+
+namespace Net
+{
+    static const uint32_t       kRequestMagic   = 0x51524246; // 'FBRQ'
+    static const uint32_t       kSnapshotMagic  = 0x504E5346; // 'FSNP'
+    static const uint16_t       kVersion        = 1;
+    static const int            kBits           = 16;
+    static const uint32_t       kMaxPayload     = 256 * 1024 * 1024;
+
+    // A peer that stays silent this long on any one step of a transfer is given up on
+    static const std::chrono::seconds kTimeout ( 30 );
+
+    using Clock = std::chrono::steady_clock;
+
+    static double MillisecondsSince ( const Clock::time_point& start )
+    {
+        return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+    }
+
+    ///
+    /// Snapshot
+    ///
+
+    std::size_t Snapshot::RawSize ( ) const
+    {
+        return ( Fields.Density.size() + Fields.Velocity.size() + Fields.Temperature.size() ) * sizeof(float);
+    }
+
+    void Snapshot::Encode ( Bytes& out ) const
+    {
+        Write<uint32_t> ( out, kSnapshotMagic );
+        Write<uint16_t> ( out, kVersion );
+        Write<float>    ( out, Time );
+
+        int w = Fields.Size.x;
+        int h = Fields.Size.y;
+
+        QuantizedField field;
+
+        Quantize ( Fields.Density.data(), w, h, 4, kBits, field );
+        EncodeField ( field, DeltaMode::Spatial, nullptr, out );
+
+        Quantize ( Fields.Velocity.data(), w, h, 3, kBits, field );
+        EncodeField ( field, DeltaMode::Spatial, nullptr, out );
+
+        Quantize ( Fields.Temperature.data(), w, h, 1, kBits, field );
+        EncodeField ( field, DeltaMode::Spatial, nullptr, out );
+    }
+
+    bool Snapshot::Decode ( const uint8_t * data, std::size_t size )
+    {
+        const uint8_t * p = data;
+        const uint8_t * end = data + size;
+
+        uint32_t magic = 0;
+        uint16_t version = 0;
+
+        if ( !Read ( p, end, magic ) || magic != kSnapshotMagic ) return false;
+        if ( !Read ( p, end, version ) || version != kVersion ) return false;
+        if ( !Read ( p, end, Time ) ) return false;
+
+        std::vector<float> * targets[] = { &Fields.Density, &Fields.Velocity, &Fields.Temperature };
+        const int channels[] = { 4, 3, 1 };
+
+        for ( int i = 0; i < 3; i++ )
+        {
+            QuantizedField field;
+            std::size_t consumed = 0;
+
+            if ( !DecodeField ( p, end - p, nullptr, field, consumed ) ) return false;
+            if ( field.Channels != channels[i] ) return false;
+            if ( i > 0 && ivec2 ( field.Width, field.Height ) != Fields.Size ) return false;
+
+            Fields.Size = ivec2 ( field.Width, field.Height );
+            targets[i]->resize ( field.Values.size() );
+            Dequantize ( field, targets[i]->data() );
+
+            p += consumed;
+        }
+
+        return true;
+    }
+
+    ///
+    /// Connection
+    ///
+
+    // One exchange with a peer. Its handlers and its deadline run on its own strand.
+    struct Bootstrap::Connection
+    {
+        Connection ( asio::io_service& service ) : Socket ( service ), Strand ( service ), Deadline ( service ) { }
+
+        // Calls expired if the connection's next step hasn't finished within kTimeout. Arming
+        // again restarts the clock, Close stops it.
+        static void Arm ( const ConnectionRef& connection, std::function<void()> expired )
+        {
+            connection->Deadline.expires_from_now ( kTimeout );
+            connection->Deadline.async_wait ( connection->Strand.wrap ( [connection, expired] ( asio::error_code error )
+            {
+                if ( error == asio::error::operation_aborted || connection->Closed ) return;
+
+                // Armed again after this wait had already expired
+                if ( connection->Deadline.expires_at() > asio::steady_timer::clock_type::now() ) return;
+
+                expired ( );
+            } ) );
+        }
+
+        void Close ( )
+        {
+            asio::error_code ignored;
+            Closed = true;
+            Socket.close ( ignored );
+            Deadline.cancel ( ignored );
+        }
+
+        tcp::socket             Socket;
+        Reactor::Strand         Strand;
+        asio::steady_timer      Deadline;
+        bool                    Closed{false};
+    };
+
+    ///
+    /// Bootstrap
+    ///
+
+    Bootstrap::Bootstrap ( int port )
+    : Port ( port )
+    , _service ( Reactor::Get().Service() )
+    , _strand ( _service )
+    , _state ( std::make_shared<State>() )
+    {
+    }
+
+    void Bootstrap::Serve ( CaptureFn capture )
+    {
+        _state->Capture = capture;
+
+        try
+        {
+            _acceptor = std::make_unique<tcp::acceptor>( _service, tcp::endpoint ( tcp::v4(), Port ) );
+            _strand.post ( [this] { Accept ( ); } );
+        }catch ( const std::exception& e )
+        {
+            std::cout << "Error opening bootstrap port " << Port << ": " << e.what() << std::endl;
+            _acceptor = nullptr;
+        }
+    }
+
+    void Bootstrap::Accept ( )
+    {
+        auto connection = std::make_shared<Connection>( _service );
+        _acceptor->async_accept ( connection->Socket, _strand.wrap ( [this, connection] ( asio::error_code error )
+        {
+            if ( !error ) Respond ( connection );
+            if ( error != asio::error::operation_aborted && _acceptor ) Accept ( );
+        } ) );
+    }
+
+    void Bootstrap::Respond ( ConnectionRef connection )
+    {
+        Connection::Arm ( connection, [connection]
+        {
+            asio::error_code ignored;
+            std::cout << "Bootstrap: " << connection->Socket.remote_endpoint ( ignored ) << " timed out" << std::endl;
+            connection->Close ( );
+        } );
+
+        std::weak_ptr<State> weak = _state;
+        auto request = std::make_shared<std::array<uint8_t, 6>>();
+        asio::async_read ( connection->Socket, asio::buffer ( *request ), connection->Strand.wrap ( [weak, connection, request] ( asio::error_code error, std::size_t )
+        {
+            const uint8_t * p = request->data();
+            uint32_t magic = 0;
+            uint16_t version = 0;
+
+            Read ( p, p + request->size(), magic );
+            Read ( p, p + request->size(), version );
+
+            if ( error || magic != kRequestMagic || version != kVersion ) return connection->Close ( );
+
+            auto start = Clock::now();
+
+            // The deadline now covers capturing, encoding and sending the reply
+            Connection::Arm ( connection, [connection]
+            {
+                std::cout << "Bootstrap: timed out sending state" << std::endl;
+                connection->Close ( );
+            } );
+
+            // Reading the fields back needs the GL context, so capture on the main thread
+            // and compress back on the network thread.
+            app::App::get()->dispatchAsync ( [=]
+            {
+                // Nothing left to capture from once we've been destroyed
+                auto state = weak.lock();
+                if ( !state || !state->Capture )
+                {
+                    connection->Strand.post ( [connection] { connection->Close ( ); } );
+                    return;
+                }
+
+                auto snapshot = std::make_shared<Snapshot>();
+                state->Capture ( *snapshot );
+
+                connection->Strand.post ( [=]
+                {
+                    if ( connection->Closed ) return;
+
+                    auto payload = std::make_shared<Bytes>();
+                    Write<uint32_t> ( *payload, 0 );
+                    snapshot->Encode ( *payload );
+
+                    uint32_t size = static_cast<uint32_t>( payload->size() - sizeof(uint32_t) );
+                    std::memcpy ( payload->data(), &size, sizeof(size) );
+
+                    std::size_t rawSize = snapshot->RawSize();
+                    // payload has to outlive the write, so the handler holds on to it
+                    asio::async_write ( connection->Socket, asio::buffer ( *payload ), connection->Strand.wrap ( [connection, payload, size, rawSize, start] ( asio::error_code error, std::size_t )
+                    {
+                        asio::error_code ignored;
+                        auto peer = connection->Socket.remote_endpoint ( ignored );
+
+                        if ( error )
+                        {
+                            std::cout << "Bootstrap: error sending state to " << peer << ": " << error.message() << std::endl;
+                        }else
+                        {
+                            std::cout << "Bootstrap: sent " << size << " bytes (" << rawSize << " raw) to "
+                                      << peer << " in " << MillisecondsSince ( start ) << "ms" << std::endl;
+                        }
+
+                        connection->Close ( );
+                    } ) );
+                } );
+            } );
+        } ) );
+    }
+
+    bool Bootstrap::Request ( const std::string& host, RestoreFn restore )
+    {
+        if ( _state->Pending.exchange ( true ) ) return false;
+
+        asio::error_code error;
+        auto address = asio::ip::address::from_string ( host, error );
+        if ( error )
+        {
+            std::cout << "Bootstrap: invalid peer address '" << host << "'" << std::endl;
+            _state->Pending = false;
+            return false;
+        }
+
+        _state->Restore = restore;
+        std::weak_ptr<State> state = _state;
+        int port = Port;
+
+        struct Transfer : public Connection
+        {
+            Transfer ( asio::io_service& service ) : Connection ( service ) { }
+
+            Bytes               Request;
+            uint32_t            Size{0};
+            Bytes               Payload;
+            Clock::time_point   Start{Clock::now()};
+        };
+
+        auto transfer = std::make_shared<Transfer>( _service );
+
+        // Only the first failure counts, closing the socket fails whatever else is outstanding
+        std::weak_ptr<Transfer> weak = transfer;
+        auto fail = [state, host, weak] ( const std::string& reason )
+        {
+            auto transfer = weak.lock();
+            if ( !transfer || transfer->Closed ) return;
+            transfer->Close ( );
+
+            std::cout << "Bootstrap: request to " << host << " failed: " << reason << std::endl;
+            if ( auto s = state.lock() ) s->Pending = false;
+        };
+
+        auto timedOut = [fail] { fail ( "timed out" ); };
+
+        transfer->Strand.dispatch ( [=]
+        {
+            Connection::Arm ( transfer, timedOut );
+            transfer->Socket.async_connect ( tcp::endpoint ( address, port ), transfer->Strand.wrap ( [=] ( asio::error_code error )
+            {
+                if ( error ) return fail ( error.message() );
+
+                Write<uint32_t> ( transfer->Request, kRequestMagic );
+                Write<uint16_t> ( transfer->Request, kVersion );
+
+                Connection::Arm ( transfer, timedOut );
+                asio::async_write ( transfer->Socket, asio::buffer ( transfer->Request ), transfer->Strand.wrap ( [=] ( asio::error_code error, std::size_t )
+                {
+                    if ( error ) return fail ( error.message() );
+
+                    // The peer captures on its main thread before it answers
+                    Connection::Arm ( transfer, timedOut );
+                    asio::async_read ( transfer->Socket, asio::buffer ( &transfer->Size, sizeof(uint32_t) ), transfer->Strand.wrap ( [=] ( asio::error_code error, std::size_t )
+                    {
+                        if ( error ) return fail ( error.message() );
+                        if ( transfer->Size == 0 || transfer->Size > kMaxPayload ) return fail ( "bad payload size" );
+
+                        transfer->Payload.resize ( transfer->Size );
+
+                        Connection::Arm ( transfer, timedOut );
+                        asio::async_read ( transfer->Socket, asio::buffer ( transfer->Payload ), transfer->Strand.wrap ( [=] ( asio::error_code error, std::size_t )
+                        {
+                            if ( error ) return fail ( error.message() );
+                            transfer->Close ( );
+
+                            auto snapshot = std::make_shared<Snapshot>();
+                            if ( !snapshot->Decode ( transfer->Payload.data(), transfer->Payload.size() ) )
+                            {
+                                std::cout << "Bootstrap: request to " << host << " failed: malformed snapshot" << std::endl;
+                                if ( auto s = state.lock() ) s->Pending = false;
+                                return;
+                            }
+
+                            double elapsed = MillisecondsSince ( transfer->Start );
+
+                            // The peer captured somewhere mid transfer, half the round trip is a fair guess.
+                            // The regular /sync takes care of whatever error is left.
+                            snapshot->Time += static_cast<float>( elapsed * 0.5 / 1000.0 );
+
+                            std::cout << "Bootstrap: received " << transfer->Payload.size() << " bytes (" << snapshot->RawSize()
+                                      << " raw) from " << host << " in " << elapsed << "ms" << std::endl;
+
+                            // Dropped if we're destroyed first, restore belongs to our owner
+                            app::App::get()->dispatchAsync ( [state, snapshot]
+                            {
+                                auto s = state.lock();
+                                if ( !s ) return;
+
+                                if ( s->Restore ) s->Restore ( *snapshot );
+                                s->Restore = nullptr;
+                                s->Pending = false;
+                            } );
+                        } ) );
+                    } ) );
+                } ) );
+            } ) );
+        } );
+
+        return true;
+    }
+
+    Bootstrap::~Bootstrap ( )
+    {
+        _strand.post ( [this]
+        {
+            if ( _acceptor )
+            {
+                asio::error_code ignored;
+                _acceptor->close ( ignored );
+            }
+        } );
+
+        Reactor::Get().Drain ( _strand );
+        _acceptor = nullptr;
+    }
+}
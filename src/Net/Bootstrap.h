@@ -0,0 +1,78 @@
+//
+//  Bootstrap.h
+//  Fluid
+//
+//  Lets a restarted node pull the live fluid fields and sequencer time
+//  from a peer over TCP so it resumes mid-scene instead of from nothing.
+//
+
+#ifndef Fluid_Bootstrap_h
+#define Fluid_Bootstrap_h
+
+#include <Net/Reactor.h>
+
+#include "Fluid.h"
+#include <Net/FieldCodec.h>
+
+#include <atomic>
+
+namespace Net
+{
+    struct Snapshot
+    {
+        float                                   Time{0.0f};
+        Fluid::State                            Fields;
+
+        void                                    Encode      ( Bytes& out ) const;
+        bool                                    Decode      ( const uint8_t * data, std::size_t size );
+        std::size_t                             RawSize     ( ) const;
+    };
+
+    using BootstrapRef = std::unique_ptr<class Bootstrap>;
+    class Bootstrap
+    {
+    public:
+
+        using CaptureFn                         = std::function<void(Snapshot&)>;
+        using RestoreFn                         = std::function<void(const Snapshot&)>;
+
+        Bootstrap                               ( int port );
+        ~Bootstrap                              ( );
+
+        // Answer peer requests. capture is called on the main thread.
+        void                                    Serve       ( CaptureFn capture );
+
+        // Ask host for its state. restore is called on the main thread once it arrives. False if
+        // nothing was sent, because host isn't an address or a request is already pending.
+        bool                                    Request     ( const std::string& host, RestoreFn restore );
+
+        inline bool                             IsPending   ( ) const { return _state->Pending; }
+
+        int                                     Port{9890};
+
+    protected:
+
+        struct Connection;
+        using ConnectionRef                     = std::shared_ptr<Connection>;
+
+        void                                    Accept      ( );
+        void                                    Respond     ( ConnectionRef connection );
+
+        asio::io_service&                       _service;
+        Reactor::Strand                         _strand;        // Orders the accept loop
+        std::unique_ptr<asio::ip::tcp::acceptor> _acceptor;
+
+        // Transfers can outlive us, so their handlers hold this weakly and do nothing once it's gone
+        struct State
+        {
+            CaptureFn                           Capture;
+            RestoreFn                           Restore;        // For the request in flight
+            std::atomic<bool>                   Pending{false};
+        };
+
+        using StateRef                          = std::shared_ptr<State>;
+        StateRef                                _state;
+    };
+}
+
+#endif /* Fluid_Bootstrap_h */
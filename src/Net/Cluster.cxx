@@ -0,0 +1,306 @@
+//
+//  Cluster.cxx
+//  Fluid
+//
+
+#include <Net/Cluster.h>
+#include <Net/FieldCodec.h>
+#include "cinder/app/App.h"
+#include "cinder/Rand.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+using namespace ci;
+using asio::ip::udp;
+
+namespace Net
+{
+    namespace
+    {
+        const uint32_t      kHelloMagic     = 0x444F4E46; // 'FNOD'
+        const uint16_t      kVersion        = 1;
+        const int           kHelloMs        = 500;
+        const double        kExpiry         = 2.5;      // Seconds of silence before a node is dropped
+        const double        kSettle         = 1.5;      // Listen this long before electing anyone
+
+        double Now ( )
+        {
+            using namespace std::chrono;
+            return duration<double>( steady_clock::now().time_since_epoch() ).count();
+        }
+
+        void WriteString ( Bytes& out, const std::string& value )
+        {
+            uint8_t size = static_cast<uint8_t>( std::min<std::size_t>( value.size(), 255 ) );
+            Write<uint8_t> ( out, size );
+            out.insert ( out.end(), value.begin(), value.begin() + size );
+        }
+
+        bool ReadString ( const uint8_t *& cursor, const uint8_t * end, std::string& value )
+        {
+            uint8_t size = 0;
+            if ( !Read ( cursor, end, size ) ) return false;
+            if ( end - cursor < size ) return false;
+            value.assign ( reinterpret_cast<const char *>( cursor ), size );
+            cursor += size;
+            return true;
+        }
+    }
+
+    Cluster::Cluster ( const Options& options )
+    : _options ( options )
+    , _service ( Reactor::Get().Service() )
+    , _strand ( _service )
+    , _startTime ( Now() )
+    {
+        if ( _options.Id.empty() )
+        {
+            char suffix[8];
+            std::snprintf ( suffix, sizeof(suffix), "%04x", randInt ( 0xFFFF ) );
+            _options.Id = asio::ip::host_name() + "-" + suffix;
+        }
+
+        {
+            Node self;
+            self.Id         = _options.Id;
+            self.Slot       = _options.Slot;
+            self.Priority   = _options.Priority;
+            self.IsSelf     = true;
+            self.LastSeen   = Now();
+            _nodes[self.Id] = self;
+        }
+
+        try
+        {
+            auto group = asio::ip::address::from_string ( _options.Group );
+            _groupEndpoint = udp::endpoint ( group, _options.Port );
+
+            _socket = std::make_unique<udp::socket>( _service );
+            _socket->open ( udp::v4() );
+            _socket->set_option ( udp::socket::reuse_address ( true ) );
+            _socket->bind ( udp::endpoint ( asio::ip::address_v4::any(), _options.Port ) );
+
+            asio::error_code error;
+            _socket->set_option ( asio::ip::multicast::join_group ( group ), error );
+            if ( error ) std::cout << "Cluster: could not join " << _options.Group << ": " << error.message() << std::endl;
+            _socket->set_option ( asio::ip::multicast::enable_loopback ( true ), error );
+
+            for ( auto& p : _options.StaticPeers )
+            {
+                auto address = asio::ip::address::from_string ( p, error );
+                if ( !error ) _staticEndpoints.emplace_back ( address, _options.Port );
+            }
+
+            _timer = std::make_unique<asio::steady_timer>( _service );
+
+            _strand.post ( [this]
+            {
+                Receive ( );
+                Tick ( );
+            } );
+        }catch ( const std::exception& e )
+        {
+            std::cout << "Cluster: error opening discovery port " << _options.Port << ": " << e.what() << std::endl;
+            _socket = nullptr;
+        }
+    }
+
+    bool Cluster::IsMaster ( ) const
+    {
+        std::lock_guard<std::mutex> lock ( _lock );
+        return !_masterId.empty() && _masterId == _options.Id;
+    }
+
+    bool Cluster::HasMaster ( ) const
+    {
+        std::lock_guard<std::mutex> lock ( _lock );
+        return !_masterId.empty();
+    }
+
+    Node Cluster::Master ( ) const
+    {
+        std::lock_guard<std::mutex> lock ( _lock );
+        auto it = _nodes.find ( _masterId );
+        return it != _nodes.end() ? it->second : Node();
+    }
+
+    std::vector<Node> Cluster::Peers ( ) const
+    {
+        std::lock_guard<std::mutex> lock ( _lock );
+
+        std::vector<Node> peers;
+        for ( auto& n : _nodes )
+        {
+            if ( !n.second.IsSelf ) peers.push_back ( n.second );
+        }
+        return peers;
+    }
+
+    void Cluster::Receive ( )
+    {
+        _socket->async_receive_from ( asio::buffer ( _receiveBuffer ), _receiveFrom, _strand.wrap ( [this] ( asio::error_code error, std::size_t size )
+        {
+            if ( error == asio::error::operation_aborted ) return;
+            if ( !error ) HandleHello ( _receiveBuffer.data(), size, _receiveFrom );
+            Receive ( );
+        } ) );
+    }
+
+    void Cluster::Tick ( )
+    {
+        SendHello ( );
+
+        bool changed = false;
+        double now = Now();
+        {
+            std::lock_guard<std::mutex> lock ( _lock );
+
+            _nodes[_options.Id].LastSeen = now;
+            for ( auto it = _nodes.begin(); it != _nodes.end(); )
+            {
+                if ( now - it->second.LastSeen > kExpiry )
+                {
+                    std::cout << "Cluster: lost " << it->second.Id << " (" << it->second.Address << ")" << std::endl;
+                    it = _nodes.erase ( it );
+                    changed = true;
+                }else
+                {
+                    it++;
+                }
+            }
+
+            if ( now - _startTime > kSettle ) changed |= Elect ( );
+        }
+
+        if ( changed && _changeHandler )
+        {
+            auto handler = _changeHandler;
+            app::App::get()->dispatchAsync ( handler );
+        }
+
+        _timer->expires_from_now ( std::chrono::milliseconds ( kHelloMs ) );
+        _timer->async_wait ( _strand.wrap ( [this] ( asio::error_code error )
+        {
+            if ( !error ) Tick ( );
+        } ) );
+    }
+
+    void Cluster::SendHello ( )
+    {
+        auto hello = std::make_shared<Bytes>();
+        Write<uint32_t> ( *hello, kHelloMagic );
+        Write<uint16_t> ( *hello, kVersion );
+        WriteString ( *hello, _options.Id );
+        WriteString ( *hello, _options.Slot );
+        Write<int32_t> ( *hello, _options.Priority );
+        {
+            std::lock_guard<std::mutex> lock ( _lock );
+            Write<uint8_t> ( *hello, _masterId == _options.Id ? 1 : 0 );
+        }
+
+        auto ignore = [hello] ( asio::error_code, std::size_t ) { };
+
+        _socket->async_send_to ( asio::buffer ( *hello ), _groupEndpoint, ignore );
+        for ( auto& e : _staticEndpoints )
+        {
+            _socket->async_send_to ( asio::buffer ( *hello ), e, ignore );
+        }
+    }
+
+    void Cluster::HandleHello ( const uint8_t * data, std::size_t size, const udp::endpoint& from )
+    {
+        const uint8_t * p = data;
+        const uint8_t * end = data + size;
+
+        uint32_t magic = 0;
+        uint16_t version = 0;
+        Node node;
+
+        if ( !Read ( p, end, magic ) || magic != kHelloMagic ) return;
+        if ( !Read ( p, end, version ) || version != kVersion ) return;
+        if ( !ReadString ( p, end, node.Id ) ) return;
+        if ( !ReadString ( p, end, node.Slot ) ) return;
+        if ( !Read ( p, end, node.Priority ) ) return;
+
+        uint8_t claims = 0;
+        if ( !Read ( p, end, claims ) ) return;
+        node.ClaimsMaster = claims != 0;
+
+        if ( node.Id.empty() || node.Id == _options.Id ) return;
+
+        node.Address = from.address().to_string();
+        node.LastSeen = Now();
+
+        bool changed = false;
+        {
+            std::lock_guard<std::mutex> lock ( _lock );
+
+            auto it = _nodes.find ( node.Id );
+            if ( it == _nodes.end() )
+            {
+                std::cout << "Cluster: found " << node.Id << " (" << node.Address << ", slot '" << node.Slot << "')" << std::endl;
+                changed = true;
+            }else
+            {
+                changed = it->second.Address != node.Address || it->second.Priority != node.Priority || it->second.ClaimsMaster != node.ClaimsMaster;
+            }
+
+            _nodes[node.Id] = node;
+            if ( changed && Now() - _startTime > kSettle ) Elect ( );
+        }
+
+        if ( changed && _changeHandler )
+        {
+            auto handler = _changeHandler;
+            app::App::get()->dispatchAsync ( handler );
+        }
+    }
+
+    // Expects _lock to be held. A node that is already master keeps the job, so a
+    // restarted high priority node doesn't drag everyone back to its time. Only
+    // when nobody claims it (or several do) does priority decide. Every node runs
+    // the same rule over the same membership, so they agree without extra messages.
+    bool Cluster::Elect ( )
+    {
+        _nodes[_options.Id].ClaimsMaster = _masterId == _options.Id;
+
+        bool anyClaims = false;
+        for ( auto& n : _nodes ) anyClaims |= n.second.ClaimsMaster;
+
+        const Node * best = nullptr;
+        for ( auto& n : _nodes )
+        {
+            const Node& c = n.second;
+            if ( anyClaims && !c.ClaimsMaster ) continue;
+
+            if ( !best || c.Priority > best->Priority || ( c.Priority == best->Priority && c.Id < best->Id ) )
+            {
+                best = &c;
+            }
+        }
+
+        std::string masterId = best ? best->Id : "";
+        if ( masterId == _masterId ) return false;
+
+        std::cout << "Cluster: master is now " << masterId << ( masterId == _options.Id ? " (us)" : "" ) << std::endl;
+        _masterId = masterId;
+        return true;
+    }
+
+    Cluster::~Cluster ( )
+    {
+        _strand.post ( [this]
+        {
+            if ( _timer ) _timer->cancel();
+            if ( _socket )
+            {
+                asio::error_code ignored;
+                _socket->close ( ignored );
+            }
+        } );
+
+        Reactor::Get().Drain ( _strand );
+    }
+}
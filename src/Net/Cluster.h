@@ -0,0 +1,94 @@
+//
+//  Cluster.h
+//  Fluid
+//
+//  Finds the other display nodes over UDP multicast (and any statically
+//  configured peers) and elects one of them as the timing master.
+//
+
+#ifndef Fluid_Cluster_h
+#define Fluid_Cluster_h
+
+#include <Net/Reactor.h>
+
+#include <array>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Net
+{
+    struct Node
+    {
+        std::string                             Id;
+        std::string                             Address;
+        std::string                             Slot;
+        int                                     Priority{0};
+        bool                                    ClaimsMaster{false};
+        bool                                    IsSelf{false};
+        double                                  LastSeen{0.0};
+    };
+
+    using ClusterRef = std::unique_ptr<class Cluster>;
+    class Cluster
+    {
+    public:
+
+        struct Options
+        {
+            std::string                         Id;                             // Unique per node, defaults to host name + random suffix
+            std::string                         Slot;
+            int                                 Priority{0};                    // Highest priority wins an election, ties go to the lowest Id
+            std::string                         Group{"239.255.42.99"};
+            int                                 Port{9887};
+            std::vector<std::string>            StaticPeers;                    // Also sent hellos directly, for networks without multicast
+        };
+
+        // Called on the main thread whenever membership or the master changes
+        using ChangeFn                          = std::function<void()>;
+
+        Cluster                                 ( const Options& options );
+        ~Cluster                                ( );
+
+        void                                    OnChange        ( ChangeFn handler ) { _changeHandler = handler; }
+
+        bool                                    IsMaster        ( ) const;
+        bool                                    HasMaster       ( ) const;
+        Node                                    Master          ( ) const;
+        std::vector<Node>                       Peers           ( ) const;       // Everyone but us
+
+        inline const Options&                   GetOptions      ( ) const { return _options; }
+
+    protected:
+
+        void                                    Receive         ( );
+        void                                    Tick            ( );
+        void                                    SendHello       ( );
+        void                                    HandleHello     ( const uint8_t * data, std::size_t size, const asio::ip::udp::endpoint& from );
+        bool                                    Elect           ( );
+
+        Options                                 _options;
+
+        asio::io_service&                       _service;
+        Reactor::Strand                         _strand;
+        std::unique_ptr<asio::ip::udp::socket>  _socket;
+        std::unique_ptr<asio::steady_timer>     _timer;
+        asio::ip::udp::endpoint                 _groupEndpoint;
+        std::vector<asio::ip::udp::endpoint>    _staticEndpoints;
+
+        std::array<uint8_t, 512>                _receiveBuffer;
+        asio::ip::udp::endpoint                 _receiveFrom;
+
+        mutable std::mutex                      _lock;
+        std::map<std::string, Node>             _nodes;
+        std::string                             _masterId;
+        double                                  _startTime{0.0};
+
+        ChangeFn                                _changeHandler;
+    };
+}
+
+#endif /* Fluid_Cluster_h */
@@ -0,0 +1,507 @@
+//
+//  CrowdServer.cxx
+//  Fluid
+//
+
+#include <Net/CrowdServer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using namespace ci;
+
+namespace Net
+{
+    namespace
+    {
+        const float         kWander         = 0.4f;     // Random acceleration, screens per second squared
+        const float         kDrag           = 0.8f;     // Fraction of velocity kept per second
+        const float         kMargin         = 0.05f;
+        const float         kPropertyEvery  = 5.0f;     // Seconds between SetProperty messages
+        const int           kFullEvery      = 60;       // Steps between v2 updates carrying every field
+
+        double              Seconds         ( )
+        {
+            using namespace std::chrono;
+            return duration<double>( steady_clock::now().time_since_epoch() ).count();
+        }
+
+        // Calls handler ( data, size ) for each whole packet in a buffer of them
+        template <typename Handler>
+        void                ForEachPacket   ( const Bytes& packets, Handler handler )
+        {
+            std::size_t offset = 0;
+            while ( packets.size() - offset >= UserPacket::kHeaderSize )
+            {
+                uint32_t size = 0;
+                std::memcpy ( &size, &packets[offset + 1], 4 );
+                if ( size < UserPacket::kHeaderSize || size > packets.size() - offset ) return;
+
+                handler ( &packets[offset], static_cast<std::size_t>( size ) );
+                offset += size;
+            }
+        }
+    }
+
+    ///
+    /// CrowdOptions
+    ///
+
+    CrowdOptions CrowdOptions::FromJson ( const JsonTree& tree )
+    {
+        CrowdOptions o;
+        if ( tree.hasChild( "Port" ) ) o.Port = tree["Port"].getValue<int>();
+        if ( tree.hasChild( "Users" ) ) o.Users = tree["Users"].getValue<int>();
+        if ( tree.hasChild( "Rate" ) ) o.Rate = tree["Rate"].getValue<float>();
+        if ( tree.hasChild( "Loss" ) ) o.Loss = tree["Loss"].getValue<float>();
+        if ( tree.hasChild( "Reorder" ) ) o.Reorder = tree["Reorder"].getValue<float>();
+        if ( tree.hasChild( "Churn" ) ) o.Churn = tree["Churn"].getValue<float>();
+
+        o.Users = std::max ( o.Users, 0 );
+        o.Rate = std::max ( o.Rate, 1.0f );
+        return o;
+    }
+
+    ///
+    /// Crowd
+    ///
+
+    Crowd::Crowd ( uint32_t seed )
+    : _random ( seed )
+    {
+    }
+
+    void Crowd::Join ( Bytes& out )
+    {
+        std::uniform_real_distribution<float> unit ( 0.0f, 1.0f );
+
+        UserEvent u;
+        u.ID = _nextID;
+        u.Position = vec2 ( kMargin + unit ( _random ) * ( 1.0f - 2.0f * kMargin ), kMargin + unit ( _random ) * ( 1.0f - 2.0f * kMargin ) );
+        u.Radius = 32.0f + unit ( _random ) * 64.0f;
+        u.Color = DefaultPalette()[_random() % 256];
+
+        // v2 ids are 16 bit
+        _nextID = _nextID % 0xFFFF + 1;
+
+        std::string name = "crowd" + std::to_string ( u.ID );
+        EncodeJoin ( u.ID, name.c_str(), out );
+
+        _users.push_back ( u );
+        _velocities.emplace_back ( 0.0f );
+        _fresh.push_back ( true );
+    }
+
+    void Crowd::Leave ( std::size_t index, Bytes& out )
+    {
+        EncodeLeave ( _users[index].ID, out );
+
+        _users[index] = _users.back();
+        _velocities[index] = _velocities.back();
+        _fresh[index] = _fresh.back();
+
+        _users.pop_back();
+        _velocities.pop_back();
+        _fresh.pop_back();
+    }
+
+    void Crowd::Resize ( int users, Bytes& joins )
+    {
+        while ( static_cast<int>( _users.size() ) < users ) Join ( joins );
+        while ( static_cast<int>( _users.size() ) > users ) Leave ( _users.size() - 1, joins );
+    }
+
+    void Crowd::Snapshot ( Bytes& joins ) const
+    {
+        for ( auto& u : _users )
+        {
+            std::string name = "crowd" + std::to_string ( u.ID );
+            EncodeJoin ( u.ID, name.c_str(), joins );
+        }
+    }
+
+    void Crowd::Step ( float dt, float churn, uint32_t timestamp, bool full, Bytes& v1, Bytes& v2 )
+    {
+        std::uniform_real_distribution<float> unit ( 0.0f, 1.0f );
+        std::normal_distribution<float> noise ( 0.0f, kWander );
+
+        // Everyone who leaves is replaced, so the crowd stays the same size
+        if ( churn > 0.0f )
+        {
+            std::size_t count = _users.size();
+            for ( std::size_t i = 0; i < _users.size(); i++ )
+            {
+                if ( unit ( _random ) >= churn ) continue;
+
+                Bytes packets;
+                Leave ( i, packets );
+                v1.insert ( v1.end(), packets.begin(), packets.end() );
+                v2.insert ( v2.end(), packets.begin(), packets.end() );
+            }
+
+            while ( _users.size() < count )
+            {
+                Bytes packets;
+                Join ( packets );
+                v1.insert ( v1.end(), packets.begin(), packets.end() );
+                v2.insert ( v2.end(), packets.begin(), packets.end() );
+            }
+        }
+
+        float keep = std::pow ( kDrag, dt );
+        for ( std::size_t i = 0; i < _users.size(); i++ )
+        {
+            vec2& v = _velocities[i];
+            UserEvent& u = _users[i];
+
+            v = v * keep + vec2 ( noise ( _random ), noise ( _random ) ) * dt;
+            u.Position += v * dt;
+
+            // Bounce off the edges
+            if ( u.Position.x < kMargin || u.Position.x > 1.0f - kMargin ) v.x = -v.x;
+            if ( u.Position.y < kMargin || u.Position.y > 1.0f - kMargin ) v.y = -v.y;
+            u.Position = glm::clamp ( u.Position, vec2 ( kMargin ), vec2 ( 1.0f - kMargin ) );
+
+            if ( glm::length ( v ) > 1e-4f ) u.Angle = std::atan2 ( v.y, v.x );
+        }
+
+        if ( !_users.empty() ) EncodeUpdate ( _users.data(), _users.size(), v1 );
+
+        // Only motion changes from step to step, everything else goes out now and then
+        full = full || ++_steps % kFullEvery == 0;
+
+        _deltas = _users;
+        for ( std::size_t i = 0; i < _deltas.size(); i++ )
+        {
+            _deltas[i].Fields = full || _fresh[i] ? UserField::All : UserField::Position | UserField::Angle;
+            _fresh[i] = false;
+        }
+
+        if ( !_deltas.empty() ) _sequence = EncodeUpdateV2 ( _sequence, timestamp, _deltas.data(), _deltas.size(), DefaultPalette(), v2 );
+
+        _propertyTimer += dt;
+        if ( _propertyTimer > kPropertyEvery )
+        {
+            _propertyTimer = 0.0f;
+
+            Bytes packet;
+            EncodeProperty ( Property::ParticleAlpha, 0.6f + unit ( _random ) * 0.4f, packet );
+            v1.insert ( v1.end(), packet.begin(), packet.end() );
+            v2.insert ( v2.end(), packet.begin(), packet.end() );
+        }
+    }
+
+    ///
+    /// CrowdServer
+    ///
+
+    CrowdServer::CrowdServer ( const CrowdOptions& options )
+    : _service ( Reactor::Get().Service() )
+    , _strand ( _service )
+    , _timer ( _service )
+    , _options ( options )
+    , _random ( 2 )
+    , _start ( Seconds() )
+    , _pendingOptions ( options )
+    {
+        _server.clear_access_channels( websocketpp::log::alevel::all );
+        _server.clear_error_channels( websocketpp::log::elevel::all );
+
+        try
+        {
+            _server.init_asio ( &_service );
+            _server.set_reuse_addr ( true );
+
+            _server.set_open_handler ( [this] ( websocketpp::connection_hdl handle )
+            {
+                _strand.post ( [this, handle]
+                {
+                    _clients[handle] = Client();
+                    _full = true;
+
+                    // Introduce everyone already here
+                    _joins.clear();
+                    _crowd.Snapshot ( _joins );
+                    Send ( handle, _joins );
+                } );
+            } );
+
+            _server.set_close_handler ( [this] ( websocketpp::connection_hdl handle )
+            {
+                _strand.post ( [this, handle] { _clients.erase ( handle ); } );
+            } );
+
+            _server.set_message_handler ( [this] ( websocketpp::connection_hdl handle, Server::message_ptr message )
+            {
+                const std::string& payload = message->get_payload();
+                if ( payload.size() < UserPacket::kHeaderSize + 1 || payload[5] != static_cast<char>( Command::Hello ) ) return;
+
+                int version = static_cast<uint8_t>( payload[UserPacket::kHeaderSize] );
+                _strand.post ( [this, handle, version]
+                {
+                    auto it = _clients.find ( handle );
+                    if ( it != _clients.end() ) it->second.Version = std::min ( version, 2 );
+                    _full = true;
+                } );
+            } );
+
+            _server.listen ( _options.Port );
+            _server.start_accept ( );
+
+            _strand.post ( [this]
+            {
+                _crowd.Resize ( _options.Users, _joins );
+                Schedule ( );
+            } );
+
+            std::cout << "Crowd server: " << _options.Users << " users at " << _options.Rate << "Hz on port " << _options.Port << std::endl;
+        }catch ( const std::exception& e )
+        {
+            std::cout << "Error opening crowd server on port " << _options.Port << ": " << e.what() << std::endl;
+        }
+    }
+
+    void CrowdServer::SetOptions ( const CrowdOptions& options )
+    {
+        std::lock_guard<std::mutex> lock ( _statsLock );
+        _pendingOptions = options;
+        _pendingOptions.Port = _options.Port;
+        _optionsChanged = true;
+    }
+
+    CrowdOptions CrowdServer::GetOptions ( ) const
+    {
+        std::lock_guard<std::mutex> lock ( _statsLock );
+        return _pendingOptions;
+    }
+
+    CrowdServer::Stats CrowdServer::GetStats ( ) const
+    {
+        std::lock_guard<std::mutex> lock ( _statsLock );
+        return _stats;
+    }
+
+    void CrowdServer::Schedule ( )
+    {
+        if ( _stopping ) return;
+
+        // From the last deadline rather than now, so the rate doesn't drift
+        _timer.expires_at ( _timer.expires_at() + std::chrono::microseconds ( static_cast<int64_t>( 1e6 / _options.Rate ) ) );
+        if ( _timer.expires_at() < asio::steady_timer::clock_type::now() ) _timer.expires_from_now ( std::chrono::microseconds ( 0 ) );
+
+        _timer.async_wait ( _strand.wrap ( [this] ( asio::error_code error )
+        {
+            if ( error || _stopping ) return;
+            Tick ( );
+            Schedule ( );
+        } ) );
+    }
+
+    void CrowdServer::Tick ( )
+    {
+        {
+            std::lock_guard<std::mutex> lock ( _statsLock );
+            if ( _optionsChanged )
+            {
+                _options = _pendingOptions;
+                _optionsChanged = false;
+            }
+        }
+
+        _v1.clear();
+        _v2.clear();
+
+        // Size changes go out as joins and leaves to everyone
+        _crowd.Resize ( _options.Users, _v1 );
+        _v2 = _v1;
+
+        uint32_t timestamp = static_cast<uint32_t>( ( Seconds() - _start ) * 1000.0 );
+        _crowd.Step ( 1.0f / _options.Rate, _options.Churn, timestamp, _full, _v1, _v2 );
+        _full = false;
+
+        for ( auto& it : _clients )
+        {
+            Send ( it.first, it.second.Version >= 2 ? _v2 : _v1 );
+        }
+
+        std::lock_guard<std::mutex> lock ( _statsLock );
+        _stats.Clients = static_cast<int>( _clients.size() );
+        _stats.Users = static_cast<int>( _crowd.Size() );
+    }
+
+    void CrowdServer::Send ( websocketpp::connection_hdl handle, const Bytes& packets )
+    {
+        auto it = _clients.find ( handle );
+        if ( it == _clients.end() ) return;
+
+        websocketpp::lib::error_code error;
+        auto connection = _server.get_con_from_hdl ( handle, error );
+        if ( error ) return;
+
+        Client& client = it->second;
+        std::uniform_real_distribution<float> unit ( 0.0f, 1.0f );
+        uint64_t sent = 0, bytes = 0, lost = 0, reordered = 0;
+
+        ForEachPacket ( packets, [&] ( const uint8_t * data, std::size_t size )
+        {
+            Command command = static_cast<Command>( data[5] );
+            bool update = command == Command::Update || command == Command::UpdateV2;
+
+            // Only updates are lost or reordered, the server would resend anything else
+            if ( update && unit ( _random ) < _options.Loss )
+            {
+                lost++;
+                return;
+            }
+
+            if ( update && client.Held.empty() && unit ( _random ) < _options.Reorder )
+            {
+                client.Held.assign ( data, data + size );
+                reordered++;
+                return;
+            }
+
+            connection->send ( data, size, websocketpp::frame::opcode::binary );
+            sent++;
+            bytes += size;
+
+            if ( update && !client.Held.empty() )
+            {
+                connection->send ( client.Held.data(), client.Held.size(), websocketpp::frame::opcode::binary );
+                sent++;
+                bytes += client.Held.size();
+                client.Held.clear();
+            }
+        } );
+
+        std::lock_guard<std::mutex> lock ( _statsLock );
+        _stats.Packets += sent;
+        _stats.Bytes += bytes;
+        _stats.Lost += lost;
+        _stats.Reordered += reordered;
+    }
+
+    CrowdServer::~CrowdServer ( )
+    {
+        _strand.post ( [this]
+        {
+            _stopping = true;
+
+            asio::error_code ignored;
+            _timer.cancel ( ignored );
+
+            websocketpp::lib::error_code closeError;
+            _server.stop_listening ( closeError );
+            for ( auto& it : _clients )
+            {
+                _server.close ( it.first, websocketpp::close::status::going_away, "", closeError );
+            }
+        } );
+
+        Reactor::Get().Drain ( _strand );
+    }
+
+    ///
+    /// Ingest benchmark
+    ///
+
+    IngestTiming BenchmarkIngest ( int users, int frames, const std::function<void ( UserTable& )>& inject )
+    {
+        using namespace std::chrono;
+
+        IngestTiming timing;
+        timing.Users = users;
+        if ( users <= 0 || frames <= 0 ) return timing;
+
+        Crowd crowd ( 7 );
+        UserTable table;
+        Bytes joins, v1, v2;
+        std::vector<UserEvent> queue;
+        queue.reserve ( users * 2 );
+
+        // Traffic and its decoded events, as UserFeed would queue them
+        const float dt = 1.0f / 60.0f;
+        double time = 1.0;
+        uint64_t bytes = 0;
+        Palette palette = DefaultPalette();
+
+        auto decode = [&] ( const Bytes& packets )
+        {
+            ForEachPacket ( packets, [&] ( const uint8_t * data, std::size_t size )
+            {
+                UserPacket packet;
+                if ( UserPacket::Parse ( data, size, packet ) != ParseError::None ) return;
+                bytes += size;
+
+                switch ( packet.Type() )
+                {
+                    case Command::Update :
+                    case Command::UpdateV2 :
+                    {
+                        packet.ForEachUser ( palette, [&] ( const UserEvent& u )
+                        {
+                            queue.push_back ( u );
+                            queue.back().Time = time;
+                        } );
+                        break;
+                    }
+
+                    case Command::Join :
+                    case Command::Leave :
+                    {
+                        UserEvent e;
+                        e.Type = packet.Type();
+                        e.ID = packet.ID();
+                        e.Time = time;
+                        if ( e.Type == Command::Join ) packet.Name ( e.Name );
+                        queue.push_back ( e );
+                        break;
+                    }
+
+                    default :
+                        break;
+                }
+            } );
+        };
+
+        crowd.Resize ( users, joins );
+        decode ( joins );
+        for ( auto& e : queue ) table.Apply ( e, time );
+        queue.clear();
+
+        double decodeTime = 0.0, applyTime = 0.0, injectTime = 0.0;
+
+        for ( int f = 0; f < frames; f++ )
+        {
+            time += dt;
+            v1.clear();
+            v2.clear();
+            crowd.Step ( dt, 0.0f, static_cast<uint32_t>( time * 1000.0 ), false, v1, v2 );
+
+            auto start = steady_clock::now();
+            decode ( v2 );
+            auto decoded = steady_clock::now();
+
+            for ( auto& e : queue ) table.Apply ( e, time );
+            queue.clear();
+            table.Expire ( time );
+            table.Sample ( time, 0.1, 0.15 );
+            auto applied = steady_clock::now();
+
+            inject ( table );
+            auto injected = steady_clock::now();
+
+            decodeTime += duration<double, std::micro>( decoded - start ).count();
+            applyTime += duration<double, std::micro>( applied - decoded ).count();
+            injectTime += duration<double, std::micro>( injected - applied ).count();
+        }
+
+        timing.Decode = decodeTime / frames;
+        timing.Apply = applyTime / frames;
+        timing.Inject = injectTime / frames;
+        timing.MegabytesPerSecond = bytes / ( 1024.0 * 1024.0 ) / std::max ( decodeTime * 1e-6, 1e-9 );
+        return timing;
+    }
+}
@@ -0,0 +1,165 @@
+//
+//  CrowdServer.h
+//  Fluid
+//
+//  A local stand-in for the user tracking server. Simulates a crowd of
+//  users wandering about and serves their Join / Update / Leave /
+//  SetProperty traffic over WebSocket, with optional loss and reordering,
+//  so the networked build can be load tested without the real server.
+//
+
+#ifndef Fluid_CrowdServer_h
+#define Fluid_CrowdServer_h
+
+#include "WebSocketConnection.h"
+#include "websocketpp/config/asio_no_tls.hpp"
+#include "websocketpp/server.hpp"
+#include "cinder/Json.h"
+
+#include <Net/Reactor.h>
+#include <Net/UserProtocol.h>
+#include <Net/UserTable.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+
+namespace Net
+{
+    struct CrowdOptions
+    {
+        int                                     Port{9300};
+        int                                     Users{200};
+        float                                   Rate{30.0f};                // Updates per second
+        float                                   Loss{0.0f};                 // Chance an update is never sent
+        float                                   Reorder{0.0f};              // Chance an update is held back and sent after the next
+        float                                   Churn{0.002f};              // Chance per user per update of leaving, replaced by a newcomer
+
+        static CrowdOptions                     FromJson    ( const ci::JsonTree& tree );
+    };
+
+    ///
+    /// Crowd
+    ///
+
+    // The simulated users. Shared by the server and the ingest benchmark so both see the same traffic.
+    class Crowd
+    {
+    public:
+
+        Crowd                                   ( uint32_t seed = 1 );
+
+        // Grows or shrinks to users, joining or leaving as needed
+        void                                    Resize      ( int users, Bytes& joins );
+
+        // Moves everyone on by dt and appends this tick's packets for either protocol version.
+        // Joins and leaves from churn go in both. full sends every field in v2, not just motion.
+        void                                    Step        ( float dt, float churn, uint32_t timestamp, bool full, Bytes& v1, Bytes& v2 );
+
+        // Everyone currently present, as Join packets, for a client that has just connected
+        void                                    Snapshot    ( Bytes& joins ) const;
+
+        inline std::size_t                      Size        ( ) const { return _users.size(); }
+
+    protected:
+
+        void                                    Join        ( Bytes& out );
+        void                                    Leave       ( std::size_t index, Bytes& out );
+
+        std::mt19937                            _random;
+        std::vector<UserEvent>                  _users;
+        std::vector<UserEvent>                  _deltas;            // Scratch for the v2 packet
+        std::vector<ci::vec2>                   _velocities;
+        std::vector<bool>                       _fresh;             // Joined since the last step, v2 sends them in full
+        int32_t                                 _nextID{1};
+        uint16_t                                _sequence{0};
+        float                                   _propertyTimer{0.0f};
+        int                                     _steps{0};
+    };
+
+    ///
+    /// CrowdServer
+    ///
+
+    using CrowdServerRef = std::unique_ptr<class CrowdServer>;
+    class CrowdServer
+    {
+    public:
+
+        using Server                            = websocketpp::server<websocketpp::config::asio>;
+
+        struct Stats
+        {
+            int                                 Clients{0};
+            int                                 Users{0};
+            uint64_t                            Packets{0};
+            uint64_t                            Bytes{0};
+            uint64_t                            Lost{0};
+            uint64_t                            Reordered{0};
+        };
+
+        CrowdServer                             ( const CrowdOptions& options );
+        ~CrowdServer                            ( );
+
+        // Takes effect from the next update. Port changes are ignored.
+        void                                    SetOptions  ( const CrowdOptions& options );
+        CrowdOptions                            GetOptions  ( ) const;
+        Stats                                   GetStats    ( ) const;
+
+    protected:
+
+        struct Client
+        {
+            int                                 Version{1};
+            Bytes                               Held;               // Update waiting to be sent out of order
+        };
+
+        using ClientMap                         = std::map<websocketpp::connection_hdl, Client, std::owner_less<websocketpp::connection_hdl>>;
+
+        void                                    Schedule    ( );
+        void                                    Tick        ( );
+        void                                    Send        ( websocketpp::connection_hdl handle, const Bytes& packets );
+
+        asio::io_service&                       _service;
+        Reactor::Strand                         _strand;
+        Server                                  _server;
+        asio::steady_timer                      _timer;
+
+        // Only touched on _strand
+        CrowdOptions                            _options;
+        Crowd                                   _crowd;
+        ClientMap                               _clients;
+        std::mt19937                            _random;
+        double                                  _start;
+        Bytes                                   _v1;
+        Bytes                                   _v2;
+        Bytes                                   _joins;
+        bool                                    _full{true};        // Someone connected, resend every v2 field
+        bool                                    _stopping{false};
+
+        mutable std::mutex                      _statsLock;
+        Stats                                   _stats;
+        CrowdOptions                            _pendingOptions;    // Under _statsLock
+        bool                                    _optionsChanged{false};
+    };
+
+    ///
+    /// Ingest benchmark
+    ///
+
+    struct IngestTiming
+    {
+        int                                     Users{0};
+        double                                  Decode{0.0};        // Microseconds per frame: parse and queue
+        double                                  Apply{0.0};         // Drain into a UserTable, expire and sample
+        double                                  Inject{0.0};        // Turn the table into forces
+        double                                  MegabytesPerSecond{0.0};    // Decode throughput
+    };
+
+    // Runs frames of crowd traffic for users through the same path the app uses, on this thread.
+    // inject is timed as the force injection step.
+    IngestTiming                                BenchmarkIngest ( int users, int frames, const std::function<void ( UserTable& )>& inject );
+}
+
+#endif /* Fluid_CrowdServer_h */
@@ -0,0 +1,386 @@
+//
+//  FieldCodec.cxx
+//  Fluid
+//
+
+#include <Net/FieldCodec.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace Net
+{
+    ///
+    /// LZ
+    ///
+
+    static const int        kHashBits       = 14;
+    static const int        kMinMatch       = 4;
+    static const std::size_t kMaxOffset     = 65535;
+
+    // Each length byte past the token adds at most 255 output bytes, so no stream expands further than this
+    static const std::size_t kMaxExpansion  = 255;
+
+    static inline uint32_t Load32 ( const uint8_t * p )
+    {
+        uint32_t v;
+        std::memcpy ( &v, p, sizeof(v) );
+        return v;
+    }
+
+    static inline uint32_t Hash ( uint32_t v )
+    {
+        return ( v * 2654435761u ) >> ( 32 - kHashBits );
+    }
+
+    static inline void WriteLength ( Bytes& dst, std::size_t length )
+    {
+        while ( length >= 255 )
+        {
+            dst.push_back ( 255 );
+            length -= 255;
+        }
+        dst.push_back ( static_cast<uint8_t>( length ) );
+    }
+
+    static void EmitSequence ( Bytes& dst, const uint8_t * literals, std::size_t numLiterals, std::size_t offset, std::size_t matchLength )
+    {
+        std::size_t m = matchLength > 0 ? matchLength - kMinMatch : 0;
+
+        uint8_t token = static_cast<uint8_t>( ( std::min<std::size_t> ( numLiterals, 15 ) << 4 ) | std::min<std::size_t> ( m, 15 ) );
+        dst.push_back ( token );
+
+        if ( numLiterals >= 15 ) WriteLength ( dst, numLiterals - 15 );
+        dst.insert ( dst.end(), literals, literals + numLiterals );
+
+        if ( matchLength > 0 )
+        {
+            dst.push_back ( static_cast<uint8_t>( offset & 0xFF ) );
+            dst.push_back ( static_cast<uint8_t>( offset >> 8 ) );
+            if ( m >= 15 ) WriteLength ( dst, m - 15 );
+        }
+    }
+
+    std::size_t Compress ( const uint8_t * src, std::size_t size, Bytes& dst )
+    {
+        std::size_t start = dst.size();
+        dst.reserve ( start + size + size / 255 + 16 );
+
+        std::vector<int64_t> table ( 1 << kHashBits, -1 );
+
+        std::size_t anchor = 0;
+        std::size_t i = 0;
+
+        while ( i + kMinMatch <= size )
+        {
+            uint32_t v = Load32 ( src + i );
+            uint32_t h = Hash ( v );
+            int64_t candidate = table[h];
+            table[h] = static_cast<int64_t>( i );
+
+            // Offsets are taken unsigned once the slot is known to hold a position
+            std::size_t match = static_cast<std::size_t>( candidate );
+            if ( candidate >= 0 && i - match <= kMaxOffset && Load32 ( src + match ) == v )
+            {
+                std::size_t length = kMinMatch;
+                while ( i + length < size && src[match + length] == src[i + length] ) length++;
+
+                EmitSequence ( dst, src + anchor, i - anchor, i - match, length );
+
+                i += length;
+                anchor = i;
+            }else
+            {
+                i++;
+            }
+        }
+
+        // Trailing literals. Always emitted so the stream ends on a literal run.
+        EmitSequence ( dst, src + anchor, size - anchor, 0, 0 );
+
+        return dst.size() - start;
+    }
+
+    static inline bool ReadLength ( const uint8_t *& p, const uint8_t * end, std::size_t& length )
+    {
+        uint8_t b = 0;
+        do
+        {
+            if ( p >= end ) return false;
+            b = *p++;
+            length += b;
+        } while ( b == 255 );
+
+        return true;
+    }
+
+    bool Decompress ( const uint8_t * src, std::size_t size, uint8_t * dst, std::size_t dstSize )
+    {
+        const uint8_t * p = src;
+        const uint8_t * end = src + size;
+        std::size_t o = 0;
+
+        while ( p < end )
+        {
+            uint8_t token = *p++;
+
+            std::size_t numLiterals = token >> 4;
+            if ( numLiterals == 15 && !ReadLength ( p, end, numLiterals ) ) return false;
+            if ( numLiterals > static_cast<std::size_t>( end - p ) || numLiterals > dstSize - o ) return false;
+
+            std::memcpy ( dst + o, p, numLiterals );
+            p += numLiterals;
+            o += numLiterals;
+
+            if ( p == end ) break;
+
+            if ( end - p < 2 ) return false;
+            std::size_t offset = p[0] | ( p[1] << 8 );
+            p += 2;
+
+            std::size_t length = token & 0x0F;
+            if ( length == 15 && !ReadLength ( p, end, length ) ) return false;
+            length += kMinMatch;
+
+            if ( offset == 0 || offset > o || length > dstSize - o ) return false;
+
+            // Byte copy, matches may overlap the output
+            const uint8_t * from = dst + o - offset;
+            for ( std::size_t k = 0; k < length; k++ ) dst[o + k] = from[k];
+            o += length;
+        }
+
+        return o == dstSize;
+    }
+
+    ///
+    /// Fields
+    ///
+
+    // Larger than any simulation grid, and small enough that a field can't ask for an absurd allocation
+    static const int        kMaxFieldSize   = 4096;
+
+    bool QuantizedField::Matches ( const QuantizedField& other ) const
+    {
+        return Width == other.Width && Height == other.Height && Channels == other.Channels && Bits == other.Bits
+            && Min == other.Min && Max == other.Max && Values.size() == other.Values.size();
+    }
+
+    void Quantize ( const float * interleaved, int width, int height, int channels, int bits, QuantizedField& field, bool fixedRange )
+    {
+        field.Width = width;
+        field.Height = height;
+        field.Channels = std::min ( channels, 4 );
+        field.Bits = bits > 8 ? 16 : 8;
+
+        std::size_t n = field.PlaneSize();
+        field.Values.resize ( n * field.Channels );
+
+        const float levels = static_cast<float>( ( 1 << field.Bits ) - 1 );
+
+        for ( int c = 0; c < field.Channels; c++ )
+        {
+            if ( !fixedRange )
+            {
+                float lo = 0.0f;
+                float hi = 0.0f;
+                for ( std::size_t i = 0; i < n; i++ )
+                {
+                    float v = interleaved[i * channels + c];
+                    if ( !std::isfinite ( v ) ) continue;
+                    lo = std::min ( lo, v );
+                    hi = std::max ( hi, v );
+                }
+
+                field.Min[c] = lo;
+                field.Max[c] = hi;
+            }
+
+            float lo = field.Min[c];
+            float range = field.Max[c] - lo;
+            float scale = range > 0.0f ? levels / range : 0.0f;
+
+            uint16_t * plane = field.Values.data() + c * n;
+            for ( std::size_t i = 0; i < n; i++ )
+            {
+                float v = interleaved[i * channels + c];
+                if ( !std::isfinite ( v ) ) v = 0.0f;
+
+                float q = ( v - lo ) * scale + 0.5f;
+                q = std::max ( 0.0f, std::min ( q, levels ) );
+                plane[i] = static_cast<uint16_t>( q );
+            }
+        }
+    }
+
+    void Dequantize ( const QuantizedField& field, float * interleaved )
+    {
+        std::size_t n = field.PlaneSize();
+        const float levels = static_cast<float>( ( 1 << field.Bits ) - 1 );
+
+        for ( int c = 0; c < field.Channels; c++ )
+        {
+            float lo = field.Min[c];
+            float step = ( field.Max[c] - lo ) / levels;
+
+            const uint16_t * plane = field.Values.data() + c * n;
+            for ( std::size_t i = 0; i < n; i++ )
+            {
+                interleaved[i * field.Channels + c] = lo + plane[i] * step;
+            }
+        }
+    }
+
+    // Residuals are stored modulo 2^Bits, 16 bit fields as a low byte plane followed
+    // by a high byte plane so the compressor sees long runs of small values.
+    static void BuildResiduals ( const QuantizedField& field, DeltaMode mode, const QuantizedField * reference, Bytes& raw )
+    {
+        std::size_t n = field.PlaneSize();
+        int bytesPerValue = field.Bits / 8;
+        uint16_t mask = static_cast<uint16_t>( ( 1 << field.Bits ) - 1 );
+
+        raw.resize ( n * field.Channels * bytesPerValue );
+
+        for ( int c = 0; c < field.Channels; c++ )
+        {
+            const uint16_t * plane = field.Values.data() + c * n;
+            const uint16_t * ref = reference ? reference->Values.data() + c * n : nullptr;
+            uint8_t * lo = raw.data() + c * n * bytesPerValue;
+            uint8_t * hi = lo + n;
+
+            for ( int y = 0; y < field.Height; y++ )
+            {
+                for ( int x = 0; x < field.Width; x++ )
+                {
+                    std::size_t i = static_cast<std::size_t>( y ) * field.Width + x;
+
+                    uint16_t prediction = 0;
+                    if ( mode == DeltaMode::Temporal )
+                    {
+                        prediction = ref[i];
+                    }else
+                    {
+                        if ( x > 0 ) prediction = plane[i - 1];
+                        else if ( y > 0 ) prediction = plane[i - field.Width];
+                    }
+
+                    uint16_t d = static_cast<uint16_t>( plane[i] - prediction ) & mask;
+                    lo[i] = static_cast<uint8_t>( d & 0xFF );
+                    if ( bytesPerValue == 2 ) hi[i] = static_cast<uint8_t>( d >> 8 );
+                }
+            }
+        }
+    }
+
+    static void ApplyResiduals ( const Bytes& raw, DeltaMode mode, const QuantizedField * reference, QuantizedField& field )
+    {
+        std::size_t n = field.PlaneSize();
+        int bytesPerValue = field.Bits / 8;
+        uint16_t mask = static_cast<uint16_t>( ( 1 << field.Bits ) - 1 );
+
+        field.Values.resize ( n * field.Channels );
+
+        for ( int c = 0; c < field.Channels; c++ )
+        {
+            uint16_t * plane = field.Values.data() + c * n;
+            const uint16_t * ref = reference ? reference->Values.data() + c * n : nullptr;
+            const uint8_t * lo = raw.data() + c * n * bytesPerValue;
+            const uint8_t * hi = lo + n;
+
+            for ( int y = 0; y < field.Height; y++ )
+            {
+                for ( int x = 0; x < field.Width; x++ )
+                {
+                    std::size_t i = static_cast<std::size_t>( y ) * field.Width + x;
+
+                    uint16_t prediction = 0;
+                    if ( mode == DeltaMode::Temporal )
+                    {
+                        prediction = ref[i];
+                    }else
+                    {
+                        if ( x > 0 ) prediction = plane[i - 1];
+                        else if ( y > 0 ) prediction = plane[i - field.Width];
+                    }
+
+                    uint16_t d = lo[i];
+                    if ( bytesPerValue == 2 ) d |= static_cast<uint16_t>( hi[i] << 8 );
+                    plane[i] = static_cast<uint16_t>( prediction + d ) & mask;
+                }
+            }
+        }
+    }
+
+    void EncodeField ( const QuantizedField& field, DeltaMode mode, const QuantizedField * reference, Bytes& out )
+    {
+        if ( mode == DeltaMode::Temporal && ( !reference || !reference->Matches ( field ) ) ) mode = DeltaMode::Spatial;
+
+        Bytes raw;
+        BuildResiduals ( field, mode, reference, raw );
+
+        Write<uint16_t> ( out, static_cast<uint16_t>( field.Width ) );
+        Write<uint16_t> ( out, static_cast<uint16_t>( field.Height ) );
+        Write<uint8_t>  ( out, static_cast<uint8_t>( field.Channels ) );
+        Write<uint8_t>  ( out, static_cast<uint8_t>( field.Bits ) );
+        Write<uint8_t>  ( out, static_cast<uint8_t>( mode ) );
+
+        for ( int c = 0; c < field.Channels; c++ )
+        {
+            Write<float> ( out, field.Min[c] );
+            Write<float> ( out, field.Max[c] );
+        }
+
+        Write<uint32_t> ( out, static_cast<uint32_t>( raw.size() ) );
+
+        std::size_t sizeOffset = out.size();
+        Write<uint32_t> ( out, 0 );
+
+        uint32_t compressed = static_cast<uint32_t>( Compress ( raw.data(), raw.size(), out ) );
+        std::memcpy ( out.data() + sizeOffset, &compressed, sizeof(compressed) );
+    }
+
+    bool DecodeField ( const uint8_t * data, std::size_t size, const QuantizedField * reference, QuantizedField& field, std::size_t& consumed )
+    {
+        const uint8_t * p = data;
+        const uint8_t * end = data + size;
+
+        uint16_t width = 0, height = 0;
+        uint8_t channels = 0, bits = 0, mode = 0;
+
+        if ( !Read ( p, end, width ) || !Read ( p, end, height ) ) return false;
+        if ( !Read ( p, end, channels ) || !Read ( p, end, bits ) || !Read ( p, end, mode ) ) return false;
+        if ( channels < 1 || channels > 4 || ( bits != 8 && bits != 16 ) ) return false;
+        if ( mode > static_cast<uint8_t>( DeltaMode::Temporal ) ) return false;
+        if ( width > kMaxFieldSize || height > kMaxFieldSize ) return false;
+
+        field.Width = width;
+        field.Height = height;
+        field.Channels = channels;
+        field.Bits = bits;
+
+        for ( int c = 0; c < channels; c++ )
+        {
+            if ( !Read ( p, end, field.Min[c] ) || !Read ( p, end, field.Max[c] ) ) return false;
+        }
+
+        uint32_t rawSize = 0, compressedSize = 0;
+        if ( !Read ( p, end, rawSize ) || !Read ( p, end, compressedSize ) ) return false;
+        if ( rawSize != field.PlaneSize() * channels * ( bits / 8 ) ) return false;
+        if ( compressedSize > static_cast<std::size_t>( end - p ) ) return false;
+
+        // Checked before anything is allocated, a header on its own can't make us reserve more than the data could fill
+        if ( rawSize / kMaxExpansion > compressedSize ) return false;
+
+        DeltaMode deltaMode = static_cast<DeltaMode>( mode );
+        field.Values.resize ( field.PlaneSize() * channels );
+        if ( deltaMode == DeltaMode::Temporal && ( !reference || !reference->Matches ( field ) ) ) return false;
+
+        Bytes raw ( rawSize );
+        if ( !Decompress ( p, compressedSize, raw.data(), raw.size() ) ) return false;
+
+        ApplyResiduals ( raw, deltaMode, reference, field );
+
+        consumed = ( p - data ) + compressedSize;
+        return true;
+    }
+}
@@ -0,0 +1,92 @@
+//
+//  FieldCodec.h
+//  Fluid
+//
+//  Quantized, delta-coded and LZ compressed encoding of the simulation
+//  fields. Used to ship fluid state between nodes and to viewers.
+//
+
+#ifndef Fluid_FieldCodec_h
+#define Fluid_FieldCodec_h
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace Net
+{
+    using Bytes = std::vector<uint8_t>;
+
+    ///
+    /// LZ
+    ///
+
+    // LZ77 byte compressor (LZ4 style token stream, 64k window). Appends to dst
+    // and returns the number of bytes written.
+    std::size_t             Compress        ( const uint8_t * src, std::size_t size, Bytes& dst );
+
+    // Returns false if the stream is malformed or does not decode to exactly dstSize bytes.
+    bool                    Decompress      ( const uint8_t * src, std::size_t size, uint8_t * dst, std::size_t dstSize );
+
+    ///
+    /// Fields
+    ///
+
+    enum class DeltaMode : uint8_t
+    {
+        Spatial,            // Predict from the left / upper neighbour. Self contained.
+        Temporal            // Predict from the same cell in a reference field.
+    };
+
+    struct QuantizedField
+    {
+        int                         Width{0};
+        int                         Height{0};
+        int                         Channels{0};
+        int                         Bits{8};
+
+        std::array<float, 4>        Min{ { 0.0f, 0.0f, 0.0f, 0.0f } };
+        std::array<float, 4>        Max{ { 1.0f, 1.0f, 1.0f, 1.0f } };
+
+        std::vector<uint16_t>       Values; // Planar, Channels * Width * Height
+
+        inline std::size_t          PlaneSize           ( ) const { return static_cast<std::size_t>(Width) * Height; }
+        bool                        Matches             ( const QuantizedField& other ) const;
+    };
+
+    // Quantizes an interleaved float image into Bits (8 or 16) per channel. If fixedRange
+    // is set the Min / Max already on the field are used, otherwise they are measured.
+    void                    Quantize        ( const float * interleaved, int width, int height, int channels, int bits, QuantizedField& field, bool fixedRange = false );
+    void                    Dequantize      ( const QuantizedField& field, float * interleaved );
+
+    // Appends an encoded field to out. reference is required for DeltaMode::Temporal and
+    // must have the same layout and range as field.
+    void                    EncodeField     ( const QuantizedField& field, DeltaMode mode, const QuantizedField * reference, Bytes& out );
+
+    // Decodes one field starting at data. consumed receives the number of bytes used.
+    bool                    DecodeField     ( const uint8_t * data, std::size_t size, const QuantizedField * reference, QuantizedField& field, std::size_t& consumed );
+
+    ///
+    /// Byte helpers
+    ///
+
+    template <typename T>
+    inline void             Write           ( Bytes& out, const T& value )
+    {
+        const uint8_t * p = reinterpret_cast<const uint8_t *>( &value );
+        out.insert ( out.end(), p, p + sizeof(T) );
+    }
+
+    template <typename T>
+    inline bool             Read            ( const uint8_t *& cursor, const uint8_t * end, T& value )
+    {
+        if ( static_cast<std::size_t>( end - cursor ) < sizeof(T) ) return false;
+        std::copy ( cursor, cursor + sizeof(T), reinterpret_cast<uint8_t *>( &value ) );
+        cursor += sizeof(T);
+        return true;
+    }
+}
+
+#endif /* Fluid_FieldCodec_h */
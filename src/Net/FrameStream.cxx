@@ -0,0 +1,295 @@
+//
+//  FrameStream.cxx
+//  Fluid
+//
+
+#include <Net/FrameStream.h>
+#include "cinder/app/App.h"
+
+#include <iostream>
+
+using namespace ci;
+
+namespace Net
+{
+    namespace
+    {
+        const uint32_t      kFrameMagic     = 0x4D524646; // 'FFRM'
+        const uint16_t      kVersion        = 1;
+    }
+
+    ///
+    /// FrameStreamOptions
+    ///
+
+    FrameStreamOptions FrameStreamOptions::FromJson ( const JsonTree& tree )
+    {
+        FrameStreamOptions o;
+        if ( tree.hasChild( "Port" ) ) o.Port = tree["Port"].getValue<int>();
+        if ( tree.hasChild( "Width" ) ) o.Resolution.x = tree["Width"].getValue<int>();
+        if ( tree.hasChild( "Height" ) ) o.Resolution.y = tree["Height"].getValue<int>();
+        if ( tree.hasChild( "Rate" ) ) o.Rate = tree["Rate"].getValue<float>();
+        if ( tree.hasChild( "Bits" ) ) o.Bits = tree["Bits"].getValue<int>() > 8 ? 16 : 8;
+        if ( tree.hasChild( "Velocity" ) ) o.IncludeVelocity = tree["Velocity"].getValue<bool>();
+        if ( tree.hasChild( "DensityRange" ) ) o.DensityRange = tree["DensityRange"].getValue<float>();
+        if ( tree.hasChild( "VelocityRange" ) ) o.VelocityRange = tree["VelocityRange"].getValue<float>();
+        if ( tree.hasChild( "MaxBufferedKB" ) ) o.MaxBuffered = tree["MaxBufferedKB"].getValue<int>() * 1024;
+
+        o.Resolution = glm::max ( o.Resolution, ivec2 ( 1 ) );
+        o.Rate = std::max ( o.Rate, 1.0f );
+        return o;
+    }
+
+    ///
+    /// FrameStream
+    ///
+
+    FrameStream::FrameStream ( const FrameStreamOptions& options )
+    : _options ( options )
+    , _service ( Reactor::Get().Service() )
+    , _strand ( _service )
+    {
+        _server.clear_access_channels( websocketpp::log::alevel::all );
+        _server.clear_error_channels( websocketpp::log::elevel::all );
+
+        try
+        {
+            _server.init_asio ( &_service );
+            _server.set_reuse_addr ( true );
+
+            // Connections open and close on whichever reactor thread, the viewer list lives on our strand
+            _server.set_open_handler ( [this] ( websocketpp::connection_hdl handle )
+            {
+                _strand.post ( [this, handle]
+                {
+                    _viewers[handle] = Viewer();
+
+                    std::lock_guard<std::mutex> lock ( _statsLock );
+                    _stats.Viewers = static_cast<int>( _viewers.size() );
+                } );
+            } );
+
+            _server.set_close_handler ( [this] ( websocketpp::connection_hdl handle )
+            {
+                _strand.post ( [this, handle]
+                {
+                    _viewers.erase ( handle );
+
+                    std::lock_guard<std::mutex> lock ( _statsLock );
+                    _stats.Viewers = static_cast<int>( _viewers.size() );
+                } );
+            } );
+
+            _server.listen ( _options.Port );
+            _server.start_accept ( );
+
+            std::cout << "Streaming " << _options.Resolution << " frames at " << _options.Rate << "fps on port " << _options.Port << std::endl;
+        }catch ( const std::exception& e )
+        {
+            std::cout << "Error opening frame stream on port " << _options.Port << ": " << e.what() << std::endl;
+        }
+    }
+
+    void FrameStream::Update ( Fluid::Sim& sim )
+    {
+        double now = app::getElapsedSeconds();
+        if ( now - _lastPublish < 1.0 / _options.Rate ) return;
+
+        {
+            std::lock_guard<std::mutex> lock ( _statsLock );
+            if ( _stats.Viewers == 0 ) return;
+
+            if ( _encoding )
+            {
+                _stats.FramesDropped++;
+                return;
+            }
+        }
+
+        _lastPublish = now;
+
+        // _density / _velocity belong to the strand until it clears _encoding
+        sim.CaptureField ( Fluid::Field::Density, _options.Resolution, _density );
+        if ( _options.IncludeVelocity ) sim.CaptureField ( Fluid::Field::Velocity, _options.Resolution, _velocity );
+
+        _encoding = true;
+        _strand.post ( [this]
+        {
+            Encode ( _density, _velocity );
+            _encoding = false;
+        } );
+    }
+
+    void FrameStream::Quantize ( const std::vector<float>& values, Fluid::Field field, QuantizedField& out ) const
+    {
+        // Fixed ranges so consecutive frames can be delta coded against each other
+        bool velocity = field == Fluid::Field::Velocity;
+        float lo = velocity ? -_options.VelocityRange : 0.0f;
+        float hi = velocity ? _options.VelocityRange : _options.DensityRange;
+
+        out.Min.fill ( lo );
+        out.Max.fill ( hi );
+
+        Net::Quantize ( values.data(), _options.Resolution.x, _options.Resolution.y, Fluid::ChannelCount ( field ), _options.Bits, out, true );
+    }
+
+    void FrameStream::Header ( Bytes& out, uint8_t flags ) const
+    {
+        Write<uint32_t> ( out, kFrameMagic );
+        Write<uint16_t> ( out, kVersion );
+        Write<uint32_t> ( out, _sequence );
+        Write<uint8_t>  ( out, flags );
+    }
+
+    void FrameStream::Encode ( std::vector<float>& density, std::vector<float>& velocity )
+    {
+        bool withVelocity = _options.IncludeVelocity;
+
+        QuantizedField d, v;
+        Quantize ( density, Fluid::Field::Density, d );
+        if ( withVelocity ) Quantize ( velocity, Fluid::Field::Velocity, v );
+
+        bool canDelta = _sequence > 0 && d.Matches ( _previousDensity ) && ( !withVelocity || v.Matches ( _previousVelocity ) );
+        _sequence++;
+
+        uint8_t flags = withVelocity ? FrameFlags::Velocity : 0;
+
+        // Built on demand, shared by every viewer that needs them
+        std::unique_ptr<Bytes> delta, keyframe;
+
+        uint64_t sent = 0, skipped = 0, bytes = 0;
+        for ( auto& it : _viewers )
+        {
+            websocketpp::lib::error_code error;
+            auto connection = _server.get_con_from_hdl ( it.first, error );
+            if ( error ) continue;
+
+            // Let slow viewers drain. The next frame they do get will be a keyframe.
+            if ( connection->get_buffered_amount() > _options.MaxBuffered )
+            {
+                skipped++;
+                continue;
+            }
+
+            auto& viewer = it.second;
+            bool useDelta = canDelta && viewer.HasFrame && viewer.LastSequence + 1 == _sequence;
+
+            Bytes * message = nullptr;
+            if ( useDelta )
+            {
+                if ( !delta )
+                {
+                    delta = std::make_unique<Bytes>();
+                    Header ( *delta, flags );
+                    EncodeField ( d, DeltaMode::Temporal, &_previousDensity, *delta );
+                    if ( withVelocity ) EncodeField ( v, DeltaMode::Temporal, &_previousVelocity, *delta );
+                }
+                message = delta.get();
+            }else
+            {
+                if ( !keyframe )
+                {
+                    keyframe = std::make_unique<Bytes>();
+                    Header ( *keyframe, flags | FrameFlags::Keyframe );
+                    EncodeField ( d, DeltaMode::Spatial, nullptr, *keyframe );
+                    if ( withVelocity ) EncodeField ( v, DeltaMode::Spatial, nullptr, *keyframe );
+                }
+                message = keyframe.get();
+            }
+
+            connection->send ( message->data(), message->size(), websocketpp::frame::opcode::binary );
+
+            viewer.LastSequence = _sequence;
+            viewer.HasFrame = true;
+            sent++;
+            bytes += message->size();
+        }
+
+        _previousDensity = std::move ( d );
+        _previousVelocity = std::move ( v );
+
+        std::lock_guard<std::mutex> lock ( _statsLock );
+        _stats.FramesEncoded++;
+        _stats.FramesSent += sent;
+        _stats.FramesSkipped += skipped;
+        _stats.BytesSent += bytes;
+        if ( delta ) _stats.LastDeltaSize = delta->size();
+        if ( keyframe ) _stats.LastKeyframeSize = keyframe->size();
+    }
+
+    FrameStream::Stats FrameStream::GetStats ( ) const
+    {
+        std::lock_guard<std::mutex> lock ( _statsLock );
+        return _stats;
+    }
+
+    FrameStream::~FrameStream ( )
+    {
+        _strand.post ( [this]
+        {
+            websocketpp::lib::error_code ignored;
+            _server.stop_listening ( ignored );
+            for ( auto& it : _viewers )
+            {
+                _server.close ( it.first, websocketpp::close::status::going_away, "", ignored );
+            }
+        } );
+
+        Reactor::Get().Drain ( _strand );
+    }
+
+    ///
+    /// FrameDecoder
+    ///
+
+    bool FrameDecoder::Decode ( const uint8_t * data, std::size_t size )
+    {
+        const uint8_t * p = data;
+        const uint8_t * end = data + size;
+
+        uint32_t magic = 0, sequence = 0;
+        uint16_t version = 0;
+        uint8_t flags = 0;
+
+        if ( !Read ( p, end, magic ) || magic != kFrameMagic ) return false;
+        if ( !Read ( p, end, version ) || version != kVersion ) return false;
+        if ( !Read ( p, end, sequence ) ) return false;
+        if ( !Read ( p, end, flags ) ) return false;
+
+        bool keyframe = ( flags & FrameFlags::Keyframe ) != 0;
+        bool velocity = ( flags & FrameFlags::Velocity ) != 0;
+
+        if ( !keyframe && ( !_hasFrame || sequence != _sequence + 1 ) ) return false;
+
+        QuantizedField d, v;
+        std::size_t consumed = 0;
+
+        if ( !DecodeField ( p, end - p, keyframe ? nullptr : &_density, d, consumed ) ) return false;
+        if ( d.Channels != 4 ) return false;
+        p += consumed;
+
+        if ( velocity )
+        {
+            if ( !keyframe && !_hasVelocity ) return false;
+            if ( !DecodeField ( p, end - p, keyframe ? nullptr : &_velocity, v, consumed ) ) return false;
+            if ( v.Channels != 3 || v.Width != d.Width || v.Height != d.Height ) return false;
+        }
+
+        _density = std::move ( d );
+        _size = ivec2 ( _density.Width, _density.Height );
+        Density.resize ( _density.Values.size() );
+        Dequantize ( _density, Density.data() );
+
+        _hasVelocity = velocity;
+        if ( velocity )
+        {
+            _velocity = std::move ( v );
+            Velocity.resize ( _velocity.Values.size() );
+            Dequantize ( _velocity, Velocity.data() );
+        }
+
+        _sequence = sequence;
+        _hasFrame = true;
+        return true;
+    }
+}
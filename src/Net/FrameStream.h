@@ -0,0 +1,143 @@
+//
+//  FrameStream.h
+//  Fluid
+//
+//  Streams the simulation to thin viewers over WebSocket. Each frame is
+//  quantized and sent either as a keyframe or as a delta against the
+//  previous frame, depending on what the viewer last received.
+//
+
+#ifndef Fluid_FrameStream_h
+#define Fluid_FrameStream_h
+
+#include "WebSocketConnection.h"
+#include "websocketpp/config/asio_no_tls.hpp"
+#include "websocketpp/server.hpp"
+
+#include "Fluid.h"
+#include <Net/FieldCodec.h>
+#include <Net/Reactor.h>
+
+#include <atomic>
+#include <map>
+
+namespace Net
+{
+    ///
+    /// Frame format
+    ///
+    /// u32 magic 'FFRM', u16 version, u32 sequence, u8 flags, then a density
+    /// field and (if FrameFlags::Velocity) a velocity field as written by
+    /// EncodeField. Keyframes are spatially coded, the rest temporally.
+    ///
+
+    enum FrameFlags : uint8_t
+    {
+        Keyframe    = 1 << 0,
+        Velocity    = 1 << 1,
+    };
+
+    struct FrameStreamOptions
+    {
+        int                                     Port{9200};
+        ci::ivec2                               Resolution{160, 90};
+        float                                   Rate{15.0f};                // Frames per second
+        int                                     Bits{8};
+        bool                                    IncludeVelocity{false};
+        float                                   DensityRange{12.0f};        // Quantized over [0, DensityRange]
+        float                                   VelocityRange{10.0f};       // Quantized over [-VelocityRange, VelocityRange]
+        std::size_t                             MaxBuffered{256 * 1024};    // Per viewer, frames are skipped beyond this
+
+        static FrameStreamOptions               FromJson    ( const ci::JsonTree& tree );
+    };
+
+    using FrameStreamRef = std::unique_ptr<class FrameStream>;
+    class FrameStream
+    {
+    public:
+
+        using Server                            = websocketpp::server<websocketpp::config::asio>;
+
+        struct Stats
+        {
+            int                                 Viewers{0};
+            uint64_t                            FramesEncoded{0};
+            uint64_t                            FramesSent{0};
+            uint64_t                            FramesSkipped{0};           // Viewer was backed up
+            uint64_t                            FramesDropped{0};           // Encoder was still busy
+            uint64_t                            BytesSent{0};
+            std::size_t                         LastDeltaSize{0};
+            std::size_t                         LastKeyframeSize{0};
+        };
+
+        FrameStream                             ( const FrameStreamOptions& options );
+        ~FrameStream                            ( );
+
+        // Captures and sends a frame if one is due. Call once per frame on the main thread.
+        void                                    Update      ( Fluid::Sim& sim );
+
+        Stats                                   GetStats    ( ) const;
+        inline const FrameStreamOptions&        GetOptions  ( ) const { return _options; }
+
+    protected:
+
+        struct Viewer
+        {
+            uint32_t                            LastSequence{0};
+            bool                                HasFrame{false};
+        };
+
+        using ViewerMap                         = std::map<websocketpp::connection_hdl, Viewer, std::owner_less<websocketpp::connection_hdl>>;
+
+        void                                    Encode      ( std::vector<float>& density, std::vector<float>& velocity );
+        void                                    Quantize    ( const std::vector<float>& values, Fluid::Field field, QuantizedField& out ) const;
+        void                                    Header      ( Bytes& out, uint8_t flags ) const;
+
+        FrameStreamOptions                      _options;
+
+        asio::io_service&                       _service;
+        Reactor::Strand                         _strand;
+        Server                                  _server;
+
+        // Only touched on _strand
+        ViewerMap                               _viewers;
+        QuantizedField                          _previousDensity;
+        QuantizedField                          _previousVelocity;
+        uint32_t                                _sequence{0};
+
+        std::atomic<bool>                       _encoding{false};
+        double                                  _lastPublish{0.0};
+        std::vector<float>                      _density;           // Owned by _strand while _encoding is set
+        std::vector<float>                      _velocity;
+
+        mutable std::mutex                      _statsLock;
+        Stats                                   _stats;
+    };
+
+    // Viewer side. Keeps the last frame so deltas can be applied.
+    class FrameDecoder
+    {
+    public:
+
+        // Returns false for malformed frames or a delta we have no reference for.
+        bool                                    Decode      ( const uint8_t * data, std::size_t size );
+
+        inline const ci::ivec2&                 Size        ( ) const { return _size; }
+        inline bool                             HasVelocity ( ) const { return _hasVelocity; }
+        inline uint32_t                         Sequence    ( ) const { return _sequence; }
+
+        std::vector<float>                      Density;    // RGBA, rows bottom up
+        std::vector<float>                      Velocity;   // RGB
+
+    protected:
+
+        QuantizedField                          _density;
+        QuantizedField                          _velocity;
+        ci::ivec2                               _size;
+        uint32_t                                _sequence{0};
+        bool                                    _hasFrame{false};
+        bool                                    _hasVelocity{false};
+    };
+}
+
+#endif /* Fluid_FrameStream_h */
@@ -0,0 +1,93 @@
+//
+//  Reactor.cxx
+//  Fluid
+//
+
+#include <Net/Reactor.h>
+
+#include <algorithm>
+#include <future>
+#include <iostream>
+
+namespace Net
+{
+    namespace
+    {
+        int                 kConfiguredThreads  = Reactor::kDefaultThreads;
+        bool                kStarted            = false;
+    }
+
+    Reactor& Reactor::Get ( )
+    {
+        static Reactor instance ( kConfiguredThreads );
+        return instance;
+    }
+
+    void Reactor::Configure ( int threads )
+    {
+        if ( kStarted )
+        {
+            std::cout << "Reactor: already running, ignoring thread count " << threads << std::endl;
+            return;
+        }
+
+        kConfiguredThreads = std::max ( threads, 1 );
+    }
+
+    Reactor::Reactor ( int threads )
+    : _work ( new asio::io_service::work ( _service ) )
+    {
+        kStarted = true;
+
+        for ( int i = 0; i < threads; i++ )
+        {
+            _threads.emplace_back ( [this]
+            {
+                _service.run();
+            } );
+        }
+
+        std::cout << "Reactor: running network I/O on " << threads << " thread(s)" << std::endl;
+    }
+
+    bool Reactor::IsRunning ( ) const
+    {
+        std::lock_guard<std::mutex> lock ( _lock );
+        return _work && !_service.stopped();
+    }
+
+    void Reactor::Drain ( Strand& strand )
+    {
+        if ( !IsRunning() || strand.running_in_this_thread() ) return;
+
+        auto self = std::this_thread::get_id();
+        for ( auto& t : _threads )
+        {
+            if ( t.get_id() == self ) return;
+        }
+
+        std::promise<void> done;
+        strand.post ( [&done] { done.set_value(); } );
+        done.get_future().wait();
+    }
+
+    void Reactor::Shutdown ( )
+    {
+        {
+            std::lock_guard<std::mutex> lock ( _lock );
+            if ( !_work ) return;
+            _work = nullptr;
+        }
+
+        _service.stop();
+        for ( auto& t : _threads )
+        {
+            if ( t.joinable() ) t.join();
+        }
+    }
+
+    Reactor::~Reactor ( )
+    {
+        Shutdown ( );
+    }
+}
@@ -0,0 +1,120 @@
+//
+//  Reactor.h
+//  Fluid
+//
+//  The one io_service every network endpoint in the app runs on, driven by
+//  a small fixed pool of threads. Endpoints keep their own handlers in order
+//  with a strand rather than owning a thread each.
+//
+
+#ifndef Fluid_Reactor_h
+#define Fluid_Reactor_h
+
+#if ! defined( ASIO_STANDALONE )
+#define ASIO_STANDALONE 1
+#endif
+#include "asio/asio.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Net
+{
+    class Reactor
+    {
+    public:
+
+        using Strand                            = asio::io_service::strand;
+
+        static const int                        kDefaultThreads = 2;
+
+        // Started on first use with the configured thread count
+        static Reactor&                         Get             ( );
+
+        // Only takes effect before the first Get()
+        static void                             Configure       ( int threads );
+
+        inline asio::io_service&                Service         ( ) { return _service; }
+        inline int                              Threads         ( ) const { return static_cast<int>( _threads.size() ); }
+        bool                                    IsRunning       ( ) const;
+
+        // Blocks until everything already queued on strand has run. Endpoints call this
+        // from their destructors after closing their sockets. Main thread only.
+        void                                    Drain           ( Strand& strand );
+
+        // Stops and joins the pool. Call on cleanup, before the endpoints are destroyed.
+        void                                    Shutdown        ( );
+
+        ~Reactor                                ( );
+
+    protected:
+
+        Reactor                                 ( int threads );
+
+        asio::io_service                        _service;
+        std::unique_ptr<asio::io_service::work> _work;
+        std::vector<std::thread>                _threads;
+        mutable std::mutex                      _lock;
+    };
+
+    ///
+    /// Handler memory
+    ///
+
+    // Room for one handler in flight, so a hot path can keep posting the same job without
+    // touching the heap. A second handler posted before the first runs falls back to new.
+    // Held by shared_ptr, since a handler still queued at shutdown is freed after its owner.
+    using HandlerMemoryRef = std::shared_ptr<class HandlerMemory>;
+    class HandlerMemory
+    {
+    public:
+
+        void *                                  Allocate        ( std::size_t size )
+        {
+            if ( size <= sizeof(_storage) && !_inUse.exchange ( true ) ) return &_storage;
+            return ::operator new ( size );
+        }
+
+        void                                    Deallocate      ( void * pointer )
+        {
+            if ( pointer == &_storage ) _inUse = false;
+            else ::operator delete ( pointer );
+        }
+
+    protected:
+
+        std::aligned_storage<256>::type         _storage;
+        std::atomic<bool>                       _inUse{false};
+    };
+
+    template <typename Handler>
+    class HandlerWithMemory
+    {
+    public:
+
+        HandlerWithMemory                       ( const HandlerMemoryRef& memory, Handler handler ) : _memory ( memory ), _handler ( handler ) { }
+
+        template <typename ... Args>
+        void                                    operator()      ( Args&& ... args ) { _handler ( std::forward<Args>( args )... ); }
+
+        friend void *                           asio_handler_allocate   ( std::size_t size, HandlerWithMemory * self ) { return self->_memory->Allocate ( size ); }
+        friend void                             asio_handler_deallocate ( void * pointer, std::size_t, HandlerWithMemory * self ) { self->_memory->Deallocate ( pointer ); }
+
+    protected:
+
+        HandlerMemoryRef                        _memory;
+        Handler                                 _handler;
+    };
+
+    template <typename Handler>
+    inline HandlerWithMemory<Handler>           WithMemory      ( const HandlerMemoryRef& memory, Handler handler )
+    {
+        return HandlerWithMemory<Handler> ( memory, handler );
+    }
+}
+
+#endif /* Fluid_Reactor_h */
@@ -0,0 +1,98 @@
+//
+//  Reconnector.cxx
+//  Fluid
+//
+
+#include <Net/Reconnector.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace Net
+{
+    namespace
+    {
+        const float         kFirstBackoff   = 0.5f;     // Seconds
+        const float         kMaxBackoff     = 10.0f;
+    }
+
+    Reconnector::Reconnector ( WebSocketClient& client, const std::string& endpoint )
+    : _client ( client )
+    , _endpoint ( endpoint )
+    , _strand ( Reactor::Get().Service() )
+    , _retryTimer ( Reactor::Get().Service() )
+    , _backoff ( kFirstBackoff )
+    {
+    }
+
+    void Reconnector::Start ( )
+    {
+        _strand.post ( [this] { Connect ( ); } );
+    }
+
+    void Reconnector::Opened ( )
+    {
+        _connected = true;
+        _strand.post ( [this] { _backoff = kFirstBackoff; } );
+    }
+
+    void Reconnector::Closed ( )
+    {
+        _connected = false;
+        _strand.post ( [this] { Retry ( ); } );
+    }
+
+    void Reconnector::Connect ( )
+    {
+        if ( _stopping ) return;
+        _client.connect ( _endpoint );
+    }
+
+    void Reconnector::Retry ( )
+    {
+        // Close and fail can both report the same attempt
+        if ( _stopping || _retryPending ) return;
+
+        _retryPending = true;
+        _nextBackoff = _backoff;
+
+        _retryTimer.expires_from_now ( std::chrono::milliseconds ( static_cast<int>( _backoff * 1000.0f ) ) );
+        _retryTimer.async_wait ( _strand.wrap ( [this] ( asio::error_code error )
+        {
+            _retryPending = false;
+            if ( error ) return;
+
+            _reconnects++;
+            _nextBackoff = 0.0f;
+            Connect ( );
+        } ) );
+
+        _backoff = std::min ( _backoff * 2.0f, kMaxBackoff );
+    }
+
+    float Reconnector::Backoff ( ) const
+    {
+        return _connected ? 0.0f : _nextBackoff.load();
+    }
+
+    void Reconnector::Stop ( )
+    {
+        if ( _stopped.exchange ( true ) ) return;
+
+        _strand.post ( [this]
+        {
+            _stopping = true;
+
+            asio::error_code ignored;
+            _retryTimer.cancel ( ignored );
+            if ( _connected ) _client.disconnect();
+        } );
+
+        Reactor::Get().Drain ( _strand );
+    }
+
+    Reconnector::~Reconnector ( )
+    {
+        Stop ( );
+    }
+}
@@ -0,0 +1,68 @@
+//
+//  Reconnector.h
+//  Fluid
+//
+//  Keeps a WebSocketClient on the shared reactor connected, retrying with
+//  exponential backoff after it closes or fails to connect. The owner
+//  forwards the client's open, close and fail events.
+//
+
+#ifndef Fluid_Reconnector_h
+#define Fluid_Reconnector_h
+
+#include "WebSocketClient.h"
+
+#include <Net/Reactor.h>
+
+#include <atomic>
+
+namespace Net
+{
+    class Reconnector
+    {
+    public:
+
+        // client must outlive this, and run on Reactor::Get().Service()
+        Reconnector                             ( WebSocketClient& client, const std::string& endpoint );
+        ~Reconnector                            ( );
+
+        // Makes the first attempt
+        void                                    Start           ( );
+
+        // Stops retrying and disconnects. Blocks until nothing of ours is left running. Main thread.
+        void                                    Stop            ( );
+
+        // From the client's handlers, any thread
+        void                                    Opened          ( );
+        void                                    Closed          ( );
+
+        inline bool                             IsConnected     ( ) const { return _connected; }
+        inline const std::string&               Endpoint        ( ) const { return _endpoint; }
+        inline uint64_t                         Reconnects      ( ) const { return _reconnects; }
+
+        // Delay before the pending retry while disconnected, otherwise 0
+        float                                   Backoff         ( ) const;
+
+    protected:
+
+        void                                    Connect         ( );
+        void                                    Retry           ( );
+
+        WebSocketClient&                        _client;
+        std::string                             _endpoint;
+        Reactor::Strand                         _strand;
+
+        // Only touched on _strand
+        asio::steady_timer                      _retryTimer;
+        float                                   _backoff;
+        bool                                    _retryPending{false};
+        bool                                    _stopping{false};
+
+        std::atomic<bool>                       _stopped{false};
+        std::atomic<bool>                       _connected{false};
+        std::atomic<uint64_t>                   _reconnects{0};
+        std::atomic<float>                      _nextBackoff{0.0f};
+    };
+}
+
+#endif /* Fluid_Reconnector_h */
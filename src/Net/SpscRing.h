@@ -0,0 +1,77 @@
+//
+//  SpscRing.h
+//  Fluid
+//
+//  Fixed capacity single producer / single consumer ring. Slots are written
+//  in place, so nothing is allocated or copied after construction.
+//
+
+#ifndef Fluid_SpscRing_h
+#define Fluid_SpscRing_h
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace Net
+{
+    template <typename T, std::size_t Capacity>
+    class SpscRing
+    {
+    public:
+
+        static_assert ( Capacity > 0 && ( Capacity & ( Capacity - 1 ) ) == 0, "Capacity must be a power of two" );
+
+        ///
+        /// Producer
+        ///
+
+        // Next free slot, or nullptr when full. Nothing is visible to the consumer until Commit.
+        T *                                     Claim       ( )
+        {
+            std::size_t head = _head.load ( std::memory_order_relaxed );
+            if ( head - _cachedTail == Capacity )
+            {
+                _cachedTail = _tail.load ( std::memory_order_acquire );
+                if ( head - _cachedTail == Capacity ) return nullptr;
+            }
+            return &_slots[head & ( Capacity - 1 )];
+        }
+
+        void                                    Commit      ( )
+        {
+            _head.store ( _head.load ( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+
+        ///
+        /// Consumer
+        ///
+
+        std::size_t                             Available   ( ) const
+        {
+            return _head.load ( std::memory_order_acquire ) - _tail.load ( std::memory_order_relaxed );
+        }
+
+        // index is relative to the oldest unreleased slot, and must be below Available()
+        const T&                                At          ( std::size_t index ) const
+        {
+            return _slots[( _tail.load ( std::memory_order_relaxed ) + index ) & ( Capacity - 1 )];
+        }
+
+        void                                    Release     ( std::size_t count )
+        {
+            _tail.store ( _tail.load ( std::memory_order_relaxed ) + count, std::memory_order_release );
+        }
+
+    protected:
+
+        std::array<T, Capacity>                 _slots;
+
+        // Kept on separate cache lines so the two threads don't fight over them
+        alignas(64) std::atomic<std::size_t>    _head{0};
+        std::size_t                             _cachedTail{0};         // Producer's last look at _tail
+        alignas(64) std::atomic<std::size_t>    _tail{0};
+    };
+}
+
+#endif /* Fluid_SpscRing_h */
@@ -0,0 +1,221 @@
+//
+//  UserFeed.cxx
+//  Fluid
+//
+
+#include <Net/UserFeed.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace Net
+{
+    namespace
+    {
+        const double        kOffsetDrift    = 0.001;    // How fast the clock offset follows a slower path
+    }
+
+    UserFeed::UserFeed ( const std::string& endpoint )
+    : _client ( new WebSocketClient ( Reactor::Get().Service() ) )
+    , _connection ( *_client, endpoint )
+    , _palette ( DefaultPalette() )
+    {
+        // These run on the connection's own strand, on whichever reactor thread
+        // Decoded straight out of the connection's pooled buffer, nothing is copied
+        _client->connectMessageViewEventHandler ( [this] ( const WebSocketMessageView& message )
+        {
+            _messages++;
+            Decode ( message.data, message.size );
+        } );
+
+        _client->connectOpenEventHandler ( [this]
+        {
+            // Offer version 2. A server that doesn't know it ignores this and keeps sending version 1.
+            _palette = DefaultPalette();
+            _hasSequence = false;
+            _hasClockOffset = false;
+
+            Bytes hello;
+            EncodeHello ( hello );
+            _client->write ( hello.data(), hello.size() );
+
+            _connection.Opened ( );
+        } );
+
+        _client->connectCloseEventHandler ( [this] { _connection.Closed ( ); } );
+        _client->connectFailEventHandler ( [this] ( std::string reason ) { _connection.Closed ( ); } );
+
+        _connection.Start ( );
+    }
+
+    UserEvent * UserFeed::Claim ( )
+    {
+        UserEvent * e = _events.Claim();
+        if ( !e ) _dropped++;
+        return e;
+    }
+
+    double UserFeed::Now ( )
+    {
+        using namespace std::chrono;
+        static const steady_clock::time_point kEpoch = steady_clock::now();
+        return duration<double>( steady_clock::now() - kEpoch ).count();
+    }
+
+    double UserFeed::LocalTime ( uint32_t serverMs, double received )
+    {
+        // The packet that took least time to arrive gives the best offset. Network delay
+        // only ever adds to it, so take the minimum, creeping up slowly in case the clocks drift.
+        double server = serverMs / 1000.0;
+        double offset = received - server;
+
+        if ( !_hasClockOffset || offset < _clockOffset ) _clockOffset = offset;
+        else _clockOffset += ( offset - _clockOffset ) * kOffsetDrift;
+
+        _hasClockOffset = true;
+        return server + _clockOffset;
+    }
+
+    void UserFeed::Decode ( const uint8_t * data, std::size_t size )
+    {
+        double received = Now();
+
+        UserPacket packet;
+        if ( UserPacket::Parse ( data, size, packet ) != ParseError::None )
+        {
+            _malformed++;
+            return;
+        }
+
+        switch ( packet.Type() )
+        {
+            case Command::UpdateV2 :
+            {
+                // Drop anything not newer than what we've applied, allowing for wrap around
+                uint16_t sequence = packet.Sequence();
+                if ( _hasSequence && static_cast<int16_t>( sequence - _sequence ) <= 0 )
+                {
+                    _stale++;
+                    return;
+                }
+
+                _sequence = sequence;
+                _hasSequence = true;
+            }
+            // Fall through
+
+            case Command::Update :
+            {
+                _version = packet.Type() == Command::UpdateV2 ? 2 : 1;
+                _updateBytes += size;
+                _updateUsers += packet.Count();
+
+                // Version 2 says when the server saw it, which is free of our network jitter
+                double time = packet.Type() == Command::UpdateV2 ? LocalTime ( packet.Timestamp(), received ) : received;
+
+                std::size_t remaining = packet.Count();
+                bool full = false;
+
+                packet.ForEachUser ( _palette, [this, time, &remaining, &full] ( const UserEvent& u )
+                {
+                    remaining--;
+                    if ( full ) return;
+
+                    UserEvent * e = Claim();
+                    if ( !e )
+                    {
+                        // Claim counted this one
+                        _dropped += remaining;
+                        full = true;
+                        return;
+                    }
+
+                    *e = u;
+                    e->Time = time;
+                    _events.Commit();
+                    _decoded++;
+                } );
+                break;
+            }
+
+            case Command::Palette :
+            {
+                packet.ReadPalette ( _palette );
+                break;
+            }
+
+            case Command::Join :
+            case Command::Leave :
+            {
+                if ( UserEvent * e = Claim() )
+                {
+                    e->Type = packet.Type();
+                    e->ID = packet.ID();
+                    e->Time = received;
+                    if ( packet.Type() == Command::Join ) packet.Name ( e->Name );
+                    _events.Commit();
+                    _decoded++;
+                }
+                break;
+            }
+
+            case Command::SetProperty :
+            {
+                if ( UserEvent * e = Claim() )
+                {
+                    e->Type = Command::SetProperty;
+                    e->Target = packet.Target();
+                    e->Value = packet.Value();
+                    _events.Commit();
+                    _decoded++;
+                }
+                break;
+            }
+        }
+    }
+
+    UserFeed::Stats UserFeed::GetStats ( ) const
+    {
+        Stats s;
+        s.Messages      = _messages;
+        s.Events        = _decoded;
+        s.Dropped       = _dropped;
+        s.Malformed     = _malformed;
+        s.Stale         = _stale;
+        s.UpdateBytes   = _updateBytes;
+        s.UpdateUsers   = _updateUsers;
+        s.Version       = _version;
+        s.Reconnects    = _connection.Reconnects();
+        s.Backoff       = _connection.Backoff();
+        return s;
+    }
+
+    UserFeed::~UserFeed ( )
+    {
+        // No more retries, and the connection is closing
+        _connection.Stop ( );
+
+        // Our handlers run on the connection's strand. Disconnecting them there waits for one already
+        // running, and anything still queued behind it finds nothing to call, so nothing writes to
+        // the queue or the protocol state once they're gone.
+        auto disconnect = [this]
+        {
+            _client->disconnectMessageViewEventHandler ( );
+            _client->disconnectOpenEventHandler ( );
+            _client->disconnectCloseEventHandler ( );
+            _client->disconnectFailEventHandler ( );
+        };
+
+        websocketpp::lib::error_code error;
+        auto connection = _client->getClient().get_con_from_hdl ( _client->getHandle(), error );
+        if ( connection && connection->get_strand() )
+        {
+            connection->get_strand()->post ( disconnect );
+            Reactor::Get().Drain ( *connection->get_strand() );
+        }else
+        {
+            disconnect ( );
+        }
+    }
+}
@@ -0,0 +1,97 @@
+//
+//  UserFeed.h
+//  Fluid
+//
+//  Connection to the user tracking server. Messages are decoded on the
+//  network threads into a queue of typed events that the main thread drains
+//  at the start of each frame, and the connection is retried with backoff
+//  by a Net::Reconnector.
+//
+
+#ifndef Fluid_UserFeed_h
+#define Fluid_UserFeed_h
+
+#include "WebSocketClient.h"
+
+#include <Net/Reconnector.h>
+#include <Net/SpscRing.h>
+#include <Net/UserProtocol.h>
+
+#include <array>
+#include <atomic>
+
+namespace Net
+{
+    using UserFeedRef = std::unique_ptr<class UserFeed>;
+    class UserFeed
+    {
+    public:
+
+        struct Stats
+        {
+            uint64_t                            Messages{0};
+            uint64_t                            Events{0};
+            uint64_t                            Dropped{0};         // Queue was full
+            uint64_t                            Malformed{0};       // Rejected by UserPacket::Parse
+            uint64_t                            Stale{0};           // V2 updates older than one already applied
+            uint64_t                            UpdateBytes{0};     // Update and UpdateV2 packets, for bytes per user
+            uint64_t                            UpdateUsers{0};
+            int                                 Version{1};         // Of the last update received
+            uint64_t                            Reconnects{0};
+            float                               Backoff{0.0f};      // Delay before the pending retry, while disconnected
+        };
+
+        static const std::size_t                kQueueSize      = 4096;
+
+        UserFeed                                ( const std::string& endpoint );
+        ~UserFeed                               ( );
+
+        // Calls handler with every event decoded since the last call, oldest first. Main thread only.
+        template <typename Handler>
+        std::size_t                             Consume         ( Handler handler )
+        {
+            std::size_t count = _events.Available();
+            for ( std::size_t i = 0; i < count; i++ ) handler ( _events.At ( i ) );
+            _events.Release ( count );
+            return count;
+        }
+
+        // Seconds on the clock UserEvent::Time is measured against. Any thread.
+        static double                           Now             ( );
+
+        inline bool                             IsConnected     ( ) const { return _connection.IsConnected(); }
+        inline const std::string&               Endpoint        ( ) const { return _connection.Endpoint(); }
+        Stats                                   GetStats        ( ) const;
+
+    protected:
+
+        void                                    Decode          ( const uint8_t * data, std::size_t size );
+        double                                  LocalTime       ( uint32_t serverMs, double received );
+        UserEvent *                             Claim           ( );
+
+        std::unique_ptr<WebSocketClient>        _client;
+        Reconnector                             _connection;
+
+        // Filled by the connection's handlers, which websocketpp runs one at a time,
+        // and we only reconnect once the previous connection has closed. So one producer.
+        SpscRing<UserEvent, kQueueSize>         _events;
+
+        // Producer side protocol state, reset when a connection opens
+        Palette                                 _palette;
+        uint16_t                                _sequence{0};
+        bool                                    _hasSequence{false};
+        double                                  _clockOffset{0.0};  // Local minus server time, for the least delayed packet
+        bool                                    _hasClockOffset{false};
+
+        std::atomic<uint64_t>                   _messages{0};
+        std::atomic<uint64_t>                   _decoded{0};
+        std::atomic<uint64_t>                   _dropped{0};
+        std::atomic<uint64_t>                   _malformed{0};
+        std::atomic<uint64_t>                   _stale{0};
+        std::atomic<uint64_t>                   _updateBytes{0};
+        std::atomic<uint64_t>                   _updateUsers{0};
+        std::atomic<int>                        _version{1};
+    };
+}
+
+#endif /* Fluid_UserFeed_h */
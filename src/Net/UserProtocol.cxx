@@ -0,0 +1,721 @@
+//
+//  UserProtocol.cxx
+//  Fluid
+//
+
+#include <Net/UserProtocol.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace ci;
+
+namespace Net
+{
+    namespace
+    {
+        const uint8_t       kStartOfPacket  = 0xFF;
+        const std::size_t   kPropertyCount  = static_cast<std::size_t>( Property::ParticleAlpha ) + 1;
+        const float         kTwoPi          = 6.28318530718f;
+
+        // How an Update record sits on the wire. Naturally aligned, so one copy reads it whole.
+        struct WireRecord
+        {
+            int32_t         ID;
+            float           X;
+            float           Y;
+            float           Angle;
+            float           Radius;
+            uint8_t         RGBA[4];
+        };
+
+        static_assert ( sizeof(WireRecord) == UserPacket::kRecordSize, "Update records are 24 bytes on the wire" );
+
+        template <typename T>
+        inline T            Load            ( const uint8_t * p )
+        {
+            T value;
+            std::memcpy ( &value, p, sizeof(T) );
+            return value;
+        }
+
+        inline std::size_t  RecordV2Size    ( uint8_t fields )
+        {
+            return UserPacket::kRecordV2Min
+                 + ( fields & UserField::Position ? 4 : 0 )
+                 + ( fields & UserField::Angle ? 1 : 0 )
+                 + ( fields & UserField::Radius ? 1 : 0 )
+                 + ( fields & UserField::Color ? 1 : 0 );
+        }
+
+        // Keep very dark users visible
+        inline ColorAf      Visible         ( uint8_t r, uint8_t g, uint8_t b, uint8_t a )
+        {
+            return ColorA8u ( std::max<uint8_t> ( 25, r ), std::max<uint8_t> ( 25, g ), std::max<uint8_t> ( 25, b ), a );
+        }
+
+        inline uint8_t      ToByte          ( float v )
+        {
+            return static_cast<uint8_t>( std::min ( std::max ( v, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+        }
+
+        // Writes the header with a placeholder size, Finish fills it in
+        std::size_t         Begin           ( Command command, Bytes& out )
+        {
+            std::size_t start = out.size();
+            Write<uint8_t>  ( out, kStartOfPacket );
+            Write<uint32_t> ( out, 0 );
+            Write<uint8_t>  ( out, static_cast<uint8_t>( command ) );
+            return start;
+        }
+
+        void                Finish          ( std::size_t start, Bytes& out )
+        {
+            uint32_t size = static_cast<uint32_t>( out.size() - start );
+            std::memcpy ( &out[start + 1], &size, 4 );
+        }
+    }
+
+    const char * ToString ( ParseError error )
+    {
+        switch ( error )
+        {
+            case ParseError::None :         return "None";
+            case ParseError::Truncated :    return "Truncated";
+            case ParseError::Length :       return "Length";
+            case ParseError::Command :      return "Command";
+        }
+        return "Unknown";
+    }
+
+    const Palette& DefaultPalette ( )
+    {
+        static Palette palette = []
+        {
+            // 32 hues at 8 brightnesses
+            Palette p;
+            for ( std::size_t i = 0; i < p.size(); i++ )
+            {
+                float h = ( i % 32 ) / 32.0f * 6.0f;
+                float v = 0.3f + 0.7f * ( i / 32 ) / 7.0f;
+                float s = 0.8f;
+
+                float c = v * s;
+                float x = c * ( 1.0f - std::abs ( std::fmod ( h, 2.0f ) - 1.0f ) );
+                float m = v - c;
+
+                vec2 rg = h < 1 ? vec2 ( c, x ) : h < 2 ? vec2 ( x, c ) : h < 3 ? vec2 ( 0, c ) : h < 4 ? vec2 ( 0, x ) : h < 5 ? vec2 ( x, 0 ) : vec2 ( c, 0 );
+                float b = h < 2 ? 0 : h < 3 ? x : h < 5 ? c : x;
+
+                p[i] = Visible ( ToByte ( rg.x + m ), ToByte ( rg.y + m ), ToByte ( b + m ), 255 );
+            }
+            return p;
+        }();
+
+        return palette;
+    }
+
+    ///
+    /// UserPacket
+    ///
+
+    const std::size_t UserPacket::kHeaderSize;
+    const std::size_t UserPacket::kNameSize;
+    const std::size_t UserPacket::kRecordSize;
+    const std::size_t UserPacket::kUpdateV2Header;
+    const std::size_t UserPacket::kRecordV2Min;
+    const std::size_t UserPacket::kRecordV2Max;
+
+    ParseError UserPacket::Parse ( const uint8_t * data, std::size_t size, UserPacket& packet )
+    {
+        if ( !data || size < kHeaderSize ) return ParseError::Truncated;
+
+        uint32_t packetSize = Load<uint32_t> ( data + 1 );
+        if ( packetSize > size ) return ParseError::Length;
+
+        Command command = static_cast<Command>( data[5] );
+        const uint8_t * body = data + kHeaderSize;
+        std::size_t available = size - kHeaderSize;
+        std::size_t count = 0;
+
+        switch ( command )
+        {
+            case Command::Join :
+            {
+                if ( available < 4 + kNameSize ) return ParseError::Truncated;
+                break;
+            }
+
+            case Command::Leave :
+            {
+                if ( available < 4 ) return ParseError::Truncated;
+                break;
+            }
+
+            case Command::SetProperty :
+            {
+                if ( available < 1 + 4 ) return ParseError::Truncated;
+                if ( body[0] >= kPropertyCount ) return ParseError::Command;
+                break;
+            }
+
+            case Command::Update :
+            {
+                if ( available < 1 ) return ParseError::Truncated;
+                count = body[0];
+                if ( available < 1 + count * kRecordSize ) return ParseError::Truncated;
+                break;
+            }
+
+            case Command::UpdateV2 :
+            {
+                if ( available < kUpdateV2Header ) return ParseError::Truncated;
+                count = body[kUpdateV2Header - 1];
+
+                // Records vary in size, so walk them all once here and never check again
+                const uint8_t * p = body + kUpdateV2Header;
+                const uint8_t * end = body + available;
+                for ( std::size_t i = 0; i < count; i++ )
+                {
+                    if ( static_cast<std::size_t>( end - p ) < kRecordV2Min ) return ParseError::Truncated;
+
+                    uint8_t fields = p[2];
+                    if ( fields & ~UserField::All ) return ParseError::Command;
+
+                    std::size_t length = RecordV2Size ( fields );
+                    if ( static_cast<std::size_t>( end - p ) < length ) return ParseError::Truncated;
+                    p += length;
+                }
+                break;
+            }
+
+            case Command::Palette :
+            {
+                if ( available < 2 ) return ParseError::Truncated;
+                if ( body[0] + body[1] > 256 ) return ParseError::Command;
+                if ( available < 2 + body[1] * 4u ) return ParseError::Truncated;
+                break;
+            }
+
+            default :
+            {
+                // Hello only ever goes to the server
+                return ParseError::Command;
+            }
+        }
+
+        packet._type = command;
+        packet._body = body;
+        packet._count = count;
+        return ParseError::None;
+    }
+
+    int32_t UserPacket::ID ( ) const
+    {
+        return Load<int32_t> ( _body );
+    }
+
+    void UserPacket::Name ( std::array<char, 33>& out ) const
+    {
+        const char * name = reinterpret_cast<const char *>( _body + 4 );
+        std::size_t length = std::find ( name, name + kNameSize, '\0' ) - name;
+        std::copy ( name, name + length, out.begin() );
+        out[length] = '\0';
+    }
+
+    void UserPacket::Record ( std::size_t index, UserEvent& out ) const
+    {
+        WireRecord r = Load<WireRecord> ( _body + 1 + index * kRecordSize );
+
+        out.Type = Command::Update;
+        out.ID = r.ID;
+        out.Position = vec2 ( r.X, r.Y );
+        out.Angle = r.Angle;
+        out.Radius = r.Radius * 64.0f;
+        out.Color = Visible ( r.RGBA[0], r.RGBA[1], r.RGBA[2], r.RGBA[3] );
+        out.Fields = UserField::All;
+        out.Sequence = 0;
+        out.Timestamp = 0;
+    }
+
+    uint16_t UserPacket::Sequence ( ) const
+    {
+        return Load<uint16_t> ( _body );
+    }
+
+    uint32_t UserPacket::Timestamp ( ) const
+    {
+        return Load<uint32_t> ( _body + 2 );
+    }
+
+    const uint8_t * UserPacket::RecordV2 ( const uint8_t * p, const Palette& palette, UserEvent& out ) const
+    {
+        out.Type = Command::Update;
+        out.ID = Load<uint16_t> ( p );
+        out.Fields = p[2];
+        out.Sequence = Sequence();
+        out.Timestamp = Timestamp();
+        p += kRecordV2Min;
+
+        if ( out.Fields & UserField::Position )
+        {
+            out.Position = vec2 ( Load<uint16_t> ( p ), Load<uint16_t> ( p + 2 ) ) / 65535.0f;
+            p += 4;
+        }
+
+        if ( out.Fields & UserField::Angle ) out.Angle = *p++ * ( kTwoPi / 256.0f );
+        if ( out.Fields & UserField::Radius ) out.Radius = *p++;      // 64ths of the v1 unit, which is 64px
+        if ( out.Fields & UserField::Color ) out.Color = palette[*p++];
+
+        return p;
+    }
+
+    void UserPacket::ReadPalette ( Palette& palette ) const
+    {
+        const uint8_t * rgba = _body + 2;
+        for ( std::size_t i = 0; i < _body[1]; i++, rgba += 4 )
+        {
+            palette[_body[0] + i] = Visible ( rgba[0], rgba[1], rgba[2], rgba[3] );
+        }
+    }
+
+    float UserPacket::Value ( ) const
+    {
+        return Load<float> ( _body + 1 );
+    }
+
+    ///
+    /// Encoding
+    ///
+
+    void EncodeHello ( Bytes& out )
+    {
+        std::size_t start = Begin ( Command::Hello, out );
+        Write<uint8_t> ( out, 2 );
+        Finish ( start, out );
+    }
+
+    void EncodeJoin ( int32_t id, const char * name, Bytes& out )
+    {
+        std::size_t start = Begin ( Command::Join, out );
+        Write<int32_t> ( out, id );
+
+        char padded[UserPacket::kNameSize] = {};
+        std::strncpy ( padded, name, sizeof(padded) );
+        out.insert ( out.end(), padded, padded + sizeof(padded) );
+        Finish ( start, out );
+    }
+
+    void EncodeLeave ( int32_t id, Bytes& out )
+    {
+        std::size_t start = Begin ( Command::Leave, out );
+        Write<int32_t> ( out, id );
+        Finish ( start, out );
+    }
+
+    void EncodeProperty ( Property property, float value, Bytes& out )
+    {
+        std::size_t start = Begin ( Command::SetProperty, out );
+        Write<uint8_t> ( out, static_cast<uint8_t>( property ) );
+        Write<float> ( out, value );
+        Finish ( start, out );
+    }
+
+    void EncodeUpdate ( const UserEvent * users, std::size_t count, Bytes& out )
+    {
+        for ( std::size_t first = 0; first < count || first == 0; first += 255 )
+        {
+            std::size_t n = std::min<std::size_t> ( count - first, 255 );
+
+            std::size_t start = Begin ( Command::Update, out );
+            Write<uint8_t> ( out, static_cast<uint8_t>( n ) );
+
+            for ( std::size_t i = first; i < first + n; i++ )
+            {
+                const UserEvent& u = users[i];
+                WireRecord r { u.ID, u.Position.x, u.Position.y, u.Angle, u.Radius / 64.0f,
+                               { ToByte ( u.Color.r ), ToByte ( u.Color.g ), ToByte ( u.Color.b ), ToByte ( u.Color.a ) } };
+                Write ( out, r );
+            }
+
+            Finish ( start, out );
+        }
+    }
+
+    uint16_t EncodeUpdateV2 ( uint16_t sequence, uint32_t timestamp, const UserEvent * users, std::size_t count, const Palette& palette, Bytes& out )
+    {
+        for ( std::size_t first = 0; first < count || first == 0; first += 255 )
+        {
+            std::size_t n = std::min<std::size_t> ( count - first, 255 );
+
+            std::size_t start = Begin ( Command::UpdateV2, out );
+            Write<uint16_t> ( out, sequence++ );
+            Write<uint32_t> ( out, timestamp );
+            Write<uint8_t>  ( out, static_cast<uint8_t>( n ) );
+
+            for ( std::size_t i = first; i < first + n; i++ )
+            {
+                const UserEvent& u = users[i];
+                uint8_t fields = u.Fields & UserField::All;
+
+                Write<uint16_t> ( out, static_cast<uint16_t>( u.ID ) );
+                Write<uint8_t>  ( out, fields );
+
+                if ( fields & UserField::Position )
+                {
+                    Write<uint16_t> ( out, static_cast<uint16_t>( std::min ( std::max ( u.Position.x, 0.0f ), 1.0f ) * 65535.0f + 0.5f ) );
+                    Write<uint16_t> ( out, static_cast<uint16_t>( std::min ( std::max ( u.Position.y, 0.0f ), 1.0f ) * 65535.0f + 0.5f ) );
+                }
+
+                if ( fields & UserField::Angle )
+                {
+                    float turns = u.Angle / kTwoPi;
+                    turns -= std::floor ( turns );
+                    Write<uint8_t> ( out, static_cast<uint8_t>( static_cast<int>( turns * 256.0f + 0.5f ) & 0xFF ) );
+                }
+
+                if ( fields & UserField::Radius ) Write<uint8_t> ( out, static_cast<uint8_t>( std::min ( std::max ( u.Radius, 0.0f ), 255.0f ) + 0.5f ) );
+
+                if ( fields & UserField::Color )
+                {
+                    std::size_t nearest = 0;
+                    float best = 1e9f;
+                    for ( std::size_t c = 0; c < palette.size(); c++ )
+                    {
+                        float dr = palette[c].r - u.Color.r, dg = palette[c].g - u.Color.g, db = palette[c].b - u.Color.b;
+                        float d = dr * dr + dg * dg + db * db;
+                        if ( d < best ) { best = d; nearest = c; }
+                    }
+                    Write<uint8_t> ( out, static_cast<uint8_t>( nearest ) );
+                }
+            }
+
+            Finish ( start, out );
+        }
+
+        return sequence;
+    }
+
+    void EncodePalette ( const Palette& palette, Bytes& out )
+    {
+        // A count is one byte, so two halves
+        for ( std::size_t first = 0; first < palette.size(); first += 128 )
+        {
+            std::size_t start = Begin ( Command::Palette, out );
+            Write<uint8_t> ( out, static_cast<uint8_t>( first ) );
+            Write<uint8_t> ( out, 128 );
+
+            for ( std::size_t i = first; i < first + 128; i++ )
+            {
+                const ColorAf& c = palette[i];
+                Write<uint8_t> ( out, ToByte ( c.r ) );
+                Write<uint8_t> ( out, ToByte ( c.g ) );
+                Write<uint8_t> ( out, ToByte ( c.b ) );
+                Write<uint8_t> ( out, ToByte ( c.a ) );
+            }
+
+            Finish ( start, out );
+        }
+    }
+
+    ///
+    /// Testing
+    ///
+
+    namespace
+    {
+        using Packet = std::vector<uint8_t>;
+
+        const Command       kFuzzCommands[] = { Command::Join, Command::Update, Command::Leave, Command::SetProperty, Command::UpdateV2, Command::Palette };
+
+        void                MakeUsers       ( std::size_t count, uint8_t fields, std::mt19937& random, std::vector<UserEvent>& users )
+        {
+            std::uniform_real_distribution<float> unit ( 0.0f, 1.0f );
+
+            users.resize ( count );
+            for ( std::size_t i = 0; i < count; i++ )
+            {
+                UserEvent& u = users[i];
+                u.ID = static_cast<int32_t>( i );
+                u.Position = vec2 ( unit ( random ), unit ( random ) );
+                u.Angle = unit ( random ) * kTwoPi;
+                u.Radius = unit ( random ) * 128.0f;
+                u.Color = ColorAf ( unit ( random ), unit ( random ), unit ( random ), 1.0f );
+                u.Fields = fields;
+            }
+        }
+
+        Packet              MakePacket      ( Command command, std::mt19937& random )
+        {
+            Packet p;
+            std::vector<UserEvent> users;
+
+            switch ( command )
+            {
+                case Command::Join :
+                {
+                    EncodeJoin ( static_cast<int32_t>( random() ), "visitor", p );
+                    break;
+                }
+
+                case Command::Leave :
+                {
+                    EncodeLeave ( static_cast<int32_t>( random() ), p );
+                    break;
+                }
+
+                case Command::SetProperty :
+                {
+                    EncodeProperty ( static_cast<Property>( random() % kPropertyCount ), ( random() % 1000 ) / 1000.0f, p );
+                    break;
+                }
+
+                case Command::Update :
+                {
+                    MakeUsers ( random() % 256, UserField::All, random, users );
+                    EncodeUpdate ( users.data(), users.size(), p );
+                    break;
+                }
+
+                case Command::UpdateV2 :
+                {
+                    MakeUsers ( random() % 256, 0, random, users );
+                    for ( auto& u : users ) u.Fields = random() % ( UserField::All + 1 );
+                    EncodeUpdateV2 ( static_cast<uint16_t>( random() ), random(), users.data(), users.size(), DefaultPalette(), p );
+                    break;
+                }
+
+                case Command::Palette :
+                {
+                    EncodePalette ( DefaultPalette(), p );
+                    p.resize ( p.size() / 2 );
+                    break;
+                }
+
+                default :
+                    break;
+            }
+
+            return p;
+        }
+
+        void                Mutate          ( Packet& p, std::mt19937& random )
+        {
+            switch ( random() % 7 )
+            {
+                case 0 :    // Bit flips
+                {
+                    int flips = 1 + random() % 8;
+                    for ( int i = 0; i < flips && !p.empty(); i++ ) p[random() % p.size()] ^= 1 << ( random() % 8 );
+                    break;
+                }
+
+                case 1 :    // Cut short
+                {
+                    p.resize ( p.empty() ? 0 : random() % p.size() );
+                    break;
+                }
+
+                case 2 :    // Count that doesn't match the records
+                {
+                    std::size_t at = p.size() > UserPacket::kHeaderSize && p[5] == static_cast<uint8_t>( Command::UpdateV2 ) ? UserPacket::kHeaderSize + UserPacket::kUpdateV2Header - 1 : UserPacket::kHeaderSize;
+                    if ( p.size() > at ) p[at] = random() % 256;
+                    break;
+                }
+
+                case 3 :    // Packet size that doesn't match
+                {
+                    if ( p.size() >= UserPacket::kHeaderSize )
+                    {
+                        uint32_t size = random();
+                        std::memcpy ( &p[1], &size, 4 );
+                    }
+                    break;
+                }
+
+                case 4 :    // Noise
+                {
+                    p.resize ( random() % 64 );
+                    for ( auto& b : p ) b = random() % 256;
+                    break;
+                }
+
+                case 5 :    // Trailing garbage
+                {
+                    std::size_t extra = 1 + random() % 32;
+                    for ( std::size_t i = 0; i < extra; i++ ) p.push_back ( random() % 256 );
+                    break;
+                }
+
+                case 6 :    // Unknown command
+                {
+                    if ( p.size() >= UserPacket::kHeaderSize ) p[5] = random() % 256;
+                    break;
+                }
+            }
+        }
+
+        // Everything a consumer would touch, folded so the reads can't be optimised away
+        float               Consume         ( const UserPacket& packet, Palette& palette )
+        {
+            UserEvent e;
+            float sum = 0.0f;
+
+            switch ( packet.Type() )
+            {
+                case Command::Join :
+                {
+                    packet.Name ( e.Name );
+                    sum += packet.ID() + e.Name[0];
+                    break;
+                }
+
+                case Command::Leave :
+                {
+                    sum += packet.ID();
+                    break;
+                }
+
+                case Command::SetProperty :
+                {
+                    sum += packet.Value() + static_cast<float>( packet.Target() );
+                    break;
+                }
+
+                case Command::Update :
+                case Command::UpdateV2 :
+                {
+                    packet.ForEachUser ( palette, [&sum] ( const UserEvent& u ) { sum += u.Position.x + u.Radius + u.Color.r; } );
+                    break;
+                }
+
+                case Command::Palette :
+                {
+                    packet.ReadPalette ( palette );
+                    sum += palette[0].r;
+                    break;
+                }
+
+                default :
+                    break;
+            }
+
+            return sum;
+        }
+    }
+
+    ParserBenchmark BenchmarkParser ( int iterations )
+    {
+        using namespace std::chrono;
+
+        ParserBenchmark result;
+        result.Iterations = iterations;
+        if ( iterations <= 0 ) return result;
+
+        // Mostly full updates, as the tracking server sends at frame rate
+        std::mt19937 random ( 1 );
+        std::vector<Packet> packets;
+        std::vector<UserEvent> users;
+
+        for ( int i = 0; i < 8; i++ )
+        {
+            Packet p;
+            MakeUsers ( 255, UserField::All, random, users );
+            EncodeUpdate ( users.data(), users.size(), p );
+            if ( i == 0 ) result.BytesPerUser = p.size() / 255.0;
+            packets.push_back ( p );
+
+            // Typical steady state: everyone moved, nothing else changed
+            p.clear();
+            MakeUsers ( 255, UserField::Position, random, users );
+            EncodeUpdateV2 ( static_cast<uint16_t>( i ), i * 16, users.data(), users.size(), DefaultPalette(), p );
+            if ( i == 0 ) result.BytesPerUserV2 = p.size() / 255.0;
+            packets.push_back ( p );
+        }
+        packets.push_back ( MakePacket ( Command::Join, random ) );
+        packets.push_back ( MakePacket ( Command::Leave, random ) );
+        packets.push_back ( MakePacket ( Command::SetProperty, random ) );
+
+        Palette palette = DefaultPalette();
+        uint64_t bytes = 0, records = 0;
+        float check = 0.0f;
+
+        auto start = steady_clock::now();
+        for ( int i = 0; i < iterations; i++ )
+        {
+            const Packet& p = packets[i % packets.size()];
+
+            UserPacket packet;
+            if ( UserPacket::Parse ( p.data(), p.size(), packet ) != ParseError::None ) continue;
+
+            check += Consume ( packet, palette );
+            bytes += p.size();
+            records += packet.Count();
+        }
+        double seconds = duration<double>( steady_clock::now() - start ).count();
+
+        if ( check == 0.0f ) std::cout << "User parser benchmark read nothing" << std::endl;
+
+        seconds = std::max ( seconds, 1e-9 );
+        result.PacketsPerSecond = iterations / seconds;
+        result.MegabytesPerSecond = bytes / ( 1024.0 * 1024.0 ) / seconds;
+        result.RecordsPerSecond = records / seconds;
+        return result;
+    }
+
+    FuzzReport FuzzParser ( int packets, uint32_t seed )
+    {
+        using namespace std::chrono;
+
+        FuzzReport report;
+        std::mt19937 random ( seed );
+        Palette palette = DefaultPalette();
+
+        auto start = steady_clock::now();
+        for ( int i = 0; i < packets; i++ )
+        {
+            Packet p = MakePacket ( kFuzzCommands[random() % 6], random );
+
+            int mutations = 1 + random() % 3;
+            for ( int m = 0; m < mutations; m++ ) Mutate ( p, random );
+
+            // Exactly sized, so reading one byte past the end is a heap overflow rather than a quiet read of spare capacity
+            std::unique_ptr<uint8_t[]> copy ( new uint8_t[std::max<std::size_t> ( p.size(), 1 )] );
+            std::copy ( p.begin(), p.end(), copy.get() );
+
+            UserPacket packet;
+            ParseError error = UserPacket::Parse ( copy.get(), p.size(), packet );
+
+            report.Packets++;
+            report.Rejected[static_cast<std::size_t>( error )]++;
+            if ( error != ParseError::None ) continue;
+
+            report.Accepted++;
+
+            std::size_t body = p.size() - UserPacket::kHeaderSize;
+            bool valid = true;
+            switch ( packet.Type() )
+            {
+                case Command::Join :            valid = body >= 4 + UserPacket::kNameSize; break;
+                case Command::Leave :           valid = body >= 4; break;
+                case Command::SetProperty :     valid = body >= 5 && static_cast<std::size_t>( packet.Target() ) < kPropertyCount; break;
+                case Command::Update :          valid = body >= 1 + packet.Count() * UserPacket::kRecordSize; break;
+                case Command::UpdateV2 :        valid = body >= UserPacket::kUpdateV2Header + packet.Count() * UserPacket::kRecordV2Min; break;
+                case Command::Palette :         valid = body >= 2 && copy[UserPacket::kHeaderSize] + copy[UserPacket::kHeaderSize + 1] <= 256; break;
+                default :                       valid = false;
+            }
+
+            if ( valid ) Consume ( packet, palette );
+            else report.Failures++;
+        }
+        report.Seconds = duration<double>( steady_clock::now() - start ).count();
+
+        if ( report.Failures > 0 ) std::cout << "User parser fuzz: " << report.Failures << " accepted packets were invalid (seed " << seed << ")" << std::endl;
+        return report;
+    }
+}
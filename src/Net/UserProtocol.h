@@ -0,0 +1,229 @@
+//
+//  UserProtocol.h
+//  Fluid
+//
+//  Wire format of the user tracking server, and a parser that validates a
+//  whole packet up front and then reads it in place.
+//
+
+#ifndef Fluid_UserProtocol_h
+#define Fluid_UserProtocol_h
+
+#include "cinder/Color.h"
+#include "cinder/Vector.h"
+
+#include <Net/FieldCodec.h>
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace Net
+{
+    ///
+    /// Protocol
+    ///
+    /// u8 start, u32 packet size, u8 command, then per command:
+    ///   Join          i32 id, char[32] name
+    ///   Update        u8 count, then count x ( i32 id, f32 x, f32 y, f32 angle, f32 radius, u8 rgba[4] )
+    ///   Leave         i32 id
+    ///   SetProperty   u8 property, f32 value
+    ///
+    /// Version 2, offered by the client with Hello once connected. A server that understands it
+    /// may send UpdateV2 and Palette from then on, one that doesn't ignores the Hello. Version 1
+    /// packets are accepted either way.
+    ///   Hello         u8 highest version the client reads                         (client to server)
+    ///   UpdateV2      u16 sequence, u32 timestamp (ms), u8 count, then count x
+    ///                   ( u16 id, u8 fields, [u16 x, u16 y], [u8 angle], [u8 radius], [u8 colour] )
+    ///                 Only the fields flagged are present, the rest keep their last value.
+    ///                 x, y are fixed point over [0, 1], angle over [0, 2pi), radius in 64ths, colour a palette index.
+    ///   Palette       u8 first, u8 count, then count x u8 rgba[4]
+    ///
+    /// All little endian. The packet size may not claim more than actually arrived, trailing bytes are ignored.
+    ///
+
+    enum class Command : uint8_t
+    {
+        Join        = 0,
+        Update      = 1,
+        Leave       = 2,
+        SetProperty = 3,
+        Hello       = 4,
+        UpdateV2    = 5,
+        Palette     = 6,
+    };
+
+    // Which parts of a user an update carries
+    namespace UserField
+    {
+        const uint8_t                           Position        = 1 << 0;
+        const uint8_t                           Angle           = 1 << 1;
+        const uint8_t                           Radius          = 1 << 2;
+        const uint8_t                           Color           = 1 << 3;
+        const uint8_t                           All             = Position | Angle | Radius | Color;
+    }
+
+    using Palette                               = std::array<ci::ColorAf, 256>;
+
+    // Used until the server sends its own
+    const Palette&                              DefaultPalette  ( );
+
+    enum class Property : uint8_t
+    {
+        FluidAlpha,
+        Metalness,
+        FlowFieldAlpha,
+        FlowFieldWeight,
+        ParticleAlpha,
+    };
+
+    // One decoded change. An Update packet becomes one event per user.
+    struct UserEvent
+    {
+        Command                                 Type{Command::Update};
+        int32_t                                 ID{0};
+        std::array<char, 33>                    Name;               // Join, always null terminated
+        ci::vec2                                Position;           // Update, normalised
+        float                                   Angle{0.0f};
+        float                                   Radius{0.0f};       // Update, in pixels
+        ci::ColorAf                             Color;
+        Property                                Target{Property::FluidAlpha};   // SetProperty
+        float                                   Value{0.0f};
+        uint8_t                                 Fields{UserField::All};         // Update, what the packet carried
+        uint16_t                                Sequence{0};                    // UpdateV2 only
+        uint32_t                                Timestamp{0};                   // UpdateV2 only, server ms
+        double                                  Time{0.0};                      // When it applies on the local clock, set by the feed
+    };
+
+    enum class ParseError : uint8_t
+    {
+        None,
+        Truncated,              // Shorter than its header or its command needs
+        Length,                 // Packet size claims more bytes than arrived
+        Command,                // Unknown command, property or update field
+    };
+
+    const char *                                ToString        ( ParseError error );
+
+    ///
+    /// UserPacket
+    ///
+
+    // A view over one raw message. Parse checks every length before anything is read, so
+    // the accessors don't check again. Only valid while the bytes it was parsed from are.
+    class UserPacket
+    {
+    public:
+
+        static const std::size_t                kHeaderSize     = 6;
+        static const std::size_t                kNameSize       = 32;
+        static const std::size_t                kRecordSize     = 24;
+        static const std::size_t                kUpdateV2Header = 7;        // Sequence, timestamp, count
+        static const std::size_t                kRecordV2Min    = 3;        // Id and fields alone
+        static const std::size_t                kRecordV2Max    = 10;
+
+        static ParseError                       Parse           ( const uint8_t * data, std::size_t size, UserPacket& packet );
+
+        inline Command                          Type            ( ) const { return _type; }
+
+        // Join / Leave
+        int32_t                                 ID              ( ) const;
+        // Join, copies at most kNameSize characters and null terminates
+        void                                    Name            ( std::array<char, 33>& out ) const;
+
+        // Update and UpdateV2
+        inline std::size_t                      Count           ( ) const { return _count; }
+        // Update only, records are fixed size
+        void                                    Record          ( std::size_t index, UserEvent& out ) const;
+
+        // UpdateV2
+        uint16_t                                Sequence        ( ) const;
+        uint32_t                                Timestamp       ( ) const;
+
+        // Either update, in order. Calls handler ( const UserEvent& ), palette resolves V2 colours.
+        template <typename Handler>
+        void                                    ForEachUser     ( const Palette& palette, Handler handler ) const
+        {
+            UserEvent e;
+            if ( _type == Command::Update )
+            {
+                for ( std::size_t i = 0; i < _count; i++ )
+                {
+                    Record ( i, e );
+                    handler ( e );
+                }
+            }else if ( _type == Command::UpdateV2 )
+            {
+                const uint8_t * p = _body + kUpdateV2Header;
+                for ( std::size_t i = 0; i < _count; i++ )
+                {
+                    p = RecordV2 ( p, palette, e );
+                    handler ( e );
+                }
+            }
+        }
+
+        // Palette, sets entries [First, First + Count)
+        void                                    ReadPalette     ( Palette& palette ) const;
+
+        // SetProperty
+        inline Property                         Target          ( ) const { return static_cast<Property>( _body[0] ); }
+        float                                   Value           ( ) const;
+
+    protected:
+
+        const uint8_t *                         RecordV2        ( const uint8_t * p, const Palette& palette, UserEvent& out ) const;
+
+        const uint8_t *                         _body{nullptr};     // First byte after the command
+        Command                                 _type{Command::Update};
+        std::size_t                             _count{0};
+    };
+
+    ///
+    /// Encoding
+    ///
+
+    // Appends whole packets to out. Used by the client for Hello, and by test servers.
+    void                                        EncodeHello     ( Bytes& out );
+    void                                        EncodeJoin      ( int32_t id, const char * name, Bytes& out );
+    void                                        EncodeLeave     ( int32_t id, Bytes& out );
+    void                                        EncodeProperty  ( Property property, float value, Bytes& out );
+    void                                        EncodeUpdate    ( const UserEvent * users, std::size_t count, Bytes& out );
+    // Only each user's Fields are written. Colours are sent as the nearest palette entry.
+    // More than 255 users are split over several packets. Returns the sequence for the next packet.
+    uint16_t                                    EncodeUpdateV2  ( uint16_t sequence, uint32_t timestamp, const UserEvent * users, std::size_t count, const Palette& palette, Bytes& out );
+    void                                        EncodePalette   ( const Palette& palette, Bytes& out );
+
+    ///
+    /// Testing
+    ///
+
+    struct ParserBenchmark
+    {
+        double                                  PacketsPerSecond{0.0};
+        double                                  MegabytesPerSecond{0.0};
+        double                                  RecordsPerSecond{0.0};
+        double                                  BytesPerUser{0.0};          // Version 1 records
+        double                                  BytesPerUserV2{0.0};        // Version 2, position only deltas
+        int                                     Iterations{0};
+    };
+
+    // Parses a realistic mix of full Update packets and the other commands. Blocks for as long as it takes.
+    ParserBenchmark                             BenchmarkParser ( int iterations );
+
+    struct FuzzReport
+    {
+        int                                     Packets{0};
+        int                                     Accepted{0};
+        std::array<int, 4>                      Rejected{};         // Indexed by ParseError
+        int                                     Failures{0};        // Accepted packets that broke an invariant
+        double                                  Seconds{0.0};
+    };
+
+    // Mutates valid packets (bit flips, truncation, bad counts and lengths, random bytes) and
+    // parses each from an exactly sized heap copy, so a sanitizer build catches any overread.
+    FuzzReport                                  FuzzParser      ( int packets, uint32_t seed );
+}
+
+#endif /* Fluid_UserProtocol_h */
@@ -0,0 +1,370 @@
+//
+//  UserTable.cxx
+//  Fluid
+//
+
+#include <Net/UserTable.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ci;
+
+namespace Net
+{
+    namespace
+    {
+        // Clamped to the grid, and safe for NaN or infinite positions off the wire
+        inline int          CellOf          ( float v, int cells )
+        {
+            float f = v * cells;
+            if ( !( f >= 0.0f ) ) return 0;
+            return f >= cells ? cells - 1 : static_cast<int>( f );
+        }
+    }
+
+    const UserTable::Handle UserTable::kInvalidHandle;
+    const std::size_t UserTable::kMaxUsers;
+    const std::size_t UserTable::kWheelSlots;
+    const std::size_t UserTable::kMaxNames;
+    const std::size_t UserTable::kHistory;
+    constexpr double UserTable::kTickSeconds;
+
+    UserTable::UserTable ( double timeout )
+    : _timeoutTicks ( std::max ( 1u, static_cast<uint32_t>( std::ceil ( timeout / kTickSeconds ) ) ) )
+    {
+        _names.push_back ( "" );
+        _nameLookup[""] = 0;
+    }
+
+    UserTable::Handle UserTable::Find ( int32_t id ) const
+    {
+        auto it = _lookup.find ( id );
+        return it == _lookup.end() ? kInvalidHandle : it->second;
+    }
+
+    int UserTable::IndexOf ( Handle handle ) const
+    {
+        std::size_t slot = handle & 0xFFFF;
+        if ( handle == kInvalidHandle || slot >= _slots.size() ) return -1;
+
+        const Slot& s = _slots[slot];
+        if ( !s.Live || s.Generation != ( handle >> 16 ) ) return -1;
+        return static_cast<int>( s.Index );
+    }
+
+    int UserTable::Acquire ( int32_t id, uint32_t tick )
+    {
+        int index = IndexOf ( Find ( id ) );
+        if ( index >= 0 ) return index;
+
+        uint16_t slot = 0;
+        if ( !_freeSlots.empty() )
+        {
+            slot = _freeSlots.back();
+            _freeSlots.pop_back();
+        }else
+        {
+            if ( _slots.size() >= kMaxUsers ) return -1;
+            slot = static_cast<uint16_t>( _slots.size() );
+            _slots.emplace_back();
+        }
+
+        Slot& s = _slots[slot];
+        s.Index = static_cast<uint32_t>( _ids.size() );
+        s.Live = true;
+
+        Handle handle = ( static_cast<Handle>( s.Generation ) << 16 ) | slot;
+        _lookup[id] = handle;
+
+        _ids.push_back ( id );
+        _positions.emplace_back ( 0.0f );
+        _angles.push_back ( 0.0f );
+        _radii.push_back ( 64.0f );
+        _sentRadii.push_back ( 64.0f );
+        _colors.emplace_back ( );
+        _nameIds.push_back ( 0 );
+        _lastSeen.push_back ( tick );
+        _handles.push_back ( handle );
+        _history.emplace_back ( );
+
+        _wheel[( tick + _timeoutTicks ) % kWheelSlots].push_back ( handle );
+        return static_cast<int>( s.Index );
+    }
+
+    void UserTable::Remove ( Handle handle )
+    {
+        int index = IndexOf ( handle );
+        if ( index < 0 ) return;
+
+        // Swap the last user into the hole
+        std::size_t last = _ids.size() - 1;
+        _lookup.erase ( _ids[index] );
+
+        if ( static_cast<std::size_t>( index ) != last )
+        {
+            _ids[index]         = _ids[last];
+            _positions[index]   = _positions[last];
+            _angles[index]      = _angles[last];
+            _radii[index]       = _radii[last];
+            _sentRadii[index]   = _sentRadii[last];
+            _colors[index]      = _colors[last];
+            _nameIds[index]     = _nameIds[last];
+            _lastSeen[index]    = _lastSeen[last];
+            _handles[index]     = _handles[last];
+            _history[index]     = _history[last];
+
+            _slots[_handles[index] & 0xFFFF].Index = index;
+        }
+
+        _ids.pop_back();
+        _positions.pop_back();
+        _angles.pop_back();
+        _radii.pop_back();
+        _sentRadii.pop_back();
+        _colors.pop_back();
+        _nameIds.pop_back();
+        _lastSeen.pop_back();
+        _handles.pop_back();
+        _history.pop_back();
+
+        // Anything still holding the old handle, the wheel included, now misses
+        Slot& s = _slots[handle & 0xFFFF];
+        s.Live = false;
+        s.Generation++;
+        _freeSlots.push_back ( static_cast<uint16_t>( handle & 0xFFFF ) );
+    }
+
+    uint32_t UserTable::Intern ( const char * name )
+    {
+        auto it = _nameLookup.find ( name );
+        if ( it != _nameLookup.end() ) return it->second;
+        if ( _names.size() >= kMaxNames ) return 0;
+
+        uint32_t id = static_cast<uint32_t>( _names.size() );
+        _names.push_back ( name );
+        _nameLookup[_names.back()] = id;
+        return id;
+    }
+
+    void UserTable::Apply ( const UserEvent& event, double now )
+    {
+        switch ( event.Type )
+        {
+            case Command::Join :
+            {
+                int index = Acquire ( event.ID, Tick ( now ) );
+                if ( index < 0 ) return;
+
+                _nameIds[index] = Intern ( event.Name.data() );
+                _lastSeen[index] = Tick ( now );
+                break;
+            }
+
+            case Command::Update :
+            {
+                // One NaN would poison every cluster it lands in
+                if ( !std::isfinite ( event.Position.x ) || !std::isfinite ( event.Position.y ) ||
+                     !std::isfinite ( event.Angle ) || !std::isfinite ( event.Radius ) ) return;
+
+                int index = Acquire ( event.ID, Tick ( now ) );
+                if ( index < 0 ) return;
+
+                // Version 2 updates only carry what changed
+                if ( event.Fields & ( UserField::Position | UserField::Angle ) )
+                {
+                    History& history = _history[index];
+
+                    // Motion the update doesn't mention carries on from the newest sample
+                    Motion m = history.Count > 0 ? history.Back ( 0 ) : Motion { 0.0, _positions[index], _angles[index] };
+                    m.Time = event.Time;
+                    if ( event.Fields & UserField::Position ) m.Position = event.Position;
+                    if ( event.Fields & UserField::Angle ) m.Angle = event.Angle;
+
+                    // First sighting goes straight in so nothing is drawn at the origin meanwhile
+                    if ( history.Count == 0 )
+                    {
+                        _positions[index] = m.Position;
+                        _angles[index] = m.Angle;
+                    }
+
+                    history.Push ( m );
+                }
+
+                if ( event.Fields & UserField::Radius ) _sentRadii[index] = event.Radius;
+                _radii[index] = _sentRadii[index];
+                if ( event.Fields & UserField::Color ) _colors[index] = event.Color;
+                _lastSeen[index] = Tick ( now );
+                break;
+            }
+
+            case Command::Leave :
+            {
+                Remove ( Find ( event.ID ) );
+                break;
+            }
+
+            default :
+                break;
+        }
+    }
+
+    void UserTable::Expire ( double now )
+    {
+        uint32_t tick = Tick ( now );
+        if ( tick <= _tick ) return;
+
+        // After a long stall every bucket is due, once
+        uint32_t steps = std::min<uint32_t> ( tick - _tick, kWheelSlots );
+        _tick = tick;
+
+        for ( uint32_t step = 0; step < steps; step++ )
+        {
+            _due.clear();
+            std::swap ( _due, _wheel[( tick - steps + 1 + step ) % kWheelSlots] );
+
+            for ( Handle handle : _due )
+            {
+                int index = IndexOf ( handle );
+                if ( index < 0 ) continue;
+
+                uint32_t deadline = _lastSeen[index] + _timeoutTicks;
+                if ( deadline <= tick )
+                {
+                    Remove ( handle );
+                }else
+                {
+                    // Seen since it was scheduled, wait for its new deadline
+                    _wheel[std::min<uint32_t> ( deadline, tick + kWheelSlots - 1 ) % kWheelSlots].push_back ( handle );
+                }
+            }
+        }
+    }
+
+    void UserTable::Cluster ( int cells, std::vector<UserCluster>& out ) const
+    {
+        out.clear();
+        cells = std::max ( cells, 1 );
+
+        std::size_t cellCount = static_cast<std::size_t>( cells ) * cells;
+        if ( _cellClusters.size() != cellCount ) _cellClusters.assign ( cellCount, -1 );
+
+        _clusterCells.clear();
+        _clusterWeights.clear();
+
+        // Weighted sums first, turned into means below. Spread holds the sum of squares until then.
+        for ( std::size_t i = 0; i < _ids.size(); i++ )
+        {
+            const vec2& p = _positions[i];
+            int cell = CellOf ( p.y, cells ) * cells + CellOf ( p.x, cells );
+            int& cluster = _cellClusters[cell];
+            if ( cluster < 0 )
+            {
+                cluster = static_cast<int>( out.size() );
+                out.emplace_back ( );
+                out.back().Color = ColorAf ( 0, 0, 0, 0 );
+                _clusterCells.push_back ( cell );
+                _clusterWeights.push_back ( 0.0f );
+            }
+
+            UserCluster& c = out[cluster];
+            float w = std::max ( _radii[i], 1e-3f );
+
+            c.Position += p * w;
+            c.Spread += p * p * w;
+            c.Momentum += vec2 ( std::cos ( _angles[i] ), std::sin ( _angles[i] ) );
+            c.Color += _colors[i] * w;
+            c.Radius += _radii[i];
+            c.Count++;
+            _clusterWeights[cluster] += w;
+        }
+
+        for ( std::size_t i = 0; i < out.size(); i++ )
+        {
+            UserCluster& c = out[i];
+            float w = _clusterWeights[i];
+
+            c.Position /= w;
+            c.Spread = glm::sqrt ( glm::max ( c.Spread / w - c.Position * c.Position, vec2 ( 0.0f ) ) );
+            c.Color /= w;
+            c.Radius /= c.Count;
+
+            // Reset only the cells used, ready for next frame
+            _cellClusters[_clusterCells[i]] = -1;
+        }
+    }
+
+    void UserTable::History::Push ( const Motion& motion )
+    {
+        // Several updates in one packet, or a clock step back: the newest wins
+        if ( Count > 0 && motion.Time <= Back ( 0 ).Time )
+        {
+            double time = Back ( 0 ).Time;
+            Samples[Newest] = motion;
+            Samples[Newest].Time = time;
+            return;
+        }
+
+        Newest = static_cast<uint8_t>( ( Newest + 1 ) % kHistory );
+        Samples[Newest] = motion;
+        Count = static_cast<uint8_t>( std::min<std::size_t> ( Count + 1, kHistory ) );
+    }
+
+    void UserTable::Sample ( double time, double delay, double maxExtrapolation )
+    {
+        double t = time - delay;
+        _extrapolating = 0;
+
+        for ( std::size_t i = 0; i < _ids.size(); i++ )
+        {
+            const History& h = _history[i];
+            if ( h.Count == 0 ) continue;
+
+            const Motion& newest = h.Back ( 0 );
+
+            if ( t >= newest.Time )
+            {
+                vec2 position = newest.Position;
+
+                // Carry on at the last known velocity for a little while
+                if ( h.Count > 1 && maxExtrapolation > 0.0 )
+                {
+                    const Motion& previous = h.Back ( 1 );
+                    double span = newest.Time - previous.Time;
+                    double ahead = std::min ( t - newest.Time, maxExtrapolation );
+
+                    if ( span > 1e-4 && ahead > 0.0 )
+                    {
+                        position += ( newest.Position - previous.Position ) * static_cast<float>( ahead / span );
+                        _extrapolating++;
+                    }
+                }
+
+                _positions[i] = position;
+                _angles[i] = newest.Angle;
+                continue;
+            }
+
+            // Newest sample at or before t, or the oldest we have if t is further back
+            std::size_t age = 1;
+            while ( age < h.Count && h.Back ( age ).Time > t ) age++;
+
+            if ( age == h.Count )
+            {
+                _positions[i] = h.Back ( age - 1 ).Position;
+                _angles[i] = h.Back ( age - 1 ).Angle;
+                continue;
+            }
+
+            const Motion& a = h.Back ( age );
+            const Motion& b = h.Back ( age - 1 );
+            float f = static_cast<float>( ( t - a.Time ) / std::max ( b.Time - a.Time, 1e-6 ) );
+
+            // Shortest way round
+            float turn = std::remainder ( b.Angle - a.Angle, 6.28318530718f );
+
+            _positions[i] = a.Position + ( b.Position - a.Position ) * f;
+            _angles[i] = a.Angle + turn * f;
+        }
+    }
+}
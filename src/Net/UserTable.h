@@ -0,0 +1,157 @@
+//
+//  UserTable.h
+//  Fluid
+//
+//  The users currently reported by the tracking server, kept in packed
+//  arrays so a frame can walk them linearly. Users the server stops
+//  mentioning expire through a timing wheel. Motion is played back a
+//  little behind real time so irregular updates still move smoothly.
+//
+
+#ifndef Fluid_UserTable_h
+#define Fluid_UserTable_h
+
+#include <Net/UserProtocol.h>
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Net
+{
+    // Several users merged into one force. Means are weighted by radius.
+    struct UserCluster
+    {
+        ci::vec2                                Position;           // Normalised
+        ci::vec2                                Momentum;           // Sum of the members' unit headings
+        ci::vec2                                Spread;             // Standard deviation of member positions, normalised
+        ci::ColorAf                             Color;
+        float                                   Radius{0.0f};       // Mean member radius, in pixels
+        int                                     Count{0};
+    };
+
+    class UserTable
+    {
+    public:
+
+        // Slot index in the low 16 bits, generation in the high 16. A handle to a user that
+        // has left stops resolving once its slot is reused.
+        using Handle                            = uint32_t;
+
+        static const Handle                     kInvalidHandle  = 0xFFFFFFFF;
+        static const std::size_t                kMaxUsers       = 0xFFFF;
+        static const std::size_t                kWheelSlots     = 64;
+        static const std::size_t                kMaxNames       = 4096;
+        static const std::size_t                kHistory        = 8;        // Motion samples kept per user
+        static constexpr double                 kTickSeconds    = 0.25;
+
+        UserTable                               ( double timeout = 10.0 );
+
+        // Join, Update and Leave. now is the frame time, read once by the caller.
+        void                                    Apply           ( const UserEvent& event, double now );
+
+        // Drops everyone not heard from within the timeout
+        void                                    Expire          ( double now );
+
+        // Sets Positions and Angles to where each user was delay seconds before time (on the
+        // UserEvent::Time clock), interpolating between updates. Past the newest update motion
+        // carries on for up to maxExtrapolation seconds, then holds.
+        void                                    Sample          ( double time, double delay, double maxExtrapolation );
+
+        // Users past their newest update at the last Sample
+        inline std::size_t                      Extrapolating   ( ) const { return _extrapolating; }
+
+        inline std::size_t                      Size            ( ) const { return _ids.size(); }
+
+        // Packed, index i is the same user in each. Order changes when a user is removed.
+        inline const std::vector<int32_t>&      IDs             ( ) const { return _ids; }
+        inline const std::vector<ci::vec2>&     Positions       ( ) const { return _positions; }
+        inline const std::vector<float>&        Angles          ( ) const { return _angles; }
+        inline const std::vector<ci::ColorAf>&  Colors          ( ) const { return _colors; }
+        // Free for the caller to shrink between updates. Each update puts back the last radius the
+        // server sent, whether or not it carries one.
+        inline std::vector<float>&              Radii           ( ) { return _radii; }
+
+        const std::string&                      Name            ( std::size_t index ) const { return _names[_nameIds[index]]; }
+
+        Handle                                  Find            ( int32_t id ) const;
+        // Packed index of a live handle, or -1
+        int                                     IndexOf         ( Handle handle ) const;
+
+        inline std::size_t                      InternedNames   ( ) const { return _names.size(); }
+
+        // Merges users falling in the same cell of a cells x cells grid over the unit square.
+        // Replaces out, which keeps its capacity between frames.
+        void                                    Cluster         ( int cells, std::vector<UserCluster>& out ) const;
+
+    protected:
+
+        struct Motion
+        {
+            double                              Time{0.0};
+            ci::vec2                            Position;
+            float                               Angle{0.0f};
+        };
+
+        // Ring of the newest kHistory updates
+        struct History
+        {
+            std::array<Motion, kHistory>        Samples;
+            uint8_t                             Newest{0};
+            uint8_t                             Count{0};
+
+            inline const Motion&                Back            ( std::size_t age ) const { return Samples[( Newest + kHistory - age ) % kHistory]; }
+            void                                Push            ( const Motion& motion );
+        };
+
+        struct Slot
+        {
+            uint32_t                            Index{0};           // Into the packed arrays
+            uint16_t                            Generation{0};
+            bool                                Live{false};
+        };
+
+        inline uint32_t                         Tick            ( double now ) const { return static_cast<uint32_t>( now / kTickSeconds ); }
+
+        // Packed index for id, adding the user if new. -1 when full.
+        int                                     Acquire         ( int32_t id, uint32_t tick );
+        void                                    Remove          ( Handle handle );
+        uint32_t                                Intern          ( const char * name );
+
+        uint32_t                                _timeoutTicks;
+        uint32_t                                _tick{0};           // Last tick Expire processed
+
+        // Packed per user
+        std::vector<int32_t>                    _ids;
+        std::vector<ci::vec2>                   _positions;
+        std::vector<float>                      _angles;
+        std::vector<float>                      _radii;
+        std::vector<float>                      _sentRadii;         // As last sent, version 2 only sends changes
+        std::vector<ci::ColorAf>                _colors;
+        std::vector<uint32_t>                   _nameIds;
+        std::vector<uint32_t>                   _lastSeen;          // Tick
+        std::vector<Handle>                     _handles;
+        std::vector<History>                    _history;           // Only read by Sample
+        std::size_t                             _extrapolating{0};
+
+        std::vector<Slot>                       _slots;
+        std::vector<uint16_t>                   _freeSlots;
+        std::unordered_map<int32_t, Handle>     _lookup;            // Server id, touched once per event
+
+        // Each live user sits in exactly one bucket, the one for the tick it could first expire on.
+        // When that bucket comes due, users seen since are moved on rather than removed.
+        std::vector<Handle>                     _wheel[kWheelSlots];
+        std::vector<Handle>                     _due;               // Bucket being processed, kept for its capacity
+
+        // Cluster scratch, kept for its capacity
+        mutable std::vector<int>                _cellClusters;      // Cluster per grid cell, -1 when empty
+        mutable std::vector<int>                _clusterCells;      // Grid cell per cluster
+        mutable std::vector<float>              _clusterWeights;
+
+        std::vector<std::string>                _names;             // Interned, [0] is the empty name. Never shrinks.
+        std::unordered_map<std::string, uint32_t> _nameLookup;
+    };
+}
+
+#endif /* Fluid_UserTable_h */
@@ -17,34 +17,6 @@ using namespace std;
 
 #define RUN_WINDOWED
 
-///
-/// User
-
-void NetworkedFluidApp::User::Unpack ( const IStreamMemRef& stream )
-{
-    Timestamp = app::getElapsedSeconds();
-    
-    stream->read( &Position.x ); //
-    stream->read( &Position.y ); //
-    stream->read( &Angle );
-    stream->read( &Radius );
-    
-    uint8_t rgba[4];
-    stream->readData ( &rgba, 4 );
-    
-    rgba[0] = std::max ( (uint8_t)25, rgba[0] );
-    rgba[1] = std::max ( (uint8_t)25, rgba[1] );
-    rgba[2] = std::max ( (uint8_t)25, rgba[2] );
-    
-    Color = ColorA8u ( rgba[0], rgba[1], rgba[2], rgba[3] );
-    Radius *= 64.0f;
-}
-
-bool NetworkedFluidApp::User::Dead ( ) const
-{
-    return ( app::getElapsedSeconds() - Timestamp ) > 10.0f;
-}
-
 ///
 /// NetworkedFluidApp
 ///
@@ -71,17 +43,28 @@ void NetworkedFluidApp::OnSetup ( )
     ui::initialize();
     
     JsonTree tree { loadAsset ( "Config.json" ) };
+    if ( tree.hasChild( "NetworkThreads" ) ) Net::Reactor::Configure ( tree["NetworkThreads"].getValue<int>() );
+    
     if ( tree.hasChild( "WebSocketEndpoint" ) )
     {
         _endpoint = tree["WebSocketEndpoint"].getValue();
     }
     
+    if ( tree.hasChild( "StreamViewerEndpoint" ) )
+    {
+        _viewerEndpoint = tree["StreamViewerEndpoint"].getValue();
+    }
+    
     _tweak = Utils::QC( "Tweak.json", { { "LogoScale", &_logoScale },
                                         { "Gravity", &_gravity },
                                         { "ParticleAlpha", &_particleAlpha },
                                         { "FlowFieldAlpha", &_flowFieldAlpha },
                                         { "FlowFieldColorWeight", &_flowFieldColorWeight },
-                                        { "FluidAlpha", &_fluidAlpha } } );
+                                        { "FluidAlpha", &_fluidAlpha },
+                                        { "ClusterThreshold", &_clusterThreshold },
+                                        { "ClusterCells", &_clusterCells },
+                                        { "PlayoutDelay", &_playoutDelay },
+                                        { "MaxExtrapolation", &_maxExtrapolation } } );
     
     _fluid = Fluid::Sim::Create( getWindowWidth(), getWindowHeight(), kScale );
     _fluid->Gravity.OverrideValue( vec2(0) );
@@ -132,154 +115,177 @@ void NetworkedFluidApp::OnSetup ( )
     _flowField->Alpha.OverrideValue(0.0f);
     _flowField->ColorWeight.OverrideValue(0.7f);
     
-    _client.connectMessageEventHandler ( [&] ( const std::string& message )
+    // Connects and retries by itself, decoded events wait in its queue for OnUpdate
+    if ( !_endpoint.empty() )
     {
-        IStreamMemRef stream = IStreamMem::create ( message.data(), message.length() );
-        
-        uint8_t sot;
-        stream->read( &sot );
+        _feed = std::make_unique<Net::UserFeed>( _endpoint );
+    }
+    
+    if ( IsViewer() )
+    {
+        // Retried with the same backoff as the user feed, off the main thread
+        _viewerClient = std::make_unique<WebSocketClient>( Net::Reactor::Get().Service() );
+        _viewerConnection = std::make_unique<Net::Reconnector>( *_viewerClient, _viewerEndpoint );
         
-        uint32_t packetSize = 0;
-        stream->read ( &packetSize );
+        _viewerClient->connectMessageEventHandler ( [this] ( const std::string& message )
+        {
+            dispatchAsync ( [this, message] { HandleFrame ( message ); } );
+        } );
         
-        uint8_t command = 0;
-        stream->read( &command );
+        _viewerClient->connectCloseEventHandler( [this]
+        {
+            _viewerConnection->Closed();
+            dispatchAsync ( [this] { _frames = Net::FrameDecoder(); } );
+        } );
+        _viewerClient->connectFailEventHandler( [this] ( std::string reason ) { _viewerConnection->Closed(); } );
+        _viewerClient->connectOpenEventHandler( [this] { _viewerConnection->Opened(); } );
         
-        switch ( (Command)command )
+        _viewerConnection->Start();
+    }else if ( tree.hasChild( "Stream" ) )
+    {
+        _stream = std::make_unique<Net::FrameStream>( Net::FrameStreamOptions::FromJson ( tree["Stream"] ) );
+    }
+    
+    // Local stand-in for the tracking server, point WebSocketEndpoint at ws://localhost:<Port> to use it
+    if ( tree.hasChild( "CrowdServer" ) )
+    {
+        _crowd = std::make_unique<Net::CrowdServer>( Net::CrowdOptions::FromJson ( tree["CrowdServer"] ) );
+        _crowdOptions = _crowd->GetOptions();
+    }
+}
+
+void NetworkedFluidApp::HandleEvent ( const Net::UserEvent& event, double now )
+{
+    switch ( event.Type )
+    {
+        case Net::Command::Join :
+        case Net::Command::Update :
+        case Net::Command::Leave :
+        {
+            _users.Apply ( event, now );
+            break;
+        }
+            
+        case Net::Command::SetProperty :
         {
-            case Command::Leave :
+            switch ( event.Target )
             {
-                int id = 0;
-                stream->read ( &id );
-                
-                if ( _users.count( id ) )
+                case Net::Property::FluidAlpha :
                 {
-                    _users.erase ( id );
+                    _fluid->Alpha.OverrideValue(event.Value);
+                    break;
                 }
-                
-                break;
-            }
-                
-            case Command::Join :
-            {
-                int id = 0;
-                stream->read ( &id );
-                
-                char buffer[32] = {};
-                stream->readData( buffer, 32 );
-                
-                _users[id].ID = id;
-                _users[id].Name = buffer;
-                _users[id].Timestamp = app::getElapsedSeconds();
-                
-                break;
-            }
-                
-            case Command::Update :
-            {
-                uint8_t numPeople = 0;
-                stream->read ( &numPeople );
-                
-                for ( int i = 0; i < numPeople; i++ )
+                    
+                case Net::Property::FlowFieldAlpha :
                 {
-                    int id = 0;
-                    stream->read ( &id );
+                    _flowField->Alpha.OverrideValue(event.Value);
+                    break;
+                }
                     
-                    _users[id].ID = id;
-                    _users[id].Unpack ( stream );
+                case Net::Property::FlowFieldWeight :
+                {
+                    _flowField->ColorWeight.OverrideValue(event.Value);
+                    break;
                 }
-                
-                break;
-            }
-                
-            case Command::SetProperty :
-            {
-                uint8_t property = 0;
-                float value = 0.0f;
-                
-                stream->read ( &property );
-                stream->read( &value );
-                
-                switch ( (Property)property )
+                    
+                case Net::Property::ParticleAlpha :
+                {
+                    _particles.Alpha.OverrideValue(event.Value);
+                    break;
+                }
+                    
+                case Net::Property::Metalness :
                 {
-                    case Property::FluidAlpha :
-                    {
-                        _fluid->Alpha.OverrideValue(value);
-                        break;
-                    }
-                        
-                    case Property::FlowFieldAlpha :
-                    {
-                        _flowField->Alpha.OverrideValue(value);
-                        break;
-                    }
-                        
-                    case Property::FlowFieldWeight :
-                    {
-                        _flowField->ColorWeight.OverrideValue(value);
-                        break;
-                    }
-                        
-                    case Property::ParticleAlpha :
-                    {
-                        _particles.Alpha.OverrideValue(value);
-                        break;
-                    }
-                        
-                    case Property::Metalness :
-                    {
-                        _fluid->Metalness.OverrideValue(value);
-                        break;
-                    }
+                    _fluid->Metalness.OverrideValue(event.Value);
+                    break;
                 }
             }
         }
-        
-    } );
+    }
+}
+
+void NetworkedFluidApp::HandleFrame ( const std::string& message )
+{
+    if ( !_frames.Decode ( reinterpret_cast<const uint8_t *>( message.data() ), message.size() ) ) return;
     
-    _client.connectCloseEventHandler( [&] { _isConnected = false; });
-    _client.connectOpenEventHandler( [&] { _isConnected = true; } );
+    _fluid->WriteField ( Fluid::Field::Density, _frames.Size(), _frames.Density );
+    if ( _frames.HasVelocity() ) _fluid->WriteField ( Fluid::Field::Velocity, _frames.Size(), _frames.Velocity );
 }
 
-void NetworkedFluidApp::OnUpdate ( )
+void NetworkedFluidApp::InjectForces ( Net::UserTable& users, std::vector<Fluid::Force>& forces )
 {
-    if ( !_isConnected && getElapsedFrames() % 60 == 0 )
+    vec2 windowSize = getWindowSize();
+    forces.clear();
+    
+    if ( (int)users.Size() > _clusterThreshold )
     {
-        if ( !_endpoint.empty() )
+        // Too many to inject one by one, merge those close together
+        users.Cluster ( _clusterCells, _clusters );
+        
+        for ( auto& c : _clusters )
         {
-            _client.connect( _endpoint );
+            Fluid::Force force;
+            force.Position = c.Position * windowSize;
+            force.Color = c.Color;
+            force.Radius = c.Radius + glm::length ( c.Spread * windowSize );
+            force.Density = 0.8f;
+            // Mean heading, so a crowded cell pushes no harder than one user does. Opposing headings cancel.
+            force.Velocity = c.Momentum / static_cast<float>( c.Count );
+            forces.push_back ( force );
         }
-    }
-    
-    const float dt = 1.0 / 60.0f;
-    
-    auto it = _users.begin();
-    while ( it != _users.end() )
+    }else
     {
-        if ( it->second.Dead() )
-        {
-            it = _users.erase( it );
-        }else
+        auto& positions = users.Positions();
+        auto& angles = users.Angles();
+        auto& colors = users.Colors();
+        auto& radii = users.Radii();
+        
+        for ( std::size_t i = 0; i < users.Size(); i++ )
         {
-            auto& user = it->second;
             Fluid::Force force;
-            force.Position = user.Position * vec2 ( getWindowSize() );
-            force.Color = user.Color;
-            force.Radius = user.Radius;
+            force.Position = positions[i] * windowSize;
+            force.Color = colors[i];
+            force.Radius = radii[i];
             force.Density = 0.8f;
-            force.Velocity = vec2 { std::cos ( user.Angle ), std::sin ( user.Angle ) };
-            _fluid->AddTemporalForce( force );
-            it++;
-            
-            user.Radius *= 0.999f;
+            force.Velocity = vec2 { std::cos ( angles[i] ), std::sin ( angles[i] ) };
+            forces.push_back ( force );
         }
     }
+}
+
+void NetworkedFluidApp::OnUpdate ( )
+{
+    double now = getElapsedSeconds();
+    
+    // Everything that arrived since last frame, applied before anything reads _users
+    if ( _feed ) _feed->Consume ( [this, now] ( const Net::UserEvent& event ) { HandleEvent ( event, now ); } );
+    _users.Expire ( now );
+    
+    // Behind by the playout delay, so there is usually an update either side to interpolate between
+    _users.Sample ( Net::UserFeed::Now(), _playoutDelay, _maxExtrapolation );
+    
+    const float dt = 1.0 / 60.0f;
+    
+    if ( IsViewer() )
+    {
+        // Frames arrive from the stream, so there is nothing to simulate
+        _particles.Update( dt, _fluid->GetVelocity() );
+        return;
+    }
+    
+    InjectForces ( _users, _forces );
+    _fluid->AddTemporalForces ( _forces );
+    _injectedForces = (int)_forces.size();
+    
+    // Shrinks a user that has gone quiet, their next update restores the radius
+    for ( auto& r : _users.Radii() ) r *= 0.999f;
     
     _fluid->ObstaclesDirty = true;
     
     _fluid->Update( dt );
     _particles.Update( dt, _fluid->GetVelocity() );
-    _client.poll();
+    
+    if ( _stream ) _stream->Update( *_fluid );
 }
 
 void NetworkedFluidApp::OnKeyDown ( const app::KeyEvent& event )
@@ -321,7 +327,7 @@ void NetworkedFluidApp::RenderScene ( )
 
 void NetworkedFluidApp::RenderUI ( )
 {
-    if ( !_isConnected )
+    if ( _feed && !_feed->IsConnected() )
     {
         gl::ScopedBlendAlpha blend;
         gl::ScopedColor c { ColorAf ( 1, 0, 0, std::sin ( getElapsedSeconds() * 3.0f ) * 0.5f + 0.5f ) };
@@ -350,15 +356,127 @@ void NetworkedFluidApp::RenderUI ( )
         
         if ( ui::Button( "Save" ) ) _tweak.Save();
         
+        RenderUsersUI ( );
+        RenderStreamUI ( );
+        
         kFirst = false;
         
         _fluid->DrawBuffers();
     }
 }
 
+void NetworkedFluidApp::RenderStreamUI ( )
+{
+    if ( _stream && ui::CollapsingHeader( "Stream" ) )
+    {
+        auto stats = _stream->GetStats();
+        auto& options = _stream->GetOptions();
+        
+        ui::Text ( "Port %d, %dx%d @ %.0ffps, %d bit%s", options.Port, options.Resolution.x, options.Resolution.y,
+                   options.Rate, options.Bits, options.IncludeVelocity ? ", velocity" : "" );
+        ui::Text ( "Viewers: %d", stats.Viewers );
+        ui::Text ( "Frames: %llu encoded, %llu sent", (unsigned long long)stats.FramesEncoded, (unsigned long long)stats.FramesSent );
+        ui::Text ( "Skipped (backpressure): %llu", (unsigned long long)stats.FramesSkipped );
+        ui::Text ( "Dropped (encoder busy): %llu", (unsigned long long)stats.FramesDropped );
+        ui::Text ( "Sent: %.2f MB", stats.BytesSent / ( 1024.0 * 1024.0 ) );
+        ui::Text ( "Last keyframe: %.1f KB, delta: %.1f KB", stats.LastKeyframeSize / 1024.0f, stats.LastDeltaSize / 1024.0f );
+    }
+    
+    if ( IsViewer() && ui::CollapsingHeader( "Stream" ) )
+    {
+        ui::Text ( "Source: %s (%s)", _viewerEndpoint.c_str(), _viewerConnection->IsConnected() ? "connected" : "disconnected" );
+        if ( !_viewerConnection->IsConnected() ) ui::Text ( "Retry delay: %.1fs, %llu reconnects", _viewerConnection->Backoff(), (unsigned long long)_viewerConnection->Reconnects() );
+        ui::Text ( "Frame %u, %dx%d%s", _frames.Sequence(), _frames.Size().x, _frames.Size().y, _frames.HasVelocity() ? ", velocity" : "" );
+    }
+}
+
+void NetworkedFluidApp::RenderUsersUI ( )
+{
+    if ( _feed && ui::CollapsingHeader( "Users" ) )
+    {
+        auto stats = _feed->GetStats();
+        
+        ui::Text ( "Source: %s (%s)", _feed->Endpoint().c_str(), _feed->IsConnected() ? "connected" : "disconnected" );
+        if ( !_feed->IsConnected() ) ui::Text ( "Retry delay: %.1fs, %llu reconnects", stats.Backoff, (unsigned long long)stats.Reconnects );
+        ui::Text ( "Users: %d, names interned: %d", (int)_users.Size(), (int)_users.InternedNames() );
+        ui::Text ( "Forces injected: %d%s", _injectedForces, (int)_users.Size() > _clusterThreshold ? " (clustered)" : "" );
+        ui::DragInt ( "Cluster Above", &_clusterThreshold, 1.0f, 0, 1024 );
+        ui::DragInt ( "Cluster Cells", &_clusterCells, 0.25f, 1, 128 );
+        ui::DragFloat ( "Playout Delay", &_playoutDelay, 0.001f, 0.0f, 0.5f );
+        ui::DragFloat ( "Max Extrapolation", &_maxExtrapolation, 0.001f, 0.0f, 0.5f );
+        ui::Text ( "Extrapolating: %d", (int)_users.Extrapolating() );
+        ui::Text ( "Messages: %llu, events: %llu", (unsigned long long)stats.Messages, (unsigned long long)stats.Events );
+        ui::Text ( "Dropped (queue full): %llu", (unsigned long long)stats.Dropped );
+        ui::Text ( "Malformed: %llu, stale: %llu", (unsigned long long)stats.Malformed, (unsigned long long)stats.Stale );
+        ui::Text ( "Protocol v%d, %.1f bytes per user", stats.Version, stats.UpdateUsers ? stats.UpdateBytes / (double)stats.UpdateUsers : 0.0 );
+    }
+    
+    if ( ui::CollapsingHeader( "User Parser" ) )
+    {
+        if ( ui::Button( "Benchmark" ) ) _parserBenchmark = Net::BenchmarkParser ( 200000 );
+        if ( _parserBenchmark.Iterations > 0 )
+        {
+            ui::Text ( "%.0f packets/s, %.0f MB/s, %.1fM users/s", _parserBenchmark.PacketsPerSecond, _parserBenchmark.MegabytesPerSecond, _parserBenchmark.RecordsPerSecond / 1e6 );
+            ui::Text ( "Bytes per user: %.1f v1, %.1f v2 (position only)", _parserBenchmark.BytesPerUser, _parserBenchmark.BytesPerUserV2 );
+        }
+        
+        if ( ui::Button( "Fuzz" ) ) _fuzzReport = Net::FuzzParser ( 100000, static_cast<uint32_t>( getElapsedFrames() ) );
+        if ( _fuzzReport.Packets > 0 )
+        {
+            ui::Text ( "%d packets in %.2fs, %d accepted, %d failures", _fuzzReport.Packets, _fuzzReport.Seconds, _fuzzReport.Accepted, _fuzzReport.Failures );
+            for ( int i = 1; i < (int)_fuzzReport.Rejected.size(); i++ )
+            {
+                ui::Text ( "  %s: %d", Net::ToString ( static_cast<Net::ParseError>( i ) ), _fuzzReport.Rejected[i] );
+            }
+        }
+    }
+    
+    if ( _crowd && ui::CollapsingHeader( "Crowd Server" ) )
+    {
+        auto stats = _crowd->GetStats();
+        
+        ui::Text ( "Port %d, clients: %d, users: %d", _crowdOptions.Port, stats.Clients, stats.Users );
+        ui::Text ( "Packets: %llu, sent: %.2f MB", (unsigned long long)stats.Packets, stats.Bytes / ( 1024.0 * 1024.0 ) );
+        ui::Text ( "Lost: %llu, reordered: %llu", (unsigned long long)stats.Lost, (unsigned long long)stats.Reordered );
+        
+        bool changed = false;
+        changed |= ui::DragInt ( "Crowd Users", &_crowdOptions.Users, 1.0f, 0, 8000 );
+        changed |= ui::DragFloat ( "Crowd Rate", &_crowdOptions.Rate, 0.1f, 1.0f, 120.0f );
+        changed |= ui::DragFloat ( "Crowd Loss", &_crowdOptions.Loss, 0.001f, 0.0f, 1.0f );
+        changed |= ui::DragFloat ( "Crowd Reorder", &_crowdOptions.Reorder, 0.001f, 0.0f, 1.0f );
+        changed |= ui::DragFloat ( "Crowd Churn", &_crowdOptions.Churn, 0.0001f, 0.0f, 0.1f );
+        if ( changed ) _crowd->SetOptions ( _crowdOptions );
+    }
+    
+    if ( ui::CollapsingHeader( "Ingest Benchmark" ) )
+    {
+        // Decode, apply and inject for growing crowds, on this thread, with the app's own force injection
+        if ( ui::Button( "Run" ) )
+        {
+            _ingestTimings.clear();
+            for ( int users : { 50, 200, 1000, 4000 } )
+            {
+                _ingestTimings.push_back ( Net::BenchmarkIngest ( users, 120, [this] ( Net::UserTable& table ) { InjectForces ( table, _forces ); } ) );
+            }
+            _forces.clear();
+        }
+        
+        for ( auto& t : _ingestTimings )
+        {
+            ui::Text ( "%5d users: decode %.1fus, apply %.1fus, inject %.1fus per frame, %.0f MB/s", t.Users, t.Decode, t.Apply, t.Inject, t.MegabytesPerSecond );
+        }
+    }
+}
+
 void NetworkedFluidApp::OnCleanup ( )
 {
-    _client.disconnect();
+    if ( _viewerConnection ) _viewerConnection->Stop();
+    
+    // Stop network handlers before the objects they call into go away
+    Net::Reactor::Get().Shutdown();
+    _feed = nullptr;
+    _stream = nullptr;
+    _crowd = nullptr;
 }
 
 void Init ( App::Settings * settings )
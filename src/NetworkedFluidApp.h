@@ -15,42 +15,16 @@
 #include "FlowField.h"
 #include "WebSocketClient.h"
 #include "QuickConfig.h"
+#include <Net/CrowdServer.h>
+#include <Net/FrameStream.h>
+#include <Net/Reconnector.h>
+#include <Net/UserFeed.h>
+#include <Net/UserTable.h>
 
 class NetworkedFluidApp : public ci::app::App
 {
 public:
     
-    enum class Command : uint8_t
-    {
-        Join        = 0,
-        Update      = 1,
-        Leave       = 2,
-        SetProperty = 3,
-    };
-    
-    enum class Property : uint8_t
-    {
-        FluidAlpha,
-        Metalness,
-        FlowFieldAlpha,
-        FlowFieldWeight,
-        ParticleAlpha,
-    };
-    
-    struct User
-    {
-        int                         ID{0};
-        std::string                 Name;
-        ci::vec2                    Position;
-        ci::ColorAf                 Color;
-        float                       Angle{0.0f};
-        float                       Radius{64.0f};
-        double                      Timestamp{0.0};
-        
-        void                        Unpack              ( const ci::IStreamMemRef& stream );
-        bool                        Dead                ( ) const;
-    };
-    
     NetworkedFluidApp               ( );
     
     static void                     Init                ( ci::app::App::Settings * settings );
@@ -66,6 +40,14 @@ protected:
     
     void                            RenderScene         ( );
     void                            RenderUI            ( );
+    void                            RenderStreamUI      ( );
+    void                            RenderUsersUI       ( );
+    void                            HandleEvent         ( const Net::UserEvent& event, double now );
+    // One force per user, or per cluster once there are more than _clusterThreshold
+    void                            InjectForces        ( Net::UserTable& users, std::vector<Fluid::Force>& forces );
+    void                            HandleFrame         ( const std::string& message );
+    
+    bool                            IsViewer            ( ) const { return !_viewerEndpoint.empty(); }
     
     Fluid::SimRef                   _fluid;
     ParticleSystem                  _particles;
@@ -81,10 +63,28 @@ protected:
     Utils::QC                       _tweak;
     bool                            _renderTweak{false};
     
-    std::unordered_map<int, User>   _users;
-    WebSocketClient                 _client;
-    bool                            _isConnected{false};
+    Net::UserTable                  _users;
+    std::vector<Net::UserCluster>   _clusters;
+    int                             _clusterThreshold{64};  // Users before clustering kicks in
+    int                             _clusterCells{24};      // Grid cells across, more is closer to one force per user
+    std::vector<Fluid::Force>       _forces;
+    int                             _injectedForces{0};
+    float                           _playoutDelay{0.1f};    // Seconds users are drawn behind their updates
+    float                           _maxExtrapolation{0.15f};
+    Net::UserFeedRef                _feed;              // Decodes on the shared Net::Reactor, drained each frame
+    Net::ParserBenchmark            _parserBenchmark;
+    Net::FuzzReport                 _fuzzReport;
+    std::vector<Net::IngestTiming>  _ingestTimings;
+    Net::CrowdServerRef             _crowd;             // Simulated tracking server for load testing
+    Net::CrowdOptions               _crowdOptions;
     std::string                     _endpoint;
+    
+    // Stream the sim to thin viewers, or (as a viewer) show someone else's
+    Net::FrameStreamRef             _stream;
+    std::unique_ptr<WebSocketClient> _viewerClient;
+    std::unique_ptr<Net::Reconnector> _viewerConnection;
+    Net::FrameDecoder               _frames;
+    std::string                     _viewerEndpoint;
 };
 
 #endif /* NetworkedFluidApp_h */
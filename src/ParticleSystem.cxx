@@ -127,6 +127,16 @@ void ParticleSystem::Save ( JsonTree& tree )
     tree.pushBack( node );
 }
 
+void ParticleSystem::Bake ( float rate )
+{
+    Alpha.Bake ( rate );
+    AlphaMin.Bake ( rate );
+    AlphaMultiplier.Bake ( rate );
+    MaxParticleSize.Bake ( rate );
+    VelocityDamping.Bake ( rate );
+    VelocityMultiplier.Bake ( rate );
+}
+
 void ParticleSystem::Update ( float dt, const ci::gl::Texture2dRef& velocityField )
 {
     auto t = Time::Sequencer::Default().Time();
@@ -25,6 +25,7 @@ public:
     
     void                Init    ( int resPowerOf2 );
     void                Update  ( float dt, const ci::gl::Texture2dRef& velocityField );
+    void                Bake    ( float rate );
     void                Inspect ( );
     void                Draw    ( const ci::gl::Texture2dRef& densityField );
     
@@ -0,0 +1,282 @@
+//
+//  CompiledScene.cxx
+//  Fluid
+//
+
+#include <Time/CompiledScene.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#if !defined( CINDER_MSW )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace ci;
+
+namespace Time
+{
+    namespace
+    {
+        const char kMagic[4] = { 'F', 'L', 'S', 'C' };
+
+        // Whether count records of recordSize bytes at offset lie inside a file of size bytes, 4 byte aligned
+        bool Fits ( std::size_t size, uint32_t offset, std::size_t count, std::size_t recordSize )
+        {
+            return offset % 4 == 0 && offset <= size && count <= ( size - offset ) / recordSize;
+        }
+
+        inline uint32_t Padded ( std::size_t bytes )
+        {
+            return static_cast<uint32_t>( ( bytes + 3 ) & ~std::size_t ( 3 ) );
+        }
+    }
+
+    ///
+    /// MappedFile
+    ///
+
+    MappedFileRef MappedFile::Open ( const fs::path& path )
+    {
+        MappedFileRef file ( new MappedFile() );
+
+#if defined( CINDER_MSW )
+        std::ifstream stream ( path.c_str(), std::ios::binary );
+        if ( !stream ) return nullptr;
+
+        file->_buffer.assign ( std::istreambuf_iterator<char>( stream ), std::istreambuf_iterator<char>() );
+        if ( file->_buffer.empty() ) return nullptr;
+
+        file->_data = file->_buffer.data();
+        file->_size = file->_buffer.size();
+#else
+        int descriptor = open ( path.c_str(), O_RDONLY );
+        if ( descriptor < 0 ) return nullptr;
+
+        struct stat status;
+        if ( fstat ( descriptor, &status ) != 0 || status.st_size <= 0 )
+        {
+            close ( descriptor );
+            return nullptr;
+        }
+
+        // The mapping keeps the file open by itself
+        void * data = mmap ( nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0 );
+        close ( descriptor );
+        if ( data == MAP_FAILED ) return nullptr;
+
+        file->_data = static_cast<const uint8_t *>( data );
+        file->_size = static_cast<std::size_t>( status.st_size );
+#endif
+
+        return file;
+    }
+
+    MappedFile::~MappedFile ( )
+    {
+#if !defined( CINDER_MSW )
+        if ( _data ) munmap ( const_cast<uint8_t *>( _data ), _size );
+#endif
+    }
+
+    ///
+    /// SceneWriter
+    ///
+
+    SceneWriter::SceneWriter ( const std::vector<ElementRef>& elements )
+    : _source ( elements )
+    {
+        // Offset 0 is the empty string
+        _strings.push_back ( '\0' );
+    }
+
+    void SceneWriter::Add ( const ElementRef& element )
+    {
+        CompiledElement record;
+        std::memset ( &record, 0, sizeof ( record ) );
+        record.Template     = -1;
+        record.FirstTrack   = static_cast<uint32_t>( _tracks.size() );
+
+        _elements.push_back ( record );
+        element->Compile ( *this );
+    }
+
+    void SceneWriter::AddEvent ( float time, const std::string& name )
+    {
+        CompiledEvent event;
+        event.Time = time;
+        event.Name = String ( name );
+        _events.push_back ( event );
+    }
+
+    uint32_t SceneWriter::String ( const std::string& value )
+    {
+        if ( value.empty() ) return 0;
+
+        uint32_t offset = static_cast<uint32_t>( _strings.size() );
+        _strings.append ( value.c_str() );
+        _strings.push_back ( '\0' );
+        return offset;
+    }
+
+    int32_t SceneWriter::IndexOf ( const ElementRef& element ) const
+    {
+        auto it = std::find ( _source.begin(), _source.end(), element );
+        return element && it != _source.end() ? static_cast<int32_t>( it - _source.begin() ) : -1;
+    }
+
+    uint32_t SceneWriter::Align ( )
+    {
+        _frames.resize ( Padded ( _frames.size() ), 0 );
+        return static_cast<uint32_t>( _frames.size() );
+    }
+
+    bool SceneWriter::Write ( const fs::path& path, float duration, const std::string& settings )
+    {
+        CompiledHeader header;
+        std::memset ( &header, 0, sizeof ( header ) );
+        std::memcpy ( header.Magic, kMagic, sizeof ( kMagic ) );
+        header.Version      = CompiledHeader::kVersion;
+        header.Layout       = KeyframeLayout();
+        header.Duration     = duration;
+        header.Settings     = String ( settings );
+
+        // Each table starts 4 byte aligned, one after the other
+        uint32_t offset = Padded ( sizeof ( header ) );
+        auto place = [&offset] ( std::size_t bytes )
+        {
+            uint32_t at = offset;
+            offset += Padded ( bytes );
+            return at;
+        };
+
+        header.Elements         = static_cast<uint32_t>( _elements.size() );
+        header.ElementsOffset   = place ( _elements.size() * sizeof ( CompiledElement ) );
+        header.Tracks           = static_cast<uint32_t>( _tracks.size() );
+        header.TracksOffset     = place ( _tracks.size() * sizeof ( CompiledTrack ) );
+        header.Events           = static_cast<uint32_t>( _events.size() );
+        header.EventsOffset     = place ( _events.size() * sizeof ( CompiledEvent ) );
+        header.StringBytes      = static_cast<uint32_t>( _strings.size() );
+        header.StringsOffset    = place ( _strings.size() );
+        header.FrameBytes       = static_cast<uint32_t>( _frames.size() );
+        header.FramesOffset     = place ( _frames.size() );
+
+        try
+        {
+            fs::path temporary = path.parent_path() / ( path.filename().string() + ".tmp" );
+
+            {
+                std::ofstream stream ( temporary.c_str(), std::ios::binary | std::ios::trunc );
+                auto put = [&stream] ( const void * data, std::size_t bytes )
+                {
+                    static const char kPadding[4] = { 0, 0, 0, 0 };
+                    if ( bytes ) stream.write ( static_cast<const char *>( data ), bytes );
+                    stream.write ( kPadding, Padded ( bytes ) - bytes );
+                };
+
+                put ( &header, sizeof ( header ) );
+                put ( _elements.data(), _elements.size() * sizeof ( CompiledElement ) );
+                put ( _tracks.data(), _tracks.size() * sizeof ( CompiledTrack ) );
+                put ( _events.data(), _events.size() * sizeof ( CompiledEvent ) );
+                put ( _strings.data(), _strings.size() );
+                put ( _frames.data(), _frames.size() );
+
+                if ( !stream ) throw std::runtime_error ( "can't write " + temporary.string() );
+            }
+
+            fs::rename ( temporary, path );
+            return true;
+        }catch ( const std::exception& e )
+        {
+            std::cout << "Error compiling scene: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    ///
+    /// SceneReader
+    ///
+
+    SceneReader::SceneReader ( const fs::path& path )
+    : _file ( MappedFile::Open ( path ) )
+    {
+        if ( !_file ) throw std::runtime_error ( "can't open " + path.string() );
+
+        const uint8_t * data = _file->Data();
+        std::size_t size = _file->Size();
+
+        if ( size < sizeof ( CompiledHeader ) ) throw std::runtime_error ( path.string() + " is too short" );
+        _header = reinterpret_cast<const CompiledHeader *>( data );
+
+        if ( std::memcmp ( _header->Magic, kMagic, sizeof ( kMagic ) ) != 0 ) throw std::runtime_error ( path.string() + " isn't a compiled scene" );
+        if ( _header->Version != CompiledHeader::kVersion || _header->Layout != KeyframeLayout() )
+        {
+            throw std::runtime_error ( path.string() + " was compiled by another version, save the scene again" );
+        }
+
+        auto& h = *_header;
+        if ( !Fits ( size, h.ElementsOffset, h.Elements, sizeof ( CompiledElement ) ) ||
+             !Fits ( size, h.TracksOffset, h.Tracks, sizeof ( CompiledTrack ) ) ||
+             !Fits ( size, h.EventsOffset, h.Events, sizeof ( CompiledEvent ) ) ||
+             !Fits ( size, h.StringsOffset, h.StringBytes, 1 ) ||
+             !Fits ( size, h.FramesOffset, h.FrameBytes, 1 ) )
+        {
+            throw std::runtime_error ( path.string() + " is truncated" );
+        }
+
+        _elements   = reinterpret_cast<const CompiledElement *>( data + h.ElementsOffset );
+        _tracks     = reinterpret_cast<const CompiledTrack *>( data + h.TracksOffset );
+        _events     = reinterpret_cast<const CompiledEvent *>( data + h.EventsOffset );
+        _strings    = reinterpret_cast<const char *>( data + h.StringsOffset );
+        _frames     = data + h.FramesOffset;
+
+        // Every string ends inside the table as long as the last byte does
+        if ( h.StringBytes == 0 || _strings[h.StringBytes - 1] != '\0' ) throw std::runtime_error ( path.string() + " has a broken string table" );
+    }
+
+    const CompiledEvent& SceneReader::Event ( std::size_t index ) const
+    {
+        if ( index >= _header->Events ) throw std::runtime_error ( "no such event" );
+        return _events[index];
+    }
+
+    std::string SceneReader::String ( uint32_t offset ) const
+    {
+        if ( offset >= _header->StringBytes ) throw std::runtime_error ( "string outside the table" );
+        return std::string ( _strings + offset );
+    }
+
+    void SceneReader::Seek ( std::size_t index )
+    {
+        if ( index >= _header->Elements ) throw std::runtime_error ( "no such element" );
+
+        _element = &_elements[index];
+        if ( _element->FirstTrack > _header->Tracks || _element->Tracks > _header->Tracks - _element->FirstTrack )
+        {
+            throw std::runtime_error ( "element tracks outside the table" );
+        }
+
+        _nextTrack = _element->FirstTrack;
+    }
+
+    const CompiledTrack& SceneReader::NextTrack ( uint32_t kind, std::size_t frameSize )
+    {
+        if ( !_element || _nextTrack >= _element->FirstTrack + _element->Tracks ) throw std::runtime_error ( "element has too few tracks" );
+
+        const CompiledTrack& track = _tracks[_nextTrack++];
+        if ( track.Kind != kind ) throw std::runtime_error ( "track of the wrong type" );
+
+        if ( !track.Shared && !Fits ( _header->FrameBytes, track.FrameOffset, track.Frames, frameSize ) )
+        {
+            throw std::runtime_error ( "track outside the frames" );
+        }
+
+        return track;
+    }
+}
@@ -0,0 +1,226 @@
+//
+//  CompiledScene.h
+//  Fluid
+//
+//  The binary form of a scene. JSON stays the format scenes are authored
+//  and passed around in; Sequencer::Compile writes this alongside it, and
+//  Sequencer::Parse maps it into memory and evaluates its keyframes where
+//  they lie instead of reading them out of a JsonTree one by one.
+//
+//  The file is a CompiledHeader followed by tables of fixed size records,
+//  a string table and the keyframes, stored exactly as KeyframeT<T> is laid
+//  out in memory. The header's Layout catches a build that lays them out
+//  differently, which needs the scene compiling again.
+//
+
+#ifndef Fluid_CompiledScene_h
+#define Fluid_CompiledScene_h
+
+#include <Time/Force.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Time
+{
+    ///
+    /// MappedFile
+    ///
+
+    // A whole file, read only. Mapped on macOS and Linux. Windows won't let a mapped file be replaced,
+    // which would stop the designer saving over a scene a node has open, so there it's read in instead.
+    using MappedFileRef = std::shared_ptr<class MappedFile>;
+    class MappedFile : public ci::Noncopyable
+    {
+    public:
+
+        // Null if the file can't be opened or is empty
+        static MappedFileRef                Open        ( const ci::fs::path& path );
+        ~MappedFile                         ( );
+
+        inline const uint8_t *              Data        ( ) const { return _data; }
+        inline std::size_t                  Size        ( ) const { return _size; }
+
+    protected:
+
+        MappedFile                          ( ) { }
+
+        const uint8_t *                     _data{nullptr};
+        std::size_t                         _size{0};
+        std::vector<uint8_t>                _buffer;            // Holds the file where it isn't mapped
+    };
+
+    ///
+    /// Records
+    ///
+
+    // Table offsets are bytes from the start of the file, a track's FrameOffset bytes from the start of
+    // the frames. Strings are offsets into the string table.
+    struct CompiledHeader
+    {
+        static const uint32_t               kVersion = 1;
+
+        char                                Magic[4];           // "FLSC"
+        uint32_t                            Version;
+        uint32_t                            Layout;             // Sizes of the keyframe types, see KeyframeLayout
+        float                               Duration;
+        uint32_t                            Settings;           // Everything else in the file, as JSON, or empty
+
+        uint32_t                            ElementsOffset, Elements;
+        uint32_t                            TracksOffset, Tracks;
+        uint32_t                            EventsOffset, Events;
+        uint32_t                            StringsOffset, StringBytes;
+        uint32_t                            FramesOffset, FrameBytes;
+    };
+
+    struct CompiledElement
+    {
+        uint32_t                            Type;
+        int32_t                             ID;
+        uint32_t                            Name;
+        int32_t                             Template;           // Index of the element this is an instance of, or -1
+        float                               StartTime;
+        float                               Offset[2];
+        int32_t                             TextureIndex;
+        uint32_t                            FirstTrack, Tracks; // In the order the element writes them
+    };
+
+    struct CompiledTrack
+    {
+        uint32_t                            Kind;               // TrackKind<T>
+        uint32_t                            Shared;             // Follows the template, no frames of its own
+        uint32_t                            FrameOffset;
+        uint32_t                            Frames;
+    };
+
+    struct CompiledEvent
+    {
+        float                               Time;
+        uint32_t                            Name;
+    };
+
+    template <typename T> struct TrackKind;
+    template <> struct TrackKind<float>         { static const uint32_t Value = 1; };
+    template <> struct TrackKind<ci::vec2>      { static const uint32_t Value = 2; };
+    template <> struct TrackKind<ci::Colorf>    { static const uint32_t Value = 3; };
+
+    inline uint32_t                         KeyframeLayout ( )
+    {
+        return static_cast<uint32_t>( sizeof ( KeyframeT<float> ) | sizeof ( KeyframeT<ci::vec2> ) << 8 | sizeof ( KeyframeT<ci::Colorf> ) << 16 );
+    }
+
+    ///
+    /// SceneWriter
+    ///
+
+    // Elements add themselves through Element::Compile
+    class SceneWriter
+    {
+    public:
+
+        // Elements an instance's template can be found in
+        SceneWriter                         ( const std::vector<ElementRef>& elements );
+
+        void                                Add         ( const ElementRef& element );
+        void                                AddEvent    ( float time, const std::string& name );
+
+        // The record being written, valid until the next Add
+        inline CompiledElement&             Element     ( ) { return _elements.back(); }
+
+        template <typename T>
+        void                                Track       ( const PropertyT<T>& property )
+        {
+            CompiledTrack track;
+            track.Kind          = TrackKind<T>::Value;
+            track.Shared        = property.IsShared() ? 1 : 0;
+            track.FrameOffset   = Align ( );
+            track.Frames        = 0;
+
+            if ( !property.IsShared() )
+            {
+                auto frames = property.Keyframes();
+                const uint8_t * bytes = reinterpret_cast<const uint8_t *>( frames.data() );
+
+                _frames.insert ( _frames.end(), bytes, bytes + frames.size() * sizeof ( KeyframeT<T> ) );
+                track.Frames = static_cast<uint32_t>( frames.size() );
+            }
+
+            _tracks.push_back ( track );
+            Element().Tracks++;
+        }
+
+        uint32_t                            String      ( const std::string& value );
+        int32_t                             IndexOf     ( const ElementRef& element ) const;
+
+        // Replaces path in one step, so anything that has the old file mapped keeps it intact
+        bool                                Write       ( const ci::fs::path& path, float duration, const std::string& settings );
+
+    protected:
+
+        uint32_t                            Align       ( );
+
+        const std::vector<ElementRef>&      _source;
+        std::vector<CompiledElement>        _elements;
+        std::vector<CompiledTrack>          _tracks;
+        std::vector<CompiledEvent>          _events;
+        std::vector<uint8_t>                _frames;
+        std::string                         _strings;
+    };
+
+    ///
+    /// SceneReader
+    ///
+
+    // Checks every table fits the file before anything reads it, and throws std::runtime_error if not
+    class SceneReader
+    {
+    public:
+
+        SceneReader                         ( const ci::fs::path& path );
+
+        inline const CompiledHeader&        Header      ( ) const { return *_header; }
+        inline std::size_t                  Elements    ( ) const { return _header->Elements; }
+        inline std::size_t                  Events      ( ) const { return _header->Events; }
+
+        const CompiledEvent&                Event       ( std::size_t index ) const;
+        std::string                         String      ( uint32_t offset ) const;
+
+        // Moves on to element index, which Element and Track then read from
+        void                                Seek        ( std::size_t index );
+        inline const CompiledElement&       Element     ( ) const { return *_element; }
+
+        // Maps the current element's next track into property, leaving a shared one as it is
+        template <typename T>
+        void                                Track       ( PropertyT<T>& property )
+        {
+            const CompiledTrack& track = NextTrack ( TrackKind<T>::Value, sizeof ( KeyframeT<T> ) );
+            if ( track.Shared )
+            {
+                if ( !property.IsShared() ) throw std::runtime_error ( "shared track outside an instance" );
+                return;
+            }
+
+            auto frames = reinterpret_cast<const KeyframeT<T> *>( _frames + track.FrameOffset );
+            property.Map ( _file, frames, track.Frames );
+        }
+
+    protected:
+
+        const CompiledTrack&                NextTrack   ( uint32_t kind, std::size_t frameSize );
+
+        MappedFileRef                       _file;
+        const CompiledHeader *              _header{nullptr};
+        const CompiledElement *             _elements{nullptr};
+        const CompiledTrack *               _tracks{nullptr};
+        const CompiledEvent *               _events{nullptr};
+        const char *                        _strings{nullptr};
+        const uint8_t *                     _frames{nullptr};
+
+        const CompiledElement *             _element{nullptr};
+        uint32_t                            _nextTrack{0};
+    };
+}
+
+#endif /* Fluid_CompiledScene_h */
@@ -0,0 +1,115 @@
+//
+//  EmitterTable.cxx
+//  Fluid
+//
+
+#include <Time/EmitterTable.h>
+
+using namespace ci;
+
+namespace Time
+{
+    namespace
+    {
+        // field if property has to be read from the emitter, else 0
+        template <typename T>
+        inline uint8_t      PackOrDirect    ( const PropertyT<T>& property, PackedTrack<T>& packed, float startTime, uint8_t field )
+        {
+            if ( property.Pack ( packed, startTime ) ) return 0;
+
+            // Keeps the lanes lined up with the emitters, Update has this one read from the emitter
+            packed.AddConstant ( T{} );
+            return field;
+        }
+    }
+
+    EmitterTable::Sources EmitterTable::SourcesOf ( const Emitter& e )
+    {
+        Sources sources;
+        sources[0] = { &e.Position().Track(), e.Position().Revision() };
+        sources[1] = { &e.Velocity().Track(), e.Velocity().Revision() };
+        sources[2] = { &e.Color().Track(), e.Color().Revision() };
+        sources[3] = { &e.Radius().Track(), e.Radius().Revision() };
+        sources[4] = { &e.Temperature().Track(), e.Temperature().Revision() };
+        sources[5] = { &e.Density().Track(), e.Density().Revision() };
+        return sources;
+    }
+
+    bool EmitterTable::Changed ( const std::vector<EmitterRef>& emitters ) const
+    {
+        if ( emitters.size() != _emitters.size() ) return true;
+
+        for ( std::size_t i = 0; i < emitters.size(); i++ )
+        {
+            const Emitter& e = *emitters[i];
+            if ( emitters[i] != _emitters[i] || e.StartTime() != _startTimes[i] ) return true;
+
+            Sources sources = SourcesOf ( e );
+            for ( std::size_t p = 0; p < kProperties; p++ )
+            {
+                if ( sources[p].Track != _sources[i][p].Track || sources[p].Revision != _sources[i][p].Revision ) return true;
+            }
+        }
+
+        return false;
+    }
+
+    void EmitterTable::Pack ( const std::vector<EmitterRef>& emitters )
+    {
+        _emitters = emitters;
+        _sources.clear();
+        _startTimes.clear();
+        _unpacked.clear();
+
+        _position.Clear();
+        _velocity.Clear();
+        _color.Clear();
+        _radius.Clear();
+        _temperature.Clear();
+        _density.Clear();
+
+        for ( auto& emitter : _emitters )
+        {
+            const Emitter& e = *emitter;
+            float start = e.StartTime();
+
+            uint8_t unpacked = 0;
+            unpacked |= PackOrDirect ( e.Position(), _position, start, kPosition );
+            unpacked |= PackOrDirect ( e.Velocity(), _velocity, start, kVelocity );
+            unpacked |= PackOrDirect ( e.Color(), _color, start, kColor );
+            unpacked |= PackOrDirect ( e.Radius(), _radius, start, kRadius );
+            unpacked |= PackOrDirect ( e.Temperature(), _temperature, start, kTemperature );
+            unpacked |= PackOrDirect ( e.Density(), _density, start, kDensity );
+
+            _sources.push_back ( SourcesOf ( e ) );
+            _startTimes.push_back ( start );
+            _unpacked.push_back ( unpacked );
+        }
+
+        _repacks++;
+    }
+
+    void EmitterTable::Update ( const std::vector<EmitterRef>& emitters )
+    {
+        if ( Changed ( emitters ) ) Pack ( emitters );
+
+        _offsets.resize ( _emitters.size() );
+        _direct.clear();
+
+        for ( std::size_t i = 0; i < _emitters.size(); i++ )
+        {
+            const Emitter& e = *_emitters[i];
+            _offsets[i] = e.Offset();
+
+            uint8_t fields = _unpacked[i];
+            if ( e.Position().IsOverridden() )      fields |= kPosition;
+            if ( e.Velocity().IsOverridden() )      fields |= kVelocity;
+            if ( e.Color().IsOverridden() )         fields |= kColor;
+            if ( e.Radius().IsOverridden() )        fields |= kRadius;
+            if ( e.Temperature().IsOverridden() )   fields |= kTemperature;
+            if ( e.Density().IsOverridden() )       fields |= kDensity;
+
+            if ( fields ) _direct.push_back ( { static_cast<uint32_t>( i ), fields } );
+        }
+    }
+}
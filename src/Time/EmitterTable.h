@@ -0,0 +1,97 @@
+//
+//  EmitterTable.h
+//  Fluid
+//
+//  Every emitter's baked properties packed one property at a time, so a
+//  frame evaluates all emitters in a pass over flat arrays per property
+//  rather than going through each emitter's properties in turn. Repacked
+//  only when an emitter or its keyframes change.
+//
+
+#ifndef Fluid_EmitterTable_h
+#define Fluid_EmitterTable_h
+
+#include <Time/Force.h>
+
+#include <array>
+
+namespace Time
+{
+    class EmitterTable
+    {
+    public:
+
+        // Which of an emitter's properties to take from the emitter rather than the table
+        enum Field : uint8_t
+        {
+            kPosition       = 0x01,
+            kVelocity       = 0x02,
+            kColor          = 0x04,
+            kRadius         = 0x08,
+            kTemperature    = 0x10,
+            kDensity        = 0x20
+        };
+
+        struct Direct
+        {
+            uint32_t                            Index{0};
+            uint8_t                             Fields{0};
+        };
+
+        // Repacks if the emitters, or anything packed from them, have changed since the last call,
+        // then lists what can't be read from the packed tracks this frame: overridden properties and
+        // animated ones that aren't baked. Main thread.
+        void                                    Update          ( const std::vector<EmitterRef>& emitters );
+
+        inline std::size_t                      Size            ( ) const { return _emitters.size(); }
+
+        // Lane i of each track is emitters[i], in the order given to Update
+        inline const PackedTrack<ci::vec2>&     Position        ( ) const { return _position; }
+        inline const PackedTrack<ci::vec2>&     Velocity        ( ) const { return _velocity; }
+        inline const PackedTrack<ci::Colorf>&   Color           ( ) const { return _color; }
+        inline const PackedTrack<float>&        Radius          ( ) const { return _radius; }
+        inline const PackedTrack<float>&        Temperature     ( ) const { return _temperature; }
+        inline const PackedTrack<float>&        Density         ( ) const { return _density; }
+        inline const std::vector<ci::vec2>&     Offsets         ( ) const { return _offsets; }
+
+        inline const std::vector<EmitterRef>&   Emitters        ( ) const { return _emitters; }
+        inline const std::vector<Direct>&       Directs         ( ) const { return _direct; }
+
+        // Times the tracks have been packed
+        inline std::size_t                      Repacks         ( ) const { return _repacks; }
+
+    protected:
+
+        // What the packed lanes were built from, per emitter and property
+        struct Source
+        {
+            const void *                        Track{nullptr};
+            uint32_t                            Revision{0};
+        };
+
+        static const std::size_t                kProperties = 6;
+        using Sources                           = std::array<Source, kProperties>;
+
+        static Sources                          SourcesOf       ( const Emitter& e );
+        bool                                    Changed         ( const std::vector<EmitterRef>& emitters ) const;
+        void                                    Pack            ( const std::vector<EmitterRef>& emitters );
+
+        std::vector<EmitterRef>                 _emitters;          // Held so none of them is reused while packed
+        std::vector<Sources>                    _sources;
+        std::vector<float>                      _startTimes;
+        std::vector<uint8_t>                    _unpacked;          // Fields per emitter Pack couldn't take
+
+        PackedTrack<ci::vec2>                   _position;
+        PackedTrack<ci::vec2>                   _velocity;
+        PackedTrack<ci::Colorf>                 _color;
+        PackedTrack<float>                      _radius;
+        PackedTrack<float>                      _temperature;
+        PackedTrack<float>                      _density;
+        std::vector<ci::vec2>                   _offsets;           // Copied every Update, they're cheap to change
+
+        std::vector<Direct>                     _direct;
+        std::size_t                             _repacks{0};
+    };
+}
+
+#endif /* Fluid_EmitterTable_h */
@@ -6,52 +6,117 @@
 //
 
 #include <Time/Force.h>
+#include <Time/CompiledScene.h>
 #include <Time/Sequencer.h>
 #include "CinderImGui.h"
 
+#include <atomic>
+
 using namespace ci;
 
 namespace Time
 {
-    static int kNextID = 0;
-    bool Element::kIsLeft = false;
+    // Elements are also built on the scene watcher's thread
+    static std::atomic<int> kNextID { 0 };
+    std::string Element::kObstacleSet = "ObstaclesRight";
+    
+    // At namespace scope rather than function statics, which aren't thread safe on VS2013
+    static const std::unordered_map<int, std::string> kElementTypeToString =
+    {
+        { (int)ElementType::Emitter, "Emitter" },
+        { (int)ElementType::Attractor, "Attractor" },
+        { (int)ElementType::Obstacle, "Obstacle" }
+    };
+    
+    static const std::unordered_map<std::string, ElementType> kNameToElementType =
+    {
+        { "Emitter", ElementType::Emitter },
+        { "Attractor", ElementType::Attractor },
+        { "Obstacle", ElementType::Obstacle }
+    };
    
     static const std::string& ElementTypeToString ( ElementType type )
     {
-        static std::unordered_map<int, std::string> kElementTypeToString =
-        {
-            { (int)ElementType::Emitter, "Emitter" },
-            { (int)ElementType::Attractor, "Attractor" },
-            { (int)ElementType::Obstacle, "Obstacle" }
-        };
-        
-        return kElementTypeToString[(int)type];
+        return kElementTypeToString.at( (int)type );
     }
     
     static ElementType ElementTypeFromString ( const std::string& name )
     {
-        static std::unordered_map<std::string, ElementType> kNameToElementType =
+        auto it = kNameToElementType.find( name );
+        if ( it == kNameToElementType.end() ) throw std::runtime_error ( "unknown element type " + name );
+        return it->second;
+    }
+    
+    // Instances only list the properties they have changed from their template
+    template <typename T>
+    static void SerializeTrack ( JsonTree& tree, const PropertyT<T>& property, const std::string& name )
+    {
+        if ( !property.IsShared() ) Time::Serialize( tree, property, name );
+    }
+    
+    template <typename T>
+    static void MarshalTrack ( const JsonTree& tree, PropertyT<T>& property, const std::string& name )
+    {
+        if ( !property.IsShared() || tree.hasChild( name ) ) property = PropertyT<T> ( tree[name] );
+    }
+    
+    // Ids handed out from here on start past any loaded
+    static void ReserveID ( int id )
+    {
+        int next = kNextID.load();
+        while ( next < id + 1 && !kNextID.compare_exchange_weak( next, id + 1 ) ) { }
+    }
+    
+    template <typename T, typename E>
+    static typename PropertyT<T>::SharedTrack Track ( const std::shared_ptr<E>& source, const PropertyT<T>& property )
+    {
+        return typename PropertyT<T>::SharedTrack ( source, &property );
+    }
+    
+    // Replaces property's keyframes with other's, or shares them from source's property as other
+    // shares its template's, unless it already matches
+    template <typename T, typename E>
+    static bool PatchTrack ( PropertyT<T>& property, const PropertyT<T>& other, const std::shared_ptr<E>& source, const PropertyT<T> * sourceProperty )
+    {
+        if ( other.IsShared() && sourceProperty )
         {
-            { "Emitter", ElementType::Emitter },
-            { "Attractor", ElementType::Attractor },
-            { "Obstacle", ElementType::Obstacle }
-        };
+            if ( property.IsShared() && &property.Track() == &sourceProperty->Track() ) return false;
+            property.Share ( Track ( source, *sourceProperty ) );
+            return true;
+        }
         
-        return kNameToElementType[name];
+        if ( !property.IsShared() && property.SameKeyframes ( other ) ) return false;
+        property.TakeKeyframes ( other );
+        return true;
     }
     
     ///
     /// Element
     ///
     
-    ElementRef MakeElement ( const ci::JsonTree& tree )
+    ElementRef MakeElement ( ElementType type )
+    {
+        switch ( type )
+        {
+            case ElementType::Emitter   : return std::make_shared<Emitter>();
+            case ElementType::Attractor : return std::make_shared<Attractor>();
+            case ElementType::Obstacle  : return std::make_shared<Obstacle>();
+        }
+        
+        return nullptr;
+    }
+    
+    ElementRef MakeElement ( const ci::JsonTree& tree, const ElementRef& instanceOf )
     {
         auto type = ElementTypeFromString( tree["Type"].getValue() );
+        if ( instanceOf && ( instanceOf->GetType() != type || instanceOf->IsInstance() ) ) throw std::runtime_error ( "instance of the wrong element" );
+        
         switch ( type )
         {
             case ElementType::Emitter :
             {
                 auto e = std::make_shared<Emitter>();
+                if ( instanceOf ) e->Instance( instanceOf );
                 e->Marshal( tree );
                 return e;
             }
@@ -59,6 +124,7 @@ namespace Time
             case ElementType::Attractor :
             {
                 auto e = std::make_shared<Attractor>();
+                if ( instanceOf ) e->Instance( instanceOf );
                 e->Marshal( tree );
                 return e;
             }
@@ -66,6 +132,7 @@ namespace Time
             case ElementType::Obstacle :
             {
                 auto e = std::make_shared<Obstacle>();
+                if ( instanceOf ) e->Instance( instanceOf );
                 e->Marshal( tree );
                 return e;
             }
@@ -74,6 +141,21 @@ namespace Time
         return nullptr;
     }
     
+    ElementRef MakeElement ( SceneReader& reader, const ElementRef& instanceOf )
+    {
+        ElementRef e = MakeElement ( (ElementType)reader.Element().Type );
+        if ( !e ) throw std::runtime_error ( "unknown element type" );
+        
+        if ( instanceOf )
+        {
+            if ( instanceOf->GetType() != e->GetType() || instanceOf->IsInstance() ) throw std::runtime_error ( "instance of the wrong element" );
+            e->Instance( instanceOf );
+        }
+        
+        e->Map( reader );
+        return e;
+    }
+    
     Element::Element ( )
     : _id ( kNextID++ )
     , _name ( "Untitled Element" )
@@ -104,8 +186,19 @@ namespace Time
         tree.pushBack( JsonTree ( "Name", Name() ) );
         tree.pushBack( JsonTree ( "ID", _id ) );
         
-        Time::Serialize( tree, _position, "Position" );
-        Time::Serialize( tree, _radius,   "Radius" );
+        if ( _template )
+        {
+            JsonTree offset = JsonTree::makeObject( "Offset" );
+            offset.pushBack( JsonTree ( "x", _offset.x ) );
+            offset.pushBack( JsonTree ( "y", _offset.y ) );
+            
+            tree.pushBack( JsonTree ( "Instance", _template->Name() ) );
+            tree.pushBack( JsonTree ( "StartTime", _startTime ) );
+            tree.pushBack( offset );
+        }
+        
+        SerializeTrack( tree, _position, "Position" );
+        SerializeTrack( tree, _radius,   "Radius" );
     }
     
     void Element::Marshal ( const ci::JsonTree& tree )
@@ -113,14 +206,87 @@ namespace Time
         _name = tree["Name"].getValue();
         _id = tree["ID"].getValue<int>();
         
-        _position = Vec2Property  ( tree["Position"] );
-        _radius   = FloatProperty ( tree["Radius"] );
+        if ( tree.hasChild( "StartTime" ) ) _startTime = tree["StartTime"].getValue<float>();
+        if ( tree.hasChild( "Offset" ) ) _offset = vec2 ( tree["Offset.x"].getValue<float>(), tree["Offset.y"].getValue<float>() );
+        
+        MarshalTrack( tree, _position, "Position" );
+        MarshalTrack( tree, _radius,   "Radius" );
+        
+        ReserveID ( _id );
+    }
+    
+    void Element::Compile ( SceneWriter& writer ) const
+    {
+        auto& record = writer.Element();
+        record.Type         = (uint32_t)GetType();
+        record.ID           = _id;
+        record.Name         = writer.String( _name );
+        record.Template     = writer.IndexOf( _template );
+        record.StartTime    = _startTime;
+        record.Offset[0]    = _offset.x;
+        record.Offset[1]    = _offset.y;
+        
+        writer.Track( _position );
+        writer.Track( _radius );
+    }
+    
+    void Element::Map ( SceneReader& reader )
+    {
+        auto& record = reader.Element();
+        _name       = reader.String( record.Name );
+        _id         = record.ID;
+        _startTime  = record.StartTime;
+        _offset     = vec2 ( record.Offset[0], record.Offset[1] );
+        
+        reader.Track( _position );
+        reader.Track( _radius );
         
-        kNextID = std::max(_id+1, kNextID);
+        ReserveID ( _id );
+    }
+    
+    void Element::Instance ( const ElementRef& source )
+    {
+        _template = source;
+        _position.Share ( Track ( source, source->_position ) );
+        _radius.Share ( Track ( source, source->_radius ) );
+    }
+    
+    std::size_t Element::Bake ( float rate )
+    {
+        _position.Bake ( rate );
+        _radius.Bake ( rate );
+        return _position.BakedSamples() + _radius.BakedSamples();
+    }
+    
+    bool Element::Patch ( const Element& other, const ElementRef& source )
+    {
+        bool changed = _name != other._name || _id != other._id || _startTime != other._startTime || _offset != other._offset || _template != source;
+        
+        _name       = other._name;
+        _id         = other._id;
+        _startTime  = other._startTime;
+        _offset     = other._offset;
+        _template   = source;
+        
+        changed |= PatchTrack ( _position, other._position, source, source ? &source->_position : nullptr );
+        changed |= PatchTrack ( _radius, other._radius, source, source ? &source->_radius : nullptr );
+        
+        ReserveID ( _id );
+        return changed;
     }
     
     void Element::InternalInspect ( )
     {
+        if ( _template )
+        {
+            ui::Text ( "Instance of %s", _template->Name().c_str() );
+            ui::DragFloat ( "Start Time", &_startTime, 0.01f );
+            ui::DragFloat2 ( "Offset", &_offset.x, 0.1f );
+        }
+        
+        // Added after the element list has been drawn
+        if ( ui::Button ( "+ Instance" ) ) Sequencer::Default().QueueInstance ( _template ? _template : shared_from_this() );
+        
         Time::Inspect ( _position   , "Position"    );
         Time::Inspect ( _radius     , "Radius"      );
     }
@@ -147,20 +313,75 @@ namespace Time
     {
         Element::Serialize( tree );
         
-        Time::Serialize( tree, _velocity, "Velocity" );
-        Time::Serialize( tree, _color, "Color" );
-        Time::Serialize( tree, _temperature, "Temperature" );
-        Time::Serialize( tree, _density, "Density" );
+        SerializeTrack( tree, _velocity, "Velocity" );
+        SerializeTrack( tree, _color, "Color" );
+        SerializeTrack( tree, _temperature, "Temperature" );
+        SerializeTrack( tree, _density, "Density" );
     }
     
     void Emitter::Marshal ( const ci::JsonTree& tree )
     {
         Element::Marshal( tree );
         
-        _velocity    = Vec2Property  ( tree["Velocity"] );
-        _color       = ColorProperty ( tree["Color" ] );
-        _temperature = FloatProperty ( tree["Temperature" ] );
-        _density     = FloatProperty ( tree["Density" ] );
+        MarshalTrack( tree, _velocity, "Velocity" );
+        MarshalTrack( tree, _color, "Color" );
+        MarshalTrack( tree, _temperature, "Temperature" );
+        MarshalTrack( tree, _density, "Density" );
+    }
+    
+    void Emitter::Compile ( SceneWriter& writer ) const
+    {
+        Element::Compile( writer );
+        
+        writer.Track( _velocity );
+        writer.Track( _color );
+        writer.Track( _temperature );
+        writer.Track( _density );
+    }
+    
+    void Emitter::Map ( SceneReader& reader )
+    {
+        Element::Map( reader );
+        
+        reader.Track( _velocity );
+        reader.Track( _color );
+        reader.Track( _temperature );
+        reader.Track( _density );
+    }
+    
+    void Emitter::Instance ( const ElementRef& source )
+    {
+        Element::Instance ( source );
+        
+        auto e = std::static_pointer_cast<const Emitter>( source );
+        _velocity.Share ( Track ( e, e->_velocity ) );
+        _color.Share ( Track ( e, e->_color ) );
+        _temperature.Share ( Track ( e, e->_temperature ) );
+        _density.Share ( Track ( e, e->_density ) );
+    }
+    
+    std::size_t Emitter::Bake ( float rate )
+    {
+        _velocity.Bake ( rate );
+        _color.Bake ( rate );
+        _temperature.Bake ( rate );
+        _density.Bake ( rate );
+        
+        return Element::Bake ( rate ) + _velocity.BakedSamples() + _color.BakedSamples() + _temperature.BakedSamples() + _density.BakedSamples();
+    }
+    
+    bool Emitter::Patch ( const Element& other, const ElementRef& source )
+    {
+        bool changed = Element::Patch ( other, source );
+        
+        auto& e = static_cast<const Emitter&>( other );
+        auto s = std::static_pointer_cast<const Emitter>( source );
+        changed |= PatchTrack ( _velocity, e._velocity, s, s ? &s->_velocity : nullptr );
+        changed |= PatchTrack ( _color, e._color, s, s ? &s->_color : nullptr );
+        changed |= PatchTrack ( _temperature, e._temperature, s, s ? &s->_temperature : nullptr );
+        changed |= PatchTrack ( _density, e._density, s, s ? &s->_density : nullptr );
+        
+        return changed;
     }
     
     ///
@@ -181,13 +402,47 @@ namespace Time
     void Attractor::Serialize ( JsonTree& tree )
     {
         Element::Serialize( tree );
-        Time::Serialize( tree, _force, "Force" );
+        SerializeTrack( tree, _force, "Force" );
     }
     
     void Attractor::Marshal ( const ci::JsonTree& tree )
     {
         Element::Marshal( tree );
-        _force = FloatProperty ( tree["Force" ] );
+        MarshalTrack( tree, _force, "Force" );
+    }
+    
+    void Attractor::Compile ( SceneWriter& writer ) const
+    {
+        Element::Compile( writer );
+        writer.Track( _force );
+    }
+    
+    void Attractor::Map ( SceneReader& reader )
+    {
+        Element::Map( reader );
+        reader.Track( _force );
+    }
+    
+    void Attractor::Instance ( const ElementRef& source )
+    {
+        Element::Instance ( source );
+        
+        auto e = std::static_pointer_cast<const Attractor>( source );
+        _force.Share ( Track ( e, e->_force ) );
+    }
+    
+    std::size_t Attractor::Bake ( float rate )
+    {
+        _force.Bake ( rate );
+        return Element::Bake ( rate ) + _force.BakedSamples();
+    }
+    
+    bool Attractor::Patch ( const Element& other, const ElementRef& source )
+    {
+        bool changed = Element::Patch ( other, source );
+        
+        auto s = std::static_pointer_cast<const Attractor>( source );
+        return PatchTrack ( _force, static_cast<const Attractor&>( other )._force, s, s ? &s->_force : nullptr ) || changed;
     }
     
     ///
@@ -202,7 +457,7 @@ namespace Time
         static bool kInit = false;
         if ( !kInit )
         {
-            fs::directory_iterator it { app::getAssetPath( Element::kIsLeft ? "ObstaclesLeft" : "ObstaclesRight" ) }, end;
+            fs::directory_iterator it { app::getAssetPath( Element::kObstacleSet ) }, end;
             while ( it != end )
             {
                 if ( it->path().extension().string() == ".png" )
@@ -290,7 +545,7 @@ namespace Time
     void Obstacle::Serialize ( JsonTree& tree )
     {
         Element::Serialize( tree );
-        Time::Serialize( tree, _rotation, "Rotation" );
+        SerializeTrack( tree, _rotation, "Rotation" );
         tree.pushBack ( JsonTree ( "TextureIndex", _textureIndex ) );
     }
     
@@ -298,7 +553,49 @@ namespace Time
     {
         Element::Marshal( tree );
         
-        _rotation = FloatProperty ( tree["Rotation"] );
-        _textureIndex = tree["TextureIndex"].getValue<int>();
+        MarshalTrack( tree, _rotation, "Rotation" );
+        if ( !IsInstance() || tree.hasChild( "TextureIndex" ) ) _textureIndex = tree["TextureIndex"].getValue<int>();
+    }
+    
+    void Obstacle::Compile ( SceneWriter& writer ) const
+    {
+        Element::Compile( writer );
+        writer.Track( _rotation );
+        writer.Element().TextureIndex = _textureIndex;
+    }
+    
+    void Obstacle::Map ( SceneReader& reader )
+    {
+        Element::Map( reader );
+        reader.Track( _rotation );
+        _textureIndex = reader.Element().TextureIndex;
+    }
+    
+    void Obstacle::Instance ( const ElementRef& source )
+    {
+        Element::Instance ( source );
+        
+        auto e = std::static_pointer_cast<const Obstacle>( source );
+        _rotation.Share ( Track ( e, e->_rotation ) );
+        _textureIndex = e->_textureIndex;
+    }
+    
+    std::size_t Obstacle::Bake ( float rate )
+    {
+        _rotation.Bake ( rate );
+        return Element::Bake ( rate ) + _rotation.BakedSamples();
+    }
+    
+    bool Obstacle::Patch ( const Element& other, const ElementRef& source )
+    {
+        bool changed = Element::Patch ( other, source );
+        
+        auto& o = static_cast<const Obstacle&>( other );
+        auto s = std::static_pointer_cast<const Obstacle>( source );
+        changed |= PatchTrack ( _rotation, o._rotation, s, s ? &s->_rotation : nullptr );
+        
+        changed |= _textureIndex != o._textureIndex;
+        _textureIndex = o._textureIndex;
+        return changed;
     }
 }
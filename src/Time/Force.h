@@ -25,18 +25,29 @@ namespace Time
     using AttractorRef              = std::shared_ptr<class Attractor>;
     using ObstacleRef               = std::shared_ptr<class Obstacle>;
     
-    ElementRef                      MakeElement ( const ci::JsonTree& tree );
+    class SceneWriter;
+    class SceneReader;
+    
+    // An instance shares instanceOf's keyframes for any property the tree doesn't list itself. Both
+    // loaders throw on an unknown type or an instance of the wrong element
+    ElementRef                      MakeElement ( const ci::JsonTree& tree, const ElementRef& instanceOf = nullptr );
+    
+    // The same from the reader's current element, mapping its keyframes rather than copying them
+    ElementRef                      MakeElement ( SceneReader& reader, const ElementRef& instanceOf = nullptr );
+    
+    // A new element of type with the default properties
+    ElementRef                      MakeElement ( ElementType type );
     
     class Element                   : public std::enable_shared_from_this<Element>
     {
     public:
         
-        static bool                 kIsLeft;
+        static std::string          kObstacleSet;   // Asset folder for the obstacle textures
         
         Element                     ( );
         virtual ~Element            ( ) { }
         
-        inline ci::vec2             PositionAt          ( float t ) const { return _position.ValueAtTime ( _startTime + t ); }
+        inline ci::vec2             PositionAt          ( float t ) const { return _position.ValueAtTime ( _startTime + t ) + _offset; }
         inline float                RadiusAt            ( float t ) const { return _radius.ValueAtTime ( _startTime + t ); }
         virtual ci::Rectf           GetBoundsAt         ( float t ) const;
         
@@ -46,12 +57,35 @@ namespace Time
         inline const FloatProperty& Radius              ( ) const { return _radius; }
         inline FloatProperty&       Radius              ( ) { return _radius; }
         
+        inline float                StartTime           ( ) const { return _startTime; }
         inline float&               StartTime           ( ) { return _startTime; }
+        inline const ci::vec2&      Offset              ( ) const { return _offset; }
+        inline ci::vec2&            Offset              ( ) { return _offset; }
         inline std::string&         Name                ( ) { return _name; }
+        inline const std::string&   Name                ( ) const { return _name; }
+        inline int                  ID                  ( ) const { return _id; }
+        
+        // Shares source's keyframes, copying each property only once it is edited. Source must be
+        // the same type and not an instance itself.
+        virtual void                Instance            ( const ElementRef& source );
+        inline const ElementRef&    Template            ( ) const { return _template; }
+        inline bool                 IsInstance          ( ) const { return _template != nullptr; }
         
         virtual void                Serialize           ( ci::JsonTree& tree );
         virtual void                Marshal             ( const ci::JsonTree& tree );
         
+        // The compiled scene equivalents, see CompiledScene.h. Properties go in the same order both ways.
+        virtual void                Compile             ( SceneWriter& writer ) const;
+        virtual void                Map                 ( SceneReader& reader );
+        
+        // Bakes every property at rate samples per second, see PropertyT::Bake. Returns the samples held.
+        virtual std::size_t         Bake                ( float rate );
+        
+        // Brings this element into line with other, the same element of the same type in a newly loaded
+        // scene, keeping everything held at runtime such as overrides. source is this scene's match for
+        // other's template. Only tracks that differ are replaced. Returns whether anything changed.
+        virtual bool                Patch               ( const Element& other, const ElementRef& source );
+        
         void                        Inspect             ( );
         virtual ElementType         GetType             ( ) const = 0;
     
@@ -62,6 +96,8 @@ namespace Time
         int                         _id{0};
         std::string                 _name;
         float                       _startTime{0.0f};
+        ci::vec2                    _offset{0.0f, 0.0f};    // Added to the position
+        ElementRef                  _template;
         
         Vec2Property                _position{ci::vec2(100.0f, 180.0f)};
         FloatProperty               _radius{64.0f};
@@ -98,6 +134,11 @@ namespace Time
         
         void                        Serialize           ( ci::JsonTree& tree ) override;
         void                        Marshal             ( const ci::JsonTree& tree ) override;
+        void                        Compile             ( SceneWriter& writer ) const override;
+        void                        Map                 ( SceneReader& reader ) override;
+        std::size_t                 Bake                ( float rate ) override;
+        bool                        Patch               ( const Element& other, const ElementRef& source ) override;
+        void                        Instance            ( const ElementRef& source ) override;
         
     protected:
         
@@ -128,6 +169,11 @@ namespace Time
         
         void                        Serialize           ( ci::JsonTree& tree ) override;
         void                        Marshal             ( const ci::JsonTree& tree ) override;
+        void                        Compile             ( SceneWriter& writer ) const override;
+        void                        Map                 ( SceneReader& reader ) override;
+        std::size_t                 Bake                ( float rate ) override;
+        bool                        Patch               ( const Element& other, const ElementRef& source ) override;
+        void                        Instance            ( const ElementRef& source ) override;
         
     protected:
         
@@ -159,6 +205,11 @@ namespace Time
         
         void                        Serialize           ( ci::JsonTree& tree ) override;
         void                        Marshal             ( const ci::JsonTree& tree ) override;
+        void                        Compile             ( SceneWriter& writer ) const override;
+        void                        Map                 ( SceneReader& reader ) override;
+        std::size_t                 Bake                ( float rate ) override;
+        bool                        Patch               ( const Element& other, const ElementRef& source ) override;
+        void                        Instance            ( const ElementRef& source ) override;
         
         void                        Draw                ( float overhang = 1.0f );
         
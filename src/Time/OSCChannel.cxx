@@ -6,16 +6,106 @@
 //
 
 #include <Time/OSCChannel.h>
-#include <asio/io_service.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined( __linux__ )
+#include <sys/socket.h>
+#endif
 
 using namespace ci;
 
 namespace Time
 {
+    namespace
+    {
+        const int           kFastPingMs     = 250;      // Until the filter locks
+        const int           kSlowPingMs     = 1000;
+
+    }
+    
+    ///
+    /// Clock Sync
+    ///
+    
+    ClockSample::ClockSample ( double t0, double t1, double t2, double t3 )
+    : Offset ( ( ( t1 - t0 ) + ( t2 - t3 ) ) * 0.5 )
+    , Delay ( ( t3 - t0 ) - ( t2 - t1 ) )
+    {
+    }
+    
+    const int ClockFilter::kWindow;
+    
+    void ClockFilter::Add ( const ClockSample& sample )
+    {
+        _samples[_next] = sample;
+        _next = ( _next + 1 ) % kWindow;
+        _count = std::min ( _count + 1, kWindow );
+    }
+    
+    void ClockFilter::Reset ( )
+    {
+        _next = 0;
+        _count = 0;
+    }
+    
+    double ClockFilter::Offset ( ) const
+    {
+        if ( _count == 0 ) return 0.0;
+        
+        const ClockSample * best = &_samples[0];
+        for ( int i = 1; i < _count; i++ )
+        {
+            if ( _samples[i].Delay < best->Delay ) best = &_samples[i];
+        }
+        
+        return best->Offset;
+    }
+    
+    double ClockFilter::RoundTrip ( ) const
+    {
+        if ( _count == 0 ) return 0.0;
+        
+        double delay = _samples[0].Delay;
+        for ( int i = 1; i < _count; i++ ) delay = std::min ( delay, _samples[i].Delay );
+        return delay;
+    }
+    
+    double ClockFilter::Jitter ( ) const
+    {
+        if ( _count < 2 ) return 0.0;
+        
+        double offset = Offset();
+        double sum = 0.0;
+        for ( int i = 0; i < _count; i++ )
+        {
+            double d = _samples[i].Offset - offset;
+            sum += d * d;
+        }
+        
+        return std::sqrt ( sum / ( _count - 1 ) );
+    }
+    
+    ///
+    /// OSCChannel
+    ///
+    
+    const OSCChannel::AddressId OSCChannel::kInvalidAddress;
+    
+    double OSCChannel::Now ( )
+    {
+        using namespace std::chrono;
+        return duration<double>( steady_clock::now().time_since_epoch() ).count();
+    }
+    
     OSCChannel::OSCChannel ( const std::string& host, int port, Mode mode )
-    : _ioService( new asio::io_service )
-    , _work( new asio::io_service::work( *_ioService ) )
+    : _service ( Net::Reactor::Get().Service() )
+    , _strand ( _service )
     , _isConnected ( false )
+    , _drainMemory ( std::make_shared<Net::HandlerMemory>() )
     , Endpoint ( host )
     , Port ( port )
     , Direction( mode )
@@ -33,18 +123,17 @@ namespace Time
     {
         try
         {
-            _sender = std::make_unique<Sender>( port + 2, host, port, protocol::v4(), *_ioService );
-            _sender->bind();
-            _isConnected = true;
-            _thread = std::thread( std::bind( []( std::shared_ptr<asio::io_service> &service )
-            {
-                service->run();
-            }, _ioService ));
+            protocol::endpoint destination ( asio::ip::address::from_string ( host ), port );
             
-        } catch ( const osc::Exception &ex )
+            _socket = std::make_unique<protocol::socket>( _service, protocol::endpoint ( protocol::v4(), port + 2 ) );
+            _socket->non_blocking ( true );
+            _destinations.push_back ( destination );
+            _hasPrimary = true;
+            _isConnected = true;
+        } catch ( const std::exception &ex )
         {
             std::cout << "Error opening OSC Channel!\n " << ex.what() << std::endl;;
-            _sender = nullptr;
+            _socket = nullptr;
             _isConnected = false;
         }
     }
@@ -53,7 +142,7 @@ namespace Time
     {
         try
         {
-            _receiver = std::make_unique<Receiver>( port, protocol::v4(), *_ioService );
+            _receiver = std::make_unique<Receiver>( port, protocol::v4(), _service );
             _receiver->bind();
             _receiver->listen( [this] ( asio::error_code error, protocol::endpoint endpoint ) -> bool
             {
@@ -67,12 +156,6 @@ namespace Time
                     return true;
                 }
             } );
-            
-            _thread = std::thread( std::bind( []( std::shared_ptr<asio::io_service> &service )
-            {
-                service->run();
-            }, _ioService ));
-            
         }catch ( const std::exception& ex )
         {
             std::cout << "Error opening OSC Channel!\n " << ex.what() << std::endl;;
@@ -86,8 +169,25 @@ namespace Time
         if ( _receiver )
         {
             std::lock_guard<std::mutex> lock ( _transportLock );
-            _receiver->setListener( "/sync", [syncHandler] ( const osc::Message& message )
+            _receiver->setListener( "/sync", [this, syncHandler] ( const osc::Message& message )
             {
+                // Without a clock peer of our own, whoever sends /sync is the master, so that's who we
+                // ping. Never while we're publishing, or a second master mid election would retarget us.
+                if ( _clockPort > 0 )
+                {
+                    auto address = message.getSenderIpAddress();
+                    _strand.post ( [this, address]
+                    {
+                        if ( _clockPeerAssigned ) return;
+                        {
+                            std::lock_guard<std::mutex> lock ( _clockLock );
+                            if ( _published.Valid ) return;
+                        }
+                        
+                        SetPeer ( address );
+                    } );
+                }
+                
                 float t = message.getArgFloat(0);
                 app::App::get()->dispatchAsync( [syncHandler, t]
                 {
@@ -97,42 +197,598 @@ namespace Time
         }
     }
     
-    void OSCChannel::SendEvent ( const std::string& event )
+    void OSCChannel::Listen ( const std::string& address, std::function<void()> handler )
     {
-        if ( _sender && _isConnected )
+        if ( _receiver )
         {
             std::lock_guard<std::mutex> lock ( _transportLock );
-            osc::Message message { event };
-            _sender->send ( message, [] ( asio::error_code error )
+            _receiver->setListener( address, [handler] ( const osc::Message& message )
             {
-                std::cout << error.message() << " : " << error.category().name() << std::endl;
-            });
+                app::App::get()->dispatchAsync( handler );
+            } );
         }
     }
     
-    void OSCChannel::SendEvent ( const std::string& event, float value )
+    void OSCChannel::SetPeers ( const std::vector<std::string>& hosts )
+    {
+        std::vector<protocol::endpoint> peers;
+        for ( auto& host : hosts )
+        {
+            asio::error_code error;
+            auto address = asio::ip::address::from_string ( host, error );
+            if ( error )
+            {
+                std::cout << "Error opening OSC peer " << host << ":" << Port << "!\n " << error.message() << std::endl;
+                continue;
+            }
+            
+            peers.emplace_back ( address, Port );
+        }
+        
+        // Drain reads the destinations, so they change between drains rather than during one
+        _strand.post ( [this, peers]
+        {
+            if ( !_socket && !peers.empty() )
+            {
+                try
+                {
+                    _socket = std::make_unique<protocol::socket>( _service, protocol::endpoint ( protocol::v4(), 0 ) );
+                    _socket->non_blocking ( true );
+                }catch ( const std::exception& ex )
+                {
+                    std::cout << "Error opening OSC peer socket!\n " << ex.what() << std::endl;
+                    _socket = nullptr;
+                }
+            }
+            
+            _destinations.resize ( _hasPrimary ? 1 : 0 );
+            _destinations.insert ( _destinations.end(), peers.begin(), peers.end() );
+        } );
+    }
+    
+    void OSCChannel::ServeClock ( int port )
+    {
+        try
+        {
+            _clockReceiver = std::make_unique<Receiver>( port, protocol::v4(), _service );
+            _clockReceiver->bind();
+            _clockReceiver->setListener( "/clock/ping", [this] ( const osc::Message& message )
+            {
+                HandlePing ( message );
+            } );
+            _clockReceiver->listen( [] ( asio::error_code error, protocol::endpoint endpoint ) -> bool
+            {
+                if ( error )
+                {
+                    std::cout << "Error Listening for clock pings: " << error.message() << " endpoint: " << endpoint << std::endl;
+                    return false;
+                }
+                return true;
+            } );
+        }catch ( const std::exception& ex )
+        {
+            std::cout << "Error opening clock port " << port << "!\n " << ex.what() << std::endl;
+            _clockReceiver = nullptr;
+        }
+    }
+    
+    void OSCChannel::PublishTime ( float time )
     {
-        if ( _sender && _isConnected )
+        std::lock_guard<std::mutex> lock ( _clockLock );
+        _published.Clock = Now();
+        _published.Time = time;
+        _published.Valid = true;
+    }
+    
+    void OSCChannel::HandlePing ( const osc::Message& message )
+    {
+        double t1 = Now();
+        
+        try
+        {
+            double t0 = message.getArgDouble(0);
+            int replyPort = message.getArgInt32(1);
+            
+            auto address = message.getSenderIpAddress().to_string();
+            auto key = address + ":" + std::to_string ( replyPort );
+            
+            auto& sender = _clockReplies[key];
+            if ( !sender )
+            {
+                sender = std::make_unique<Sender>( 0, address, replyPort, protocol::v4(), _service );
+                sender->bind();
+            }
+            
+            osc::Message pong { "/clock/pong" };
+            pong.append ( t0 );
+            pong.append ( t1 );
+            {
+                std::lock_guard<std::mutex> lock ( _clockLock );
+                pong.append ( _published.Clock );
+                pong.append ( _published.Time );
+                pong.append ( _published.Valid );
+            }
+            pong.append ( Now() );
+            
+            sender->send ( pong );
+        }catch ( const std::exception& ex )
+        {
+            std::cout << "Error answering clock ping: " << ex.what() << std::endl;
+        }
+    }
+    
+    void OSCChannel::SyncClock ( const std::string& host, int port )
+    {
+        if ( !_receiver ) return;
+        
         {
             std::lock_guard<std::mutex> lock ( _transportLock );
-            osc::Message message { event };
-            message.append ( value );
-            _sender->send ( message, [] ( asio::error_code error )
+            _receiver->setListener( "/clock/pong", [this] ( const osc::Message& message )
             {
-                  std::cout << error.message() << " : " << error.category().name() << std::endl;
-            });
+                HandlePong ( message );
+            } );
         }
+        
+        _clockPort = port;
+        _strand.post ( [this, host]
+        {
+            asio::error_code error;
+            auto address = asio::ip::address::from_string ( host, error );
+            if ( !error ) SetPeer ( address );
+            _clockPeerAssigned = !error;
+            
+            _pingTimer = std::make_unique<asio::steady_timer>( _service );
+            SchedulePing ( );
+        } );
     }
     
-    OSCChannel::~OSCChannel ( )
+    void OSCChannel::SetClockPeer ( const std::string& host )
     {
-        if ( _sender )
+        _strand.post ( [this, host]
         {
-            std::lock_guard<std::mutex> lock { _transportLock };
-            _sender->close();
-            _sender = nullptr;
+            if ( host.empty() )
+            {
+                _clockSender = nullptr;
+                _clockHost.clear();
+                _clockPeerAssigned = false;
+                
+                std::lock_guard<std::mutex> lock ( _clockLock );
+                _clockFilter.Reset();
+                _peerReference = TimeReference();
+                return;
+            }
+            
+            asio::error_code error;
+            auto address = asio::ip::address::from_string ( host, error );
+            if ( error ) return;
+            
+            SetPeer ( address );
+            _clockPeerAssigned = true;
+            
+            // Following someone else's clock, so ours is no longer the one to serve
+            std::lock_guard<std::mutex> lock ( _clockLock );
+            _published = TimeReference();
+        } );
+    }
+    
+    void OSCChannel::SetPeer ( const asio::ip::address& address )
+    {
+        auto host = address.to_string();
+        if ( host == _clockHost && _clockSender ) return;
+        
+        try
+        {
+            _clockSender = std::make_unique<Sender>( 0, host, _clockPort, protocol::v4(), _service );
+            _clockSender->bind();
+            _clockHost = host;
+            
+            std::lock_guard<std::mutex> lock ( _clockLock );
+            _clockFilter.Reset();
+            _peerReference = TimeReference();
+        }catch ( const std::exception& ex )
+        {
+            std::cout << "Error opening clock sync to " << host << ":" << _clockPort << "!\n " << ex.what() << std::endl;
+            _clockSender = nullptr;
+        }
+    }
+    
+    void OSCChannel::SchedulePing ( )
+    {
+        bool locked;
+        {
+            std::lock_guard<std::mutex> lock ( _clockLock );
+            locked = _clockFilter.IsLocked();
         }
         
+        _pingTimer->expires_from_now ( std::chrono::milliseconds ( locked ? kSlowPingMs : kFastPingMs ) );
+        _pingTimer->async_wait ( _strand.wrap ( [this] ( asio::error_code error )
+        {
+            if ( error ) return;
+            SendPing ( );
+            SchedulePing ( );
+        } ) );
+    }
+    
+    void OSCChannel::SendPing ( )
+    {
+        if ( !_clockSender ) return;
+        
+        osc::Message ping { "/clock/ping" };
+        ping.append ( Now() );
+        ping.append ( static_cast<int32_t>( Port ) );
+        _clockSender->send ( ping );
+    }
+    
+    void OSCChannel::HandlePong ( const osc::Message& message )
+    {
+        double t3 = Now();
+        
+        try
+        {
+            double t0       = message.getArgDouble(0);
+            double t1       = message.getArgDouble(1);
+            double refClock = message.getArgDouble(2);
+            float  refTime  = message.getArgFloat(3);
+            bool   hasRef   = message.getArgBool(4);
+            double t2       = message.getArgDouble(5);
+            
+            std::lock_guard<std::mutex> lock ( _clockLock );
+            _clockFilter.Add ( ClockSample ( t0, t1, t2, t3 ) );
+            _peerReference.Clock = refClock;
+            _peerReference.Time = refTime;
+            _peerReference.Valid = hasRef;
+        }catch ( const std::exception& ex )
+        {
+            std::cout << "Malformed clock pong: " << ex.what() << std::endl;
+        }
+    }
+    
+    bool OSCChannel::EstimatePeerTime ( float& time ) const
+    {
+        std::lock_guard<std::mutex> lock ( _clockLock );
+        if ( !_peerReference.Valid || !_clockFilter.IsLocked() ) return false;
+        
+        double peerNow = Now() + _clockFilter.Offset();
+        time = _peerReference.Time + static_cast<float>( peerNow - _peerReference.Clock );
+        return true;
+    }
+    
+    SyncStatus OSCChannel::GetSyncStatus ( ) const
+    {
+        std::lock_guard<std::mutex> lock ( _clockLock );
+        
+        SyncStatus status;
+        status.Locked       = _clockFilter.IsLocked();
+        status.Samples      = _clockFilter.Count();
+        status.Offset       = _clockFilter.Offset();
+        status.RoundTrip    = _clockFilter.RoundTrip();
+        status.Jitter       = _clockFilter.Jitter();
+        return status;
+    }
+    
+    OSCChannel::AddressId OSCChannel::Address ( const std::string& address )
+    {
+        auto it = _addressIds.find ( address );
+        if ( it != _addressIds.end() ) return it->second;
+        
+        Writers writers { osc::MessageWriter<> ( address ), osc::MessageWriter<float> ( address ) };
+        
+        // Has to fit a bundle on its own, with its size prefix
+        if ( osc::BundleWriter::HEADER_SIZE + 4 + writers.Value.size() > kDatagramSize || _writers.size() >= kInvalidAddress )
+        {
+            std::cout << "Can't send OSC address " << address << ", too long or too many addresses" << std::endl;
+            return kInvalidAddress;
+        }
+        
+        AddressId id = static_cast<AddressId>( _writers.size() );
+        _writers.push_back ( std::move ( writers ) );
+        _pending.emplace_back ( );
+        _addressIds[address] = id;
+        return id;
+    }
+    
+    void OSCChannel::SendEvent ( const std::string& event )
+    {
+        SendEvent ( Address ( event ) );
+    }
+    
+    void OSCChannel::SendEvent ( const std::string& event, float value )
+    {
+        SendEvent ( Address ( event ), value );
+    }
+    
+    void OSCChannel::SendEvent ( AddressId event )
+    {
+        SendMessage ( event, nullptr );
+    }
+    
+    void OSCChannel::SendEvent ( AddressId event, float value )
+    {
+        SendMessage ( event, &value );
+    }
+    
+    void OSCChannel::Queue ( const std::string& event )
+    {
+        Queue ( Address ( event ) );
+    }
+    
+    void OSCChannel::Queue ( const std::string& address, float value )
+    {
+        Queue ( Address ( address ), value );
+    }
+    
+    void OSCChannel::Queue ( AddressId event )
+    {
+        if ( event >= _writers.size() ) return;
+        
+        _queuedEvents.push_back ( event );
+        _queued++;
+    }
+    
+    void OSCChannel::Queue ( AddressId address, float value )
+    {
+        if ( address >= _pending.size() ) return;
+        
+        auto& p = _pending[address];
+        
+        p.Settled = value == p.Last;
+        p.Last = value;
+        p.Value = value;
+        p.HasValue = !p.HasSent || value != p.Sent;
+        
+        _queued++;
+    }
+    
+    void OSCChannel::SetPolicy ( const std::string& address, const SendPolicy& policy )
+    {
+        AddressId id = Address ( address );
+        if ( id >= _pending.size() ) return;
+        
+        _pending[id].Policy = policy;
+        _pending[id].HasPolicy = true;
+    }
+    
+    SendStats OSCChannel::GetSendStats ( ) const
+    {
+        SendStats stats;
+        stats.Queued    = _queued;
+        stats.Messages  = _messages;
+        stats.Packets   = _packets;
+        stats.Bytes     = _bytes;
+        stats.Dropped   = _dropped;
+        return stats;
+    }
+    
+    void OSCChannel::Flush ( )
+    {
+        double now = Now();
+        
+        Bundle bundle;
+        bundle.Timetag = osc::time::get_current_ntp_time ( std::chrono::milliseconds ( static_cast<int64_t>( BundleLatency * 1000.0f ) ) );
+        std::size_t count = 0;
+        
+        for ( auto e : _queuedEvents )
+        {
+            if ( Append ( bundle, e, nullptr ) ) count++;
+        }
+        _queuedEvents.clear();
+        
+        for ( std::size_t i = 0; i < _pending.size(); i++ )
+        {
+            auto& p = _pending[i];
+            if ( !p.HasValue ) continue;
+            
+            const SendPolicy& rule = p.HasPolicy ? p.Policy : _defaultPolicy;
+            
+            // Small steps are held rather than dropped, so the value it comes to rest on still goes out
+            bool due   = !p.HasSent || now - p.SentAt >= rule.MinInterval;
+            bool moved = !p.HasSent || std::abs ( p.Value - p.Sent ) > rule.Epsilon || p.Settled;
+            if ( !due || !moved ) continue;
+            
+            // Ring is full, try again next flush
+            if ( !Append ( bundle, static_cast<AddressId>( i ), &p.Value ) ) continue;
+            count++;
+            
+            p.Sent = p.Value;
+            p.SentAt = now;
+            p.HasSent = true;
+            p.HasValue = false;
+        }
+        
+        if ( bundle.Slot ) Close ( bundle );
+        _messages += count;
+    }
+    
+    void OSCChannel::SendMessage ( AddressId address, const float * value )
+    {
+        if ( address >= _writers.size() ) return;
+        
+        Datagram * datagram = _ring.Claim();
+        if ( !datagram )
+        {
+            _dropped++;
+            return;
+        }
+        
+        auto& writers = _writers[address];
+        uint8_t * data = datagram->Data.data();
+        datagram->Size = ( value ? writers.Value.write ( data, *value ) : writers.Event.write ( data ) ) - data;
+        
+        Commit ( );
+        _messages++;
+    }
+    
+    bool OSCChannel::Append ( Bundle& bundle, AddressId address, const float * value )
+    {
+        auto& writers = _writers[address];
+        
+        // A second go in a fresh datagram if this one is full. Address() made sure one message always fits.
+        for ( int attempt = 0; attempt < 2; attempt++ )
+        {
+            if ( !bundle.Slot )
+            {
+                bundle.Slot = _ring.Claim();
+                if ( !bundle.Slot )
+                {
+                    _dropped++;
+                    return false;
+                }
+                
+                bundle.Writer = osc::BundleWriter ( bundle.Slot->Data.data(), kDatagramSize, bundle.Timetag );
+            }
+            
+            if ( value ? bundle.Writer.append ( writers.Value, *value ) : bundle.Writer.append ( writers.Event ) ) return true;
+            Close ( bundle );
+        }
+        
+        return false;
+    }
+    
+    void OSCChannel::Close ( Bundle& bundle )
+    {
+        bundle.Slot->Size = bundle.Writer.size();
+        bundle.Slot = nullptr;
+        Commit ( );
+    }
+    
+    void OSCChannel::Commit ( )
+    {
+        _ring.Commit ( );
+        
+        // Pairs with the fence in Drain: either that drain sees this datagram, or we see
+        // it has already cleared the flag and post another. One drain in flight at most.
+        std::atomic_thread_fence ( std::memory_order_seq_cst );
+        if ( !_drainPending.exchange ( true ) )
+        {
+            _strand.post ( Net::WithMemory ( _drainMemory, [this] { Drain ( ); } ) );
+        }
+    }
+    
+    void OSCChannel::Drain ( )
+    {
+        _drainPending = false;
+        std::atomic_thread_fence ( std::memory_order_seq_cst );
+        
+        std::size_t available = _ring.Available();
+        if ( available == 0 ) return;
+        
+        std::size_t destinations = _socket ? _destinations.size() : 0;
+        std::size_t total = available * destinations;
+        uint64_t packets = 0, bytes = 0, dropped = 0;
+        
+#if defined( __linux__ )
+        // Every datagram to every destination, kSendBatch at a time, one syscall per batch
+        std::array<mmsghdr, kSendBatch> messages;
+        std::array<iovec, kSendBatch> vectors;
+        
+        for ( std::size_t i = 0; i < total; )
+        {
+            unsigned count = 0;
+            for ( ; i < total && count < kSendBatch; i++, count++ )
+            {
+                auto& datagram = _ring.At ( i / destinations );
+                auto& destination = _destinations[i % destinations];
+                
+                vectors[count].iov_base = const_cast<uint8_t *>( datagram.Data.data() );
+                vectors[count].iov_len = datagram.Size;
+                
+                auto& header = messages[count].msg_hdr;
+                header = msghdr();
+                header.msg_name = destination.data();
+                header.msg_namelen = static_cast<socklen_t>( destination.size() );
+                header.msg_iov = &vectors[count];
+                header.msg_iovlen = 1;
+            }
+            
+            unsigned offset = 0;
+            while ( offset < count )
+            {
+                int sent = ::sendmmsg ( _socket->native_handle(), messages.data() + offset, count - offset, 0 );
+                if ( sent < 0 )
+                {
+                    // Socket buffer is full, the rest of this batch would fail the same way
+                    if ( errno == EAGAIN || errno == EWOULDBLOCK )
+                    {
+                        dropped += count - offset;
+                        break;
+                    }
+                    
+                    // Skip the datagram that failed and carry on with the others
+                    std::cout << "Error sending OSC: " << std::strerror ( errno ) << std::endl;
+                    dropped++;
+                    offset++;
+                    continue;
+                }
+                
+                for ( int k = 0; k < sent; k++ ) bytes += messages[offset + k].msg_len;
+                packets += sent;
+                offset += sent;
+            }
+        }
+#else
+        for ( std::size_t i = 0; i < total; i++ )
+        {
+            auto& datagram = _ring.At ( i / destinations );
+            
+            asio::error_code error;
+            std::size_t sent = _socket->send_to ( asio::buffer ( datagram.Data.data(), datagram.Size ), _destinations[i % destinations], 0, error );
+            if ( error )
+            {
+                if ( error != asio::error::would_block ) std::cout << "Error sending OSC: " << error.message() << std::endl;
+                dropped++;
+                continue;
+            }
+            
+            packets++;
+            bytes += sent;
+        }
+#endif
+        
+        _ring.Release ( available );
+        
+        _packets += packets;
+        _bytes += bytes;
+        _dropped += dropped;
+    }
+    
+    EncoderTiming OSCChannel::BenchmarkEncoder ( int iterations )
+    {
+        using namespace std::chrono;
+        
+        const std::string address = "/bp/source_volume/FD_Smoke_left_48k";
+        
+        EncoderTiming timing;
+        timing.Iterations = iterations;
+        if ( iterations <= 0 ) return timing;
+        
+        // Sum the sizes so neither loop can be optimised away
+        std::size_t check = 0;
+        
+        auto start = steady_clock::now();
+        for ( int i = 0; i < iterations; i++ )
+        {
+            osc::Message message { address };
+            message.append ( static_cast<float>( i ) );
+            check += message.getPacketSize();
+        }
+        timing.Message = duration<double, std::nano>( steady_clock::now() - start ).count() / iterations;
+        
+        osc::MessageWriter<float> writer ( address );
+        std::array<uint8_t, kDatagramSize> buffer;
+        
+        start = steady_clock::now();
+        for ( int i = 0; i < iterations; i++ )
+        {
+            check += writer.write ( buffer.data(), static_cast<float>( i ) ) - buffer.data() + buffer[i % writer.size()];
+        }
+        timing.Writer = duration<double, std::nano>( steady_clock::now() - start ).count() / iterations;
+        
+        if ( check == 0 ) std::cout << "OSC encoder benchmark wrote nothing" << std::endl;
+        return timing;
+    }
+    
+    OSCChannel::~OSCChannel ( )
+    {
         if ( _receiver )
         {
             std::lock_guard<std::mutex> lock { _transportLock };
@@ -140,9 +796,23 @@ namespace Time
             _receiver = nullptr;
         }
         
-        _work.reset();
-        _ioService->stop();
-        if ( _thread.joinable() ) _thread.join();
+        if ( _clockReceiver ) _clockReceiver->close();
+        
+        _strand.post ( [this]
+        {
+            if ( _pingTimer ) _pingTimer->cancel();
+            _clockSender = nullptr;
+            
+            if ( _socket )
+            {
+                asio::error_code ignored;
+                _socket->close ( ignored );
+                _socket = nullptr;
+            }
+        } );
+        
+        // Nothing of ours may still be running once we return
+        Net::Reactor::Get().Drain ( _strand );
     }
     
 }
@@ -9,6 +9,12 @@
 #define OSCChannel_h
 
 #include "cinder/osc/Osc.h"
+#include <Net/Reactor.h>
+#include <Net/SpscRing.h>
+#include <array>
+#include <atomic>
+#include <map>
+#include <unordered_map>
 
 namespace Time
 {
@@ -20,6 +26,83 @@ namespace Time
     
     using protocol      = asio::ip::udp;
     
+    ///
+    /// Clock Sync
+    ///
+    
+    // One NTP style exchange. t0 / t3 are our send / receive times, t1 / t2 the
+    // peer's receive / send times, all in seconds on each side's steady clock.
+    struct ClockSample
+    {
+        double                                      Offset{0.0};    // Peer clock - local clock
+        double                                      Delay{0.0};     // Round trip minus the peer's turnaround
+        
+        ClockSample                                 ( ) { }
+        ClockSample                                 ( double t0, double t1, double t2, double t3 );
+    };
+    
+    // Keeps the last few samples and trusts the one with the lowest delay, since
+    // that one was least disturbed by queueing on the way there and back.
+    class ClockFilter
+    {
+    public:
+        
+        static const int                            kWindow = 8;
+        
+        void                                        Add       ( const ClockSample& sample );
+        void                                        Reset     ( );
+        
+        inline bool                                 IsLocked  ( ) const { return _count >= 4; }
+        inline int                                  Count     ( ) const { return _count; }
+        
+        double                                      Offset    ( ) const;
+        double                                      RoundTrip ( ) const;
+        double                                      Jitter    ( ) const;
+        
+    protected:
+        
+        std::array<ClockSample, kWindow>            _samples;
+        int                                         _next{0};
+        int                                         _count{0};
+    };
+    
+    struct SyncStatus
+    {
+        bool                                        Locked{false};
+        int                                         Samples{0};
+        double                                      Offset{0.0};
+        double                                      RoundTrip{0.0};
+        double                                      Jitter{0.0};
+    };
+    
+    ///
+    /// Batched sending
+    ///
+    
+    // Per address filter for queued values
+    struct SendPolicy
+    {
+        float                                       Epsilon{0.0f};      // Smaller changes are held until the value settles
+        float                                       MinInterval{0.0f};  // Seconds between sends on one address
+    };
+    
+    struct SendStats
+    {
+        uint64_t                                    Queued{0};          // Values handed to Queue
+        uint64_t                                    Messages{0};        // Messages that went out
+        uint64_t                                    Packets{0};         // Datagrams, per destination
+        uint64_t                                    Bytes{0};
+        uint64_t                                    Dropped{0};         // Send ring was full or the socket would block
+    };
+    
+    // Nanoseconds to encode one single float message each way
+    struct EncoderTiming
+    {
+        double                                      Message{0.0};       // osc::Message, as SenderUdp would
+        double                                      Writer{0.0};        // osc::MessageWriter into a stack buffer
+        int                                         Iterations{0};
+    };
+    
     using OSCChannelRef = std::unique_ptr<class OSCChannel>;
     class OSCChannel
     {
@@ -31,29 +114,171 @@ namespace Time
             Incoming
         };
         
+        using AddressId                             = uint16_t;
+        static const AddressId                      kInvalidAddress = 0xFFFF;
+        
         OSCChannel                                  ( const std::string& host, int port, Mode mode = Mode::Outgoing );
         ~OSCChannel                                 ( );
         
+        // Encodes address once and returns its id. Sending by id only writes the
+        // arguments, the string overloads below look the id up. Main thread only.
+        AddressId                                   Address   ( const std::string& address );
+        
         void                                        SendEvent ( const std::string& event );
         void                                        SendEvent ( const std::string& event, float value );
+        void                                        SendEvent ( AddressId event );
+        void                                        SendEvent ( AddressId event, float value );
         void                                        Listen    ( std::function<void(float)> syncHandler );
+        void                                        Listen    ( const std::string& address, std::function<void()> handler );
+        
+        // Collect this frame's values and send the ones that pass their policy as one
+        // timetagged bundle on Flush. Main thread only.
+        void                                        Queue     ( const std::string& event );
+        void                                        Queue     ( const std::string& address, float value );
+        void                                        Queue     ( AddressId event );
+        void                                        Queue     ( AddressId address, float value );
+        void                                        Flush     ( );
+        
+        void                                        SetPolicy        ( const std::string& address, const SendPolicy& policy );
+        void                                        SetDefaultPolicy ( const SendPolicy& policy ) { _defaultPolicy = policy; }
+        SendStats                                   GetSendStats     ( ) const;
+        
+        // Times both encoders on one of the audio addresses. Blocks for as long as it takes.
+        static EncoderTiming                        BenchmarkEncoder ( int iterations );
+        
+        // Extra destinations that SendEvent fans out to, on the same port.
+        void                                        SetPeers  ( const std::vector<std::string>& hosts );
+        
+        // Master: answer clock pings on port and stamp replies with the latest published time.
+        void                                        ServeClock  ( int port );
+        void                                        PublishTime ( float time );
+        
+        // Slave: ping host:port and estimate its clock. Without a host, or after SetClockPeer ( "" ),
+        // whoever sends us /sync is pinged, unless we're publishing time ourselves.
+        void                                        SyncClock   ( const std::string& host, int port );
+        void                                        SetClockPeer ( const std::string& host );   // Empty to stop pinging
+        
+        // The master's published time extrapolated to now. False until the filter has locked.
+        bool                                        EstimatePeerTime ( float& time ) const;
+        SyncStatus                                  GetSyncStatus    ( ) const;
+        
+        static double                               Now       ( );
         
         std::string                                 Endpoint;
         int                                         Port{9001};
         Mode                                        Direction;
+        float                                       BundleLatency{0.0f};    // Seconds added to bundle timetags
         
     protected:
         
+        ///
+        /// Send ring
+        ///
+        /// The main thread encodes whole datagrams straight into ring slots and the
+        /// strand sends everything committed so far in one go, so the frame loop
+        /// never allocates or waits on a lock to send.
+        ///
+        
+        static const std::size_t                    kDatagramSize   = 1024;
+        static const std::size_t                    kRingSlots      = 128;
+        static const std::size_t                    kSendBatch      = 64;      // Datagrams per sendmmsg call
+        
+        struct Datagram
+        {
+            std::size_t                             Size{0};
+            std::array<uint8_t, kDatagramSize>      Data;
+        };
+        
         void                                        InitSender   ( const std::string& host, int port );
         void                                        InitReceiver ( int port );
         
-        std::shared_ptr<asio::io_service>           _ioService;
-        std::shared_ptr<asio::io_service::work>     _work;
-        std::thread                                 _thread;
+        struct Bundle
+        {
+            Datagram *                              Slot{nullptr};
+            ci::osc::BundleWriter                   Writer;
+            uint64_t                                Timetag{0};
+        };
+        
+        void                                        SendMessage  ( AddressId address, const float * value );
+        bool                                        Append       ( Bundle& bundle, AddressId address, const float * value );
+        void                                        Close        ( Bundle& bundle );
+        void                                        Commit       ( );
+        void                                        Drain        ( );
+        
+        void                                        SendPing     ( );
+        void                                        SchedulePing ( );
+        void                                        HandlePing   ( const ci::osc::Message& message );
+        void                                        HandlePong   ( const ci::osc::Message& message );
+        void                                        SetPeer      ( const asio::ip::address& address );
+        
+        asio::io_service&                           _service;       // Shared, see Net::Reactor
+        Net::Reactor::Strand                        _strand;        // Orders our timer, clock peer and drain handlers
         std::mutex                                  _transportLock;
-        SenderRef                                   _sender;
         ReceiverRef                                 _receiver;
         bool                                        _isConnected{false};
+        
+        // Only touched on _strand once constructed
+        std::unique_ptr<protocol::socket>           _socket;
+        bool                                        _hasPrimary{false};
+        std::vector<protocol::endpoint>             _destinations;  // _primary first, then the peers
+        
+        Net::SpscRing<Datagram, kRingSlots>         _ring;
+        std::atomic<bool>                           _drainPending{false};
+        Net::HandlerMemoryRef                       _drainMemory;
+        
+        struct Pending
+        {
+            float                                   Value{0.0f};
+            float                                   Last{0.0f};         // Last queued, to tell when the value settles
+            float                                   Sent{0.0f};
+            double                                  SentAt{0.0};
+            bool                                    HasValue{false};    // Waiting to go out
+            bool                                    HasSent{false};
+            bool                                    Settled{false};
+            bool                                    HasPolicy{false};
+            SendPolicy                              Policy;
+        };
+        
+        // Main thread only, indexed by AddressId
+        std::unordered_map<std::string, AddressId>  _addressIds;
+        struct Writers
+        {
+            ci::osc::MessageWriter<>                Event;
+            ci::osc::MessageWriter<float>           Value;
+        };
+        
+        std::vector<Writers>                        _writers;
+        std::vector<Pending>                        _pending;
+        std::vector<AddressId>                      _queuedEvents;
+        SendPolicy                                  _defaultPolicy;
+        
+        std::atomic<uint64_t>                       _queued{0};
+        std::atomic<uint64_t>                       _messages{0};
+        std::atomic<uint64_t>                       _packets{0};
+        std::atomic<uint64_t>                       _bytes{0};
+        std::atomic<uint64_t>                       _dropped{0};
+        
+        // A sequencer time and the local clock reading it was taken at
+        struct TimeReference
+        {
+            double                                  Clock{0.0};
+            float                                   Time{0.0f};
+            bool                                    Valid{false};
+        };
+        
+        // Kept apart so a pong that lands after this node became master can't change what it serves
+        mutable std::mutex                          _clockLock;
+        ClockFilter                                 _clockFilter;
+        TimeReference                               _published;     // Ours, stamped on pongs
+        TimeReference                               _peerReference; // The master's, from its pongs
+        
+        ReceiverRef                                 _clockReceiver;
+        std::map<std::string, SenderRef>            _clockReplies;
+        SenderRef                                   _clockSender;
+        std::string                                 _clockHost;
+        bool                                        _clockPeerAssigned{false};  // By SyncClock or SetClockPeer, /sync senders aren't adopted
+        int                                         _clockPort{0};
+        std::unique_ptr<asio::steady_timer>         _pingTimer;
     };
 }
 
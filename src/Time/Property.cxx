@@ -31,45 +31,30 @@ namespace Time
         "EaseInBack", "EaseOutBack", "EaseInOutBack", "EaseOutInBack"
     };
     
-    static std::vector<EaseFn> kEaseFns =
-    {
-        ci::EaseNone{},
-        ci::EaseInQuad{},  ci::EaseOutQuad{}, ci::EaseInOutQuad{}, ci::EaseOutInQuad{},
-        ci::EaseInCubic{}, ci::EaseOutCubic{}, ci::EaseInOutCubic{}, ci::EaseOutInCubic{},
-        ci::EaseInQuad{}, ci::EaseOutQuad{}, ci::EaseInOutQuad{}, ci::EaseOutInQuad{},
-        ci::EaseInQuart{}, ci::EaseOutQuart{}, ci::EaseInOutQuart{}, ci::EaseOutInQuart{},
-        ci::EaseInQuint{}, ci::EaseOutQuint{}, ci::EaseInOutQuint{}, ci::EaseOutInQuint{},
-        ci::EaseInSine{}, ci::EaseOutSine{}, ci::EaseInOutSine{}, ci::EaseOutInSine{},
-        ci::EaseInExpo{}, ci::EaseOutExpo{}, ci::EaseInOutExpo{}, ci::EaseOutInExpo{},
-        ci::EaseInCirc{}, ci::EaseOutCirc{}, ci::EaseInOutCirc{},ci::EaseOutInCirc{},
-        ci::EaseInBounce{}, ci::EaseOutBounce{}, ci::EaseInOutBounce{}, ci::EaseOutInBounce{},
-        ci::EaseInBack{}, ci::EaseOutBack{}, ci::EaseInOutBack{}, ci::EaseOutInBack{},
-    };
-    
-    float ApplyEase ( int easeFnIndex, float percent )
-    {
-        return kEaseFns[easeFnIndex] ( percent );
-    }
-    
     ///
     /// Inspection
     ///
 
+    // Works on a copy of each keyframe and only writes back what a widget changed,
+    // so simply looking at a property leaves its baked samples alone
     template <typename T>
-    void DoInspect ( const std::string& name, PropertyT<T>& property,  const std::function<void(T&)>& work )
+    void DoInspect ( const std::string& name, PropertyT<T>& property,  const std::function<bool(T&)>& work )
     {
         if ( ui::TreeNode ( name.c_str() ) )
         {
+            const PropertyT<T>& view = property;
             int toDelete = -1;
             ui::Indent();
-            for ( int i = 0; i < property.Keyframes().size(); i++ )
+            if ( view.IsOverridden() ) ui::Text ( "Overridden" );
+            if ( view.IsShared() ) ui::Text ( "Shared with the template, editing makes a copy" );
+            for ( int i = 0; i < view.Keyframes().size(); i++ )
             {
                 ui::ScopedId id { i };
-                auto& k = property.Keyframes()[i];
+                auto k = view.Keyframes()[i];
                 auto n = "[" + std::to_string(i) + "]";
                 bool tree = ui::TreeNode( n.c_str() );
                 
-                if ( i > 0 || property.Keyframes().size() > 1 )
+                if ( i > 0 || view.Keyframes().size() > 1 )
                 {
                     if ( ui::BeginPopupContextItem( "POP" ) )
                     {
@@ -83,19 +68,22 @@ namespace Time
                 
                 if ( tree )
                 {
-                    if ( property.Keyframes().size() > 1 )
+                    bool changed = false;
+                    if ( view.Keyframes().size() > 1 )
                     {
-                        ui::Combo( "Ease Curve", &k.EaseFnIndex, kEaseFnNames );
-                        ui::DragFloat( "Time", &k.Time, 0.01f, 0.0f, 1024.0f );
+                        changed |= ui::Combo( "Ease Curve", &k.EaseFnIndex, kEaseFnNames );
+                        changed |= ui::DragFloat( "Time", &k.Time, 0.01f, 0.0f, 1024.0f );
                     }
-                    work ( k.Value );
+                    changed |= work ( k.Value );
+                    if ( changed ) property.MutableKeyframes()[i] = k;
                     ui::TreePop();
                 }
             }
             
             if ( toDelete > -1 )
             {
-                property.Keyframes().erase ( property.Keyframes().begin() + toDelete );
+                auto& keyframes = property.MutableKeyframes();
+                keyframes.erase ( keyframes.begin() + toDelete );
             }
             
             if ( ui::Button ( ( "+" ) ) )
@@ -110,63 +98,63 @@ namespace Time
     
     void Inspect ( ColorProperty& property, const std::string& name, uint32_t flags )
     {
-        DoInspect<Colorf>( name, property, [] ( Colorf& v )
+        DoInspect<Colorf>( name, property, [] ( Colorf& v ) -> bool
         {
-            ui::ColorEdit3( "Value", &v.r );
+            return ui::ColorEdit3( "Value", &v.r );
         } );
     }
     
     void Inspect ( ColorAProperty& property, const std::string& name, uint32_t flags )
     {
-        DoInspect<ColorAf>( name, property, [] ( ColorAf& v )
+        DoInspect<ColorAf>( name, property, [] ( ColorAf& v ) -> bool
         {
-            ui::ColorEdit4( "Value", &v.r );
+            return ui::ColorEdit4( "Value", &v.r );
         } );
     }
     
     void Inspect ( Vec2Property& property, const std::string& name, uint32_t flags )
     {
-        DoInspect<vec2>( name, property, [flags] ( vec2& v )
+        DoInspect<vec2>( name, property, [flags] ( vec2& v ) -> bool
         {
             if ( flags & BetweenZeroAndOne )
             {
-                ui::DragFloat2( "Value", &v.x, 0.01f, 0.0f, 1.0f );
+                return ui::DragFloat2( "Value", &v.x, 0.01f, 0.0f, 1.0f );
             }else
             {
-                ui::DragFloat2( "Value", &v.x, 0.1f );
+                return ui::DragFloat2( "Value", &v.x, 0.1f );
             }
         } );
     }
     
     void Inspect ( Vec3Property& property, const std::string& name, uint32_t flags )
     {
-        DoInspect<vec3>( name, property, [flags] ( vec3& v )
+        DoInspect<vec3>( name, property, [flags] ( vec3& v ) -> bool
         {
             if ( flags & BetweenZeroAndOne )
             {
-                ui::DragFloat3( "Value", &v.x, 0.01f, 0.0f, 1.0f );
+                return ui::DragFloat3( "Value", &v.x, 0.01f, 0.0f, 1.0f );
             }else
             {
-                ui::DragFloat3( "Value", &v.x, 0.1f );
+                return ui::DragFloat3( "Value", &v.x, 0.1f );
             }
         } );
     }
     
     void Inspect ( FloatProperty& property, const std::string& name, uint32_t flags )
     {
-        DoInspect<float>( name, property, [flags] ( float& v )
+        DoInspect<float>( name, property, [flags] ( float& v ) -> bool
         {
             if ( flags & IsAngle )
             {
-                ui::SliderAngle( "Value", &v, 0.1f );
+                return ui::SliderAngle( "Value", &v, 0.1f );
             }else
             {
                 if ( flags & BetweenZeroAndOne )
                 {
-                    ui::DragFloat( "Value", &v, 0.01f, 0.0f, 1.0f );
+                    return ui::DragFloat( "Value", &v, 0.01f, 0.0f, 1.0f );
                 }else
                 {
-                    ui::DragFloat( "Value", &v, 0.1f );
+                    return ui::DragFloat( "Value", &v, 0.1f );
                 }
             }
         } );
@@ -174,9 +162,9 @@ namespace Time
     
     void Inspect ( IntProperty& property, const std::string& name, uint32_t flags )
     {
-        DoInspect<int>( name, property, [] ( int& v )
+        DoInspect<int>( name, property, [] ( int& v ) -> bool
         {
-            ui::DragInt( "Value", &v );
+            return ui::DragInt( "Value", &v );
         } );
     }
     
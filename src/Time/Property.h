@@ -10,11 +10,69 @@
 
 #include "cinder/Utilities.h"
 #include "cinder/Timeline.h"
+#include "cinder/Easing.h"
 #include "cinder/Json.h"
 
+#include <Time/SmallVector.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <vector>
+
 namespace Time
 {
-    float                   ApplyEase ( int easeFnIndex, float percent );
+    // Indices are the "Ease Curve" entries in the inspector, as saved in scenes. 9 to 12 repeat
+    // the quadratics. A switch rather than a table of EaseFns so the common cases inline.
+    inline float            ApplyEase ( int easeFnIndex, float t )
+    {
+        switch ( easeFnIndex )
+        {
+            case 0  : return t;
+            case 1  :
+            case 9  : return ci::easeInQuad ( t );
+            case 2  :
+            case 10 : return ci::easeOutQuad ( t );
+            case 3  :
+            case 11 : return ci::easeInOutQuad ( t );
+            case 4  :
+            case 12 : return ci::easeOutInQuad ( t );
+            case 5  : return ci::easeInCubic ( t );
+            case 6  : return ci::easeOutCubic ( t );
+            case 7  : return ci::easeInOutCubic ( t );
+            case 8  : return ci::easeOutInCubic ( t );
+            case 13 : return ci::easeInQuart ( t );
+            case 14 : return ci::easeOutQuart ( t );
+            case 15 : return ci::easeInOutQuart ( t );
+            case 16 : return ci::easeOutInQuart ( t );
+            case 17 : return ci::easeInQuint ( t );
+            case 18 : return ci::easeOutQuint ( t );
+            case 19 : return ci::easeInOutQuint ( t );
+            case 20 : return ci::easeOutInQuint ( t );
+            case 21 : return ci::easeInSine ( t );
+            case 22 : return ci::easeOutSine ( t );
+            case 23 : return ci::easeInOutSine ( t );
+            case 24 : return ci::easeOutInSine ( t );
+            case 25 : return ci::easeInExpo ( t );
+            case 26 : return ci::easeOutExpo ( t );
+            case 27 : return ci::easeInOutExpo ( t );
+            case 28 : return ci::easeOutInExpo ( t );
+            case 29 : return ci::easeInCirc ( t );
+            case 30 : return ci::easeOutCirc ( t );
+            case 31 : return ci::easeInOutCirc ( t );
+            case 32 : return ci::easeOutInCirc ( t );
+            case 33 : return ci::easeInBounce ( t );
+            case 34 : return ci::easeOutBounce ( t );
+            case 35 : return ci::easeInOutBounce ( t );
+            case 36 : return ci::easeOutInBounce ( t );
+            case 37 : return ci::easeInBack ( t );
+            case 38 : return ci::easeOutBack ( t );
+            case 39 : return ci::easeInOutBack ( t );
+            case 40 : return ci::easeOutInBack ( t );
+            default : return t;
+        }
+    }
     
     template <typename T>
     void                    Marshal   ( const ci::JsonTree& tree, T& resultValue );
@@ -47,10 +105,95 @@ namespace Time
         T                   Value{T{}};
     };
     
+    // A read only run of keyframes, wherever they are kept
+    template <typename T>
+    class KeyframeSpan
+    {
+    public:
+        
+        using const_iterator    = const KeyframeT<T> *;
+        
+        KeyframeSpan        ( const KeyframeT<T> * data, std::size_t size, bool isInline )
+        : _data ( data ), _size ( size ), _inline ( isInline ) { }
+        
+        inline std::size_t          size        ( ) const { return _size; }
+        inline bool                 empty       ( ) const { return _size == 0; }
+        inline const KeyframeT<T> * data        ( ) const { return _data; }
+        
+        inline const KeyframeT<T>&  operator[]  ( std::size_t i ) const { return _data[i]; }
+        inline const KeyframeT<T>&  front       ( ) const { return _data[0]; }
+        inline const KeyframeT<T>&  back        ( ) const { return _data[_size - 1]; }
+        
+        inline const_iterator       begin       ( ) const { return _data; }
+        inline const_iterator       end         ( ) const { return _data + _size; }
+        
+        // Not on the heap, either held inline or mapped from a compiled scene
+        inline bool                 IsInline    ( ) const { return _inline; }
+        
+    protected:
+        
+        const KeyframeT<T> *        _data;
+        std::size_t                 _size;
+        bool                        _inline;
+    };
+    
+    // One property across many elements, their baked samples packed one after another, so every
+    // element is evaluated at t in a pass over flat arrays. Filled by PropertyT::Pack.
+    template <typename T>
+    struct PackedTrack
+    {
+        std::vector<float>      Start;      // The t each lane's first sample falls at
+        std::vector<float>      Scale;      // Samples per second, 0 for a constant
+        std::vector<uint32_t>   First;      // Into Samples
+        std::vector<uint32_t>   Last;
+        std::vector<T>          Samples;
+        
+        void                Clear                 ( )
+        {
+            Start.clear();
+            Scale.clear();
+            First.clear();
+            Last.clear();
+            Samples.clear();
+        }
+        
+        void                AddConstant           ( const T& value )
+        {
+            Add ( 0.0f, 0.0f, &value, 1 );
+        }
+        
+        void                Add                   ( float start, float scale, const T * samples, std::size_t count )
+        {
+            uint32_t first = static_cast<uint32_t>( Samples.size() );
+            Samples.insert ( Samples.end(), samples, samples + count );
+            
+            Start.push_back ( start );
+            Scale.push_back ( scale );
+            First.push_back ( first );
+            Last.push_back ( first + static_cast<uint32_t>( count ) - 1 );
+        }
+        
+        // Lane i at t, as PropertyT::Sample gives it. Clamped rather than branched, NaN lands on the first sample.
+        inline T            At                    ( std::size_t i, float t ) const
+        {
+            float x = std::min ( std::max ( 0.0f, ( t - Start[i] ) * Scale[i] ), static_cast<float>( Last[i] - First[i] ) );
+            uint32_t k = static_cast<uint32_t>( x );
+            uint32_t a = First[i] + k;
+            uint32_t b = std::min ( a + 1, Last[i] );
+            return ci::lerp ( Samples[a], Samples[b], x - k );
+        }
+    };
+    
     template <typename T>
     class PropertyT
     {
     public:
+        
+        // Most properties are a constant or a single ramp, which fit without touching the heap
+        using KeyframeList  = SmallVector<KeyframeT<T>, 2>;
+        using SharedTrack   = std::shared_ptr<const PropertyT<T>>;
+        using Mapping       = std::shared_ptr<const void>;
+        
         PropertyT           ( T value = T() )
         {
             _keyframes.resize(1);
@@ -62,17 +205,61 @@ namespace Time
             for ( auto& f : tree["Frames"] ) _keyframes.emplace_back ( f );
         }
         
-        const std::vector<KeyframeT<T>>& Keyframes ( ) const { return _keyframes; }
-        std::vector<KeyframeT<T>>& Keyframes       ( ) { return _keyframes; }
-       
-        inline const T&     ValueAtFrame          ( std::size_t frame ) const { return _keyframes[frame].Value; }
-        inline T&           ValueAtFrame          ( std::size_t frame ) { return _keyframes[frame].Value; }
+        // Reading never disturbs sharing, mapping or baked samples, whether or not the property is const
+        KeyframeSpan<T>     Keyframes ( ) const
+        {
+            const PropertyT<T>& track = Track();
+            return KeyframeSpan<T> ( track.Frames(), track.FrameCount(), track._mapped || track._keyframes.IsInline() );
+        }
+        
+        inline const T&     ValueAtFrame          ( std::size_t frame ) const { return Track().Frames()[frame].Value; }
+        inline const float& TimeAtFrame           ( std::size_t frame ) const { return Track().Frames()[frame].Time; };
         
-        inline const float& TimeAtFrame           ( std::size_t frame ) const { return _keyframes[frame].Time; };
-        inline float&       TimeAtFrame           ( std::size_t frame ) { return _keyframes[frame].Time; }
+        // For edits only. These drop any baked samples, and a shared or mapped property takes its own
+        // copy of the keyframes first.
+        KeyframeList&       MutableKeyframes      ( ) { Invalidate(); return _keyframes; }
+        inline T&           MutableValueAtFrame   ( std::size_t frame ) { Invalidate(); return _keyframes[frame].Value; }
+        inline float&       MutableTimeAtFrame    ( std::size_t frame ) { Invalidate(); return _keyframes[frame].Time; }
         
+        // Evaluates source's keyframes and baked samples rather than holding its own, until edited.
+        // Each property keeps its own segment cursor, remembered value and override.
+        void                Share                 ( const SharedTrack& source )
+        {
+            Unmap ( );
+            _shared = source;
+            _keyframes.clear();
+            _samples.clear();
+            _memoTime = NAN;
+            _cursor = 0;
+        }
+        
+        inline bool         IsShared              ( ) const { return _shared != nullptr; }
+        
+        // Evaluates count keyframes at frames, which mapping keeps alive, where they lie rather than
+        // copying them, as for a compiled scene. Edits copy them first, as they do a shared track.
+        void                Map                   ( const Mapping& mapping, const KeyframeT<T> * frames, std::size_t count )
+        {
+            _shared.reset();
+            _keyframes.clear();
+            _samples.clear();
+            _mapping = mapping;
+            _mapped = frames;
+            _mappedCount = count;
+            _memoTime = NAN;
+            _cursor = 0;
+            _stale = true;
+            _revision = NextRevision();
+        }
+        
+        inline bool         IsMapped              ( ) const { return _mapped != nullptr; }
+        
+        // The property whose keyframes this one evaluates, itself unless shared
+        inline const PropertyT<T>& Track          ( ) const { return _shared ? _shared->Track() : *this; }
+        
+        // Rewrites every keyframe to value for good. Override holds a value without losing the animation.
         inline void         OverrideValue         ( const T& value )
         {
+            Invalidate();
             for ( auto& f : _keyframes )
             {
                 f.Value = value;
@@ -81,37 +268,177 @@ namespace Time
         
         inline void         Set                   ( std::size_t frame, float time, const T& value )
         {
-            TimeAtFrame  ( frame ) = time;
-            ValueAtFrame ( frame ) = value;
+            MutableTimeAtFrame  ( frame ) = time;
+            MutableValueAtFrame ( frame ) = value;
         }
         
+        // Holds the property at value, blended over the keyframes by weight, until released. The
+        // keyframes are left alone, so the animation comes back afterwards and is what gets saved.
+        inline void         Override              ( const T& value, float weight = 1.0f )
+        {
+            _override.Value             = value;
+            _override.Weight            = std::max ( 0.0f, std::min ( weight, 1.0f ) );
+            _override.ReleaseSeconds    = 0.0f;
+            _override.Active            = true;
+        }
+        
+        // Eases back to the keyframes over seconds of wall clock time, or straight away
+        void                Release               ( float seconds = 0.0f )
+        {
+            if ( !_override.Active ) return;
+            
+            if ( seconds <= 0.0f )
+            {
+                _override.Active = false;
+                return;
+            }
+            
+            _override.Weight            = OverrideWeight ( );
+            _override.ReleaseSeconds    = seconds;
+            _override.ReleasedAt        = OverrideClock::now();
+        }
+        
+        inline bool         IsOverridden          ( ) const { return _override.Active; }
+        
+        // Whether other evaluates the same keyframes, wherever either keeps them
+        bool                SameKeyframes         ( const PropertyT<T>& other ) const
+        {
+            auto a = Keyframes();
+            auto b = other.Keyframes();
+            if ( a.size() != b.size() ) return false;
+            if ( a.data() == b.data() ) return true;
+            
+            for ( std::size_t i = 0; i < a.size(); i++ )
+            {
+                if ( a[i].Time != b[i].Time || a[i].EaseFnIndex != b[i].EaseFnIndex || !( a[i].Value == b[i].Value ) ) return false;
+            }
+            
+            return true;
+        }
+        
+        // Takes other's keyframes and baked samples, as when a scene is reloaded underneath this
+        // property, keeping its override. Anything sharing this sees the new keyframes.
+        void                TakeKeyframes         ( const PropertyT<T>& other )
+        {
+            OverrideSlot held = _override;
+            
+            *this = other;
+            _override = held;
+            _revision = NextRevision();
+            _memoTime = NAN;
+            _cursor = 0;
+        }
+        
+        // Keyframes are expected in time order. Reading the same time twice in a row returns the
+        // remembered value, a baked property interpolates its samples, and otherwise evaluation
+        // remembers the segment it last used, so playback moving forward finds its segment in
+        // constant time and a seek costs a binary search. That makes this unsafe to call on the
+        // same property from two threads at once. Any override is blended in on top.
         T                   ValueAtTime           ( float t ) const
         {
-            if ( _keyframes.size() == 1 ) return ValueAtFrame ( 0 );
+            if ( _override.Active ) return Overridden ( t );
+            return Authored ( t );
+        }
+        
+        // What the keyframes alone give at t
+        T                   Authored              ( float t ) const
+        {
+            const PropertyT<T>& track = Track();
+            if ( t == _memoTime && _memoRevision == track._revision ) return _memoValue;
+            
+            _memoValue      = track._samples.empty() ? track.Evaluate ( t, _cursor ) : track.Sample ( t );
+            _memoTime       = t;
+            _memoRevision   = track._revision;
+            return _memoValue;
+        }
+        
+        // Samples the keyframes about rate times a second from the first to the last, after which
+        // ValueAtTime interpolates between samples instead of easing. Properties that never change
+        // value, or would need more than kMaxSamples, stay on their keyframes. Does nothing unless
+        // the rate has changed or the keyframes have been edited since; a rate of 0 drops the samples.
+        // Shared properties use their source's samples.
+        void                Bake                  ( float rate )
+        {
+            if ( _shared || ( rate == _bakeRate && !_stale ) ) return;
+            
+            _bakeRate = rate;
+            _stale = false;
+            _samples.clear();
+            _memoTime = NAN;
+            _revision = NextRevision();
+            if ( rate <= 0.0f || !IsAnimated() ) return;
             
-            if ( t < _keyframes.front().Time ) return _keyframes.front().Value;
-            if ( t > _keyframes.back().Time ) return _keyframes.back().Value;
+            float start = Frames()[0].Time;
+            float span  = Frames()[FrameCount() - 1].Time - start;
+            if ( !( span > 0.0f ) || span * rate >= kMaxSamples ) return;
             
-            for ( int i = 0; i < _keyframes.size() - 1; i++ )
+            std::size_t intervals = std::max<std::size_t> ( 1, static_cast<std::size_t> ( std::ceil ( span * rate ) ) );
+            _samples.resize ( intervals + 1 );
+            for ( std::size_t i = 0; i <= intervals; i++ )
             {
-                auto& a = _keyframes[i+0];
-                auto& b = _keyframes[i+1];
-                
-                if ( t >= a.Time && t <= b.Time )
-                {
-                    float percent = ci::lmap ( t, a.Time, b.Time, 0.0f, 1.0f );
-                    return ci::lerp ( a.Value, b.Value, ApplyEase ( a.EaseFnIndex, percent ) );
-                }
+                _samples[i] = Evaluate ( i == intervals ? start + span : start + span * i / intervals, _cursor );
             }
             
-            return _keyframes.back().Value;
+            _bakeStart = start;
+            _bakeScale = intervals / span;
+        }
+        
+        // Drops the samples and remembered values, here and in anything sharing this, and the next
+        // Bake resamples
+        inline void         Invalidate            ( )
+        {
+            Detach ( );
+            if ( !_samples.empty() ) _samples.clear();
+            _memoTime = NAN;
+            _stale = true;
+            _revision = NextRevision();
+        }
+        
+        inline bool         IsBaked               ( ) const { return !_samples.empty(); }
+        inline std::size_t  BakedSamples          ( ) const { return _samples.size(); }
+        
+        // Changes whenever the keyframes or samples this evaluates might have, for callers that
+        // keep their own copy of them. No two tracks of a type ever hand out the same revision.
+        inline uint32_t     Revision              ( ) const { return Track()._revision; }
+        
+        // The latest revision handed out to any property of this type
+        static uint32_t     Revisions             ( ) { return _revisions; }
+        
+        // Adds a lane to packed for an element starting at startTime, holding this property's baked
+        // samples, or its value if it never changes. Returns false, adding nothing, if it is animated
+        // without being baked. Overrides aren't packed, they're for the caller to look for.
+        bool                Pack                  ( PackedTrack<T>& packed, float startTime ) const
+        {
+            const PropertyT<T>& track = Track();
+            if ( !track._samples.empty() )
+            {
+                packed.Add ( track._bakeStart - startTime, track._bakeScale, track._samples.data(), track._samples.size() );
+                return true;
+            }
+            
+            if ( track.IsAnimated() ) return false;
+            
+            packed.AddConstant ( track.FrameCount() > 0 ? track.Frames()[0].Value : T{} );
+            return true;
+        }
+        
+        bool                IsAnimated            ( ) const
+        {
+            auto keyframes = Keyframes();
+            for ( auto& f : keyframes )
+            {
+                if ( !( f.Value == keyframes.front().Value ) ) return true;
+            }
+            
+            return false;
         }
         
         void AddKeyFrame ( float t = -1.0f )
         {
+            Invalidate();
             if ( !_keyframes.empty() )
             {
-                auto& o = _keyframes.back();
+                auto o = _keyframes.back();
                 _keyframes.push_back({});
                 _keyframes.back().Value = o.Value;
                 _keyframes.back().Time = t == -1.0f ? o.Time + 2.0f : t;
@@ -124,9 +451,162 @@ namespace Time
         
     protected:
         
-        std::vector<KeyframeT<T>> _keyframes;
+        static const std::size_t kMaxSamples = 1 << 16;
+        
+        static uint32_t     NextRevision          ( ) { return ++_revisions; }
+        static std::atomic<uint32_t> _revisions;    // Properties are baked off the main thread too
+        
+        using OverrideClock = std::chrono::steady_clock;
+        
+        struct OverrideSlot
+        {
+            T                           Value{};
+            float                       Weight{1.0f};
+            float                       ReleaseSeconds{0.0f};   // Easing back over, 0 while held
+            OverrideClock::time_point   ReleasedAt;
+            bool                        Active{false};
+        };
+        
+        // Weight the override has now, eased out over a release
+        float               OverrideWeight        ( ) const
+        {
+            if ( _override.ReleaseSeconds <= 0.0f ) return _override.Weight;
+            
+            float elapsed = std::chrono::duration<float> ( OverrideClock::now() - _override.ReleasedAt ).count();
+            if ( elapsed >= _override.ReleaseSeconds )
+            {
+                _override.Active = false;
+                return 0.0f;
+            }
+            
+            return _override.Weight * ( 1.0f - ci::easeInOutQuad ( elapsed / _override.ReleaseSeconds ) );
+        }
+        
+        T                   Overridden            ( float t ) const
+        {
+            float weight = OverrideWeight ( );
+            if ( weight >= 1.0f ) return _override.Value;
+            if ( weight <= 0.0f ) return Authored ( t );
+            
+            return ci::lerp ( Authored ( t ), _override.Value, weight );
+        }
+        
+        void                Detach                ( )
+        {
+            if ( _mapped )
+            {
+                _keyframes.assign ( _mapped, _mapped + _mappedCount );
+                Unmap ( );
+            }
+            
+            if ( !_shared ) return;
+            
+            auto frames = _shared->Keyframes();
+            _keyframes.assign ( frames.begin(), frames.end() );
+            _shared.reset();
+        }
+        
+        inline void         Unmap                 ( )
+        {
+            _mapping.reset();
+            _mapped = nullptr;
+            _mappedCount = 0;
+        }
+        
+        // This property's own keyframes, mapped or held
+        inline const KeyframeT<T> * Frames        ( ) const { return _mapped ? _mapped : _keyframes.data(); }
+        inline std::size_t  FrameCount            ( ) const { return _mapped ? _mappedCount : _keyframes.size(); }
+        
+        // Straight from the keyframes, with the caller's segment cursor
+        T                   Evaluate              ( float t, std::size_t& cursor ) const
+        {
+            std::size_t count = FrameCount();
+            if ( count == 0 ) return T{};
+            
+            const KeyframeT<T> * k = Frames();
+            if ( count == 1 ) return k[0].Value;
+            
+            if ( t < k[0].Time ) return k[0].Value;
+            if ( t > k[count-1].Time ) return k[count-1].Value;
+            
+            std::size_t i = Segment ( t, cursor );
+            if ( i == count - 1 ) return k[count-1].Value;
+            
+            auto& a = k[i+0];
+            auto& b = k[i+1];
+            
+            float percent = ( t - a.Time ) / ( b.Time - a.Time );
+            return ci::lerp ( a.Value, b.Value, ApplyEase ( a.EaseFnIndex, percent ) );
+        }
+        
+        // From the baked samples, clamped to the ends as the keyframes are
+        T                   Sample                ( float t ) const
+        {
+            float x = ( t - _bakeStart ) * _bakeScale;
+            if ( !( x > 0.0f ) ) return _samples.front();
+            
+            std::size_t i = static_cast<std::size_t> ( x );
+            if ( i >= _samples.size() - 1 ) return _samples.back();
+            
+            return ci::lerp ( _samples[i], _samples[i+1], x - i );
+        }
+        
+        // First keyframe of the segment holding t, with t inside the keyframes' range. Tries the last
+        // segment used and the one after it before searching. Keyframes edited out of order fall back
+        // to a scan for the first segment that holds t, as evaluation always used to, and give the
+        // last keyframe's index if there is none.
+        std::size_t         Segment               ( float t, std::size_t& cursor ) const
+        {
+            const KeyframeT<T> * k = Frames();
+            std::size_t last = FrameCount() - 1;
+            std::size_t i = cursor < last ? cursor : 0;
+            
+            if ( t >= k[i].Time )
+            {
+                if ( t < k[i+1].Time ) return i;
+                if ( i + 2 <= last && t >= k[i+1].Time && t < k[i+2].Time ) return cursor = i + 1;
+            }
+            
+            auto next = std::upper_bound ( k + 1, k + last, t, [] ( float t, const KeyframeT<T>& f ) { return t < f.Time; } );
+            i = ( next - k ) - 1;
+            
+            if ( !( t >= k[i].Time && t <= k[i+1].Time && k[i].Time < k[i+1].Time ) )
+            {
+                for ( i = 0; i < last; i++ )
+                {
+                    if ( t >= k[i].Time && t <= k[i+1].Time && k[i].Time < k[i+1].Time ) break;
+                }
+                
+                if ( i == last ) return last;
+            }
+            
+            return cursor = i;
+        }
+        
+        KeyframeList        _keyframes;
+        SharedTrack         _shared;
+        Mapping             _mapping;
+        const KeyframeT<T> * _mapped{nullptr};     // In _mapping, used in place of _keyframes
+        std::size_t         _mappedCount{0};
+        mutable std::size_t _cursor{0};
+        uint32_t            _revision{NextRevision()};  // New on every edit, bake and remap
+        
+        std::vector<T>      _samples;
+        float               _bakeRate{0.0f};
+        float               _bakeStart{0.0f};
+        float               _bakeScale{0.0f};       // Samples per second
+        bool                _stale{false};
+        
+        mutable float       _memoTime{NAN};
+        mutable T           _memoValue{};
+        mutable uint32_t    _memoRevision{0};
+        
+        mutable OverrideSlot _override;                 // Ends itself once a release has run out
     };
     
+    template <typename T>
+    std::atomic<uint32_t> PropertyT<T>::_revisions;
+    
     using ColorProperty     = PropertyT<ci::Colorf>;
     using ColorAProperty    = PropertyT<ci::ColorAf>;
     using Vec2Property      = PropertyT<ci::vec2>;
@@ -134,15 +614,25 @@ namespace Time
     using FloatProperty     = PropertyT<float>;
     using IntProperty       = PropertyT<int>;
     
+    // Moves whenever any property is created, edited, baked or remapped, so a pass that only
+    // bakes can be skipped while it stays put
+    inline uint32_t         PropertyRevisions ( )
+    {
+        return ColorProperty::Revisions() + ColorAProperty::Revisions() + Vec2Property::Revisions() +
+               Vec3Property::Revisions() + FloatProperty::Revisions() + IntProperty::Revisions();
+    }
+    
     template <typename T>
     PropertyT<T>            InitWithRange ( float t0, const T& v0, float t1, const T& v1 )
     {
         PropertyT<T> result;
-        result.Keyframes()[0].Time  = t0;
-        result.Keyframes()[0].Value = v0;
+        auto& keyframes = result.MutableKeyframes();
+        keyframes.resize(2);
+        keyframes[0].Time  = t0;
+        keyframes[0].Value = v0;
         
-        result.Keyframes()[1].Time  = t1;
-        result.Keyframes()[1].Value = v1;
+        keyframes[1].Time  = t1;
+        keyframes[1].Value = v1;
 
         return result;
     }
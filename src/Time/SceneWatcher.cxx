@@ -0,0 +1,183 @@
+//
+//  SceneWatcher.cxx
+//  Fluid
+//
+
+#include <Time/SceneWatcher.h>
+
+#include <chrono>
+#include <iostream>
+
+#if defined( __linux__ )
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace ci;
+
+namespace Time
+{
+    namespace
+    {
+        // Editors and Dropbox tend to write a file in several goes, so wait for it to settle
+        const float             kQuietPeriod    = 0.5f;
+
+        // How long the thread blocks before checking whether it's been stopped
+        const float             kSlice          = 0.1f;
+
+        // Without inotify the file's write time is checked this often
+        const float             kPollInterval   = 1.0f;
+    }
+
+    SceneWatcher::SceneWatcher ( const fs::path& path, float bakeRate )
+    : _path ( path )
+    , _bakeRate ( bakeRate )
+    , _lastWrite ( )
+    {
+#if defined( __linux__ )
+        // The directory is watched rather than the file, which most editors replace on save
+        _notify = inotify_init1 ( IN_NONBLOCK | IN_CLOEXEC );
+        if ( _notify >= 0 )
+        {
+            _watch = inotify_add_watch ( _notify, _path.parent_path().string().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO );
+            if ( _watch < 0 )
+            {
+                close ( _notify );
+                _notify = -1;
+            }
+        }
+
+        if ( _notify < 0 ) std::cout << "Can't watch " << _path.parent_path() << ", polling it instead" << std::endl;
+#endif
+
+        _thread = std::thread ( [this] { Run(); } );
+    }
+
+    SceneWatcher::~SceneWatcher ( )
+    {
+        _stopping = true;
+        if ( _thread.joinable() ) _thread.join();
+
+#if defined( __linux__ )
+        if ( _notify >= 0 ) close ( _notify );
+#endif
+    }
+
+    Sequencer::SceneRef SceneWatcher::Take ( )
+    {
+        std::lock_guard<std::mutex> lock ( _lock );
+        return std::move ( _ready );
+    }
+
+    void SceneWatcher::Reload ( )
+    {
+        _reload = true;
+    }
+
+    void SceneWatcher::Run ( )
+    {
+        using Clock = std::chrono::steady_clock;
+
+        auto quiet = std::chrono::duration_cast<Clock::duration> ( std::chrono::duration<float> ( kQuietPeriod ) );
+        auto lastChange = Clock::now();
+        bool pending = false;
+
+        while ( !_stopping )
+        {
+            if ( _reload.exchange ( false ) )
+            {
+                pending = false;
+                Parse ( );
+                continue;
+            }
+
+            if ( Wait ( kSlice ) )
+            {
+                pending = true;
+                lastChange = Clock::now();
+            }
+
+            if ( pending && Clock::now() - lastChange >= quiet )
+            {
+                pending = false;
+                Parse ( );
+            }
+        }
+    }
+
+    bool SceneWatcher::Wait ( float seconds )
+    {
+#if defined( __linux__ )
+        if ( _notify >= 0 )
+        {
+            pollfd descriptor { _notify, POLLIN, 0 };
+            if ( poll ( &descriptor, 1, (int)( seconds * 1000.0f ) ) <= 0 ) return false;
+
+            // Anything else written to the same directory is ignored
+            auto compiled = Sequencer::CompiledPath( _path ).filename();
+            bool changed = false;
+            char buffer[4096] __attribute__ (( aligned ( __alignof__ ( inotify_event ) ) ));
+
+            ssize_t length;
+            while ( ( length = read ( _notify, buffer, sizeof ( buffer ) ) ) > 0 )
+            {
+                for ( char * p = buffer; p < buffer + length; )
+                {
+                    auto event = reinterpret_cast<const inotify_event *> ( p );
+                    if ( event->len > 0 && ( _path.filename() == event->name || compiled == event->name ) ) changed = true;
+                    p += sizeof ( inotify_event ) + event->len;
+                }
+            }
+
+            return changed;
+        }
+#endif
+
+        // Polling, checked every kPollInterval but still woken every slice so stopping is quick
+        std::this_thread::sleep_for ( std::chrono::duration<float> ( seconds ) );
+
+        _sincePoll += seconds;
+        if ( _sincePoll < kPollInterval ) return false;
+
+        _sincePoll = 0.0f;
+        return Changed ( );
+    }
+
+    bool SceneWatcher::Changed ( )
+    {
+        try
+        {
+            return fs::exists ( _path ) && fs::last_write_time ( _path ) != _lastWrite;
+        }catch ( const std::exception& )
+        {
+            // Mid save, most likely, try again next time
+            return false;
+        }
+    }
+
+    void SceneWatcher::Parse ( )
+    {
+        try
+        {
+            if ( !fs::exists ( _path ) )
+            {
+                std::cout << "Scene file " << _path << " not found" << std::endl;
+                return;
+            }
+
+            _lastWrite = fs::last_write_time ( _path );
+        }catch ( const std::exception& e )
+        {
+            std::cout << "Error reading " << _path << ": " << e.what() << std::endl;
+            return;
+        }
+
+        // A file that fails to parse leaves the current scene running
+        auto scene = Sequencer::Parse ( _path, _bakeRate );
+        if ( !scene ) return;
+
+        std::lock_guard<std::mutex> lock ( _lock );
+        _ready = scene;
+    }
+}
@@ -0,0 +1,63 @@
+//
+//  SceneWatcher.h
+//  Fluid
+//
+//  Watches the scene file from a background thread and parses it there
+//  whenever it changes, so a reload never costs the render thread more
+//  than swapping in the finished scene.
+//
+
+#ifndef Fluid_SceneWatcher_h
+#define Fluid_SceneWatcher_h
+
+#include <Time/Sequencer.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace Time
+{
+    using SceneWatcherRef = std::unique_ptr<class SceneWatcher>;
+    class SceneWatcher
+    {
+    public:
+
+        // Starts watching straight away and parses the file once up front
+        SceneWatcher                            ( const ci::fs::path& path, float bakeRate = 0.0f );
+        ~SceneWatcher                           ( );
+
+        // The latest scene parsed since the last call, or null. Main thread.
+        Sequencer::SceneRef                     Take        ( );
+
+        // Parses the file again whether or not it has changed
+        void                                    Reload      ( );
+
+        inline const ci::fs::path&              Path        ( ) const { return _path; }
+
+    protected:
+
+        void                                    Run         ( );
+
+        // Blocks for up to seconds, true if the file was written in that time
+        bool                                    Wait        ( float seconds );
+        bool                                    Changed     ( );
+        void                                    Parse       ( );
+
+        ci::fs::path                            _path;
+        float                                   _bakeRate;
+        int                                     _notify{-1};        // inotify descriptor, -1 when polling
+        int                                     _watch{-1};
+        float                                   _sincePoll{0.0f};
+        decltype ( ci::fs::last_write_time( ci::fs::path() ) ) _lastWrite;
+
+        std::atomic<bool>                       _stopping{false};
+        std::atomic<bool>                       _reload{true};
+        std::thread                             _thread;
+
+        std::mutex                              _lock;
+        Sequencer::SceneRef                     _ready;             // Under _lock
+    };
+}
+
+#endif /* Fluid_SceneWatcher_h */
@@ -6,8 +6,14 @@
 //
 
 #include <Time/Sequencer.h>
+#include <Time/CompiledScene.h>
 #include "CinderImGui.h"
 
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+
 using namespace ci;
 
 namespace Time
@@ -23,14 +29,16 @@ namespace Time
         _time = time;
         if ( _time > Duration ) { _time -= Duration; OnLoop(); }
         if ( _time < 0.0f ) { _time += Duration; OnLoop(); }
+        Bake();
         FireEvents();
     }
     
     void Sequencer::StepBy ( float delta )
     {
-        _time += delta;
+        _time += delta * Rate;
         if ( _time > Duration ) { _time -= Duration; OnLoop(); }
         if ( _time < 0.0f ) { _time += Duration; OnLoop(); }
+        Bake();
         FireEvents();
     }
     
@@ -40,13 +48,26 @@ namespace Time
         {
             if ( _time >= e.Time && !e.Fired )
             {
-                if ( _oscChannel ) _oscChannel->SendEvent( e.Name );
+                if ( _oscChannel ) _oscChannel->Queue( e.Name );
                 std::cout << "Firing " << e.Name << std::endl;
                 e.Fired = true;
             }
         }
     }
     
+    // Only properties edited since, or everything when BakeRate changes, get resampled. Most frames
+    // nothing has changed and the elements aren't walked at all.
+    void Sequencer::Bake ( )
+    {
+        if ( BakeRate == _bakedRate && PropertyRevisions() == _bakedRevisions ) return;
+        
+        _bakedSamples = 0;
+        for ( auto& e : _elements ) _bakedSamples += e->Bake ( BakeRate );
+        
+        _bakedRate = BakeRate;
+        _bakedRevisions = PropertyRevisions();
+    }
+    
     void Sequencer::OnLoop ( )
     {
         for ( auto& event : _events ) event.Fired = false;
@@ -56,38 +77,53 @@ namespace Time
     void Sequencer::AddElement ( const ElementRef& element )
     {
         _elements.push_back ( element );
+        Index ( element );
     }
     
-    ElementRef Sequencer::CreateElement ( ElementType type )
+    void Sequencer::Index ( const ElementRef& element )
     {
-        ElementRef result = nullptr;
-        
-        switch ( type )
+        switch ( element->GetType() )
         {
             case ElementType::Emitter :
             {
-                result = std::make_shared<Emitter>();
+                _emitters.push_back ( std::static_pointer_cast<Emitter>( element ) );
                 break;
             }
                 
             case ElementType::Attractor :
             {
-                result = std::make_shared<Attractor>();
+                _attractors.push_back ( std::static_pointer_cast<Attractor>( element ) );
                 break;
             }
                 
             case ElementType::Obstacle :
             {
-                result = std::make_shared<Obstacle>();
+                _obstacles.push_back ( std::static_pointer_cast<Obstacle>( element ) );
                 break;
             }
         }
-        
+    }
+    
+    ElementRef Sequencer::CreateElement ( ElementType type )
+    {
+        ElementRef result = MakeElement ( type );
         if ( result ) AddElement( result );
         
         return result;
     }
     
+    ElementRef Sequencer::CreateInstance ( const ElementRef& source )
+    {
+        ElementRef result = CreateElement ( source->GetType() );
+        if ( result )
+        {
+            result->Instance ( source );
+            result->Name() = source->Name() + " Instance";
+        }
+        
+        return result;
+    }
+    
     ElementRef Sequencer::FindElement ( const std::string& name )
     {
         for ( auto& e : GetElements() )
@@ -112,39 +148,264 @@ namespace Time
         Obstacle::Init ( );
     }
     
-    bool Sequencer::Load ( const fs::path& path )
+    static const char * kCompiledExtension = ".fluidscene";
+    
+    fs::path Sequencer::CompiledPath ( const fs::path& path )
+    {
+        fs::path result = path;
+        return result.replace_extension( kCompiledExtension );
+    }
+    
+    Sequencer::SceneRef Sequencer::Parse ( const fs::path& path, float bakeRate )
+    {
+        SceneRef scene;
+        
+        auto compiled = CompiledPath ( path );
+        bool isCompiled = path.extension() == kCompiledExtension;
+        
+        try
+        {
+            if ( isCompiled || ( fs::exists( compiled ) && ( !fs::exists( path ) || fs::last_write_time( compiled ) >= fs::last_write_time( path ) ) ) )
+            {
+                scene = ParseCompiled ( compiled );
+            }
+        }catch ( const std::exception& e )
+        {
+            std::cout << "Error loading compiled scene: " << e.what() << std::endl;
+            if ( isCompiled ) return nullptr;
+        }
+        
+        if ( !scene ) scene = ParseJson ( path );
+        if ( scene )
+        {
+            for ( auto& e : scene->Elements ) e->Bake ( bakeRate );
+        }
+        
+        return scene;
+    }
+    
+    // Element records are in scene order, with instances after their templates' first pass as for JSON
+    Sequencer::SceneRef Sequencer::ParseCompiled ( const fs::path& path )
+    {
+        SceneReader reader ( path );
+        
+        auto scene = std::make_shared<Scene>();
+        scene->Duration = reader.Header().Duration;
+        
+        auto settings = reader.String( reader.Header().Settings );
+        if ( !settings.empty() ) scene->Tree = JsonTree ( settings );
+        
+        auto& elements = scene->Elements;
+        elements.resize ( reader.Elements() );
+        
+        for ( std::size_t i = 0; i < reader.Elements(); i++ )
+        {
+            reader.Seek ( i );
+            if ( reader.Element().Template < 0 ) elements[i] = MakeElement ( reader );
+        }
+        
+        for ( std::size_t i = 0; i < reader.Elements(); i++ )
+        {
+            reader.Seek ( i );
+            
+            int32_t source = reader.Element().Template;
+            if ( source < 0 ) continue;
+            if ( source >= (int32_t)elements.size() || !elements[source] ) throw std::runtime_error ( "instance of a missing element" );
+            
+            elements[i] = MakeElement ( reader, elements[source] );
+        }
+        
+        for ( std::size_t i = 0; i < reader.Events(); i++ )
+        {
+            Event event;
+            event.Time = reader.Event( i ).Time;
+            event.Name = reader.String( reader.Event( i ).Name );
+            scene->Events.push_back ( event );
+        }
+        
+        return scene;
+    }
+    
+    Sequencer::SceneRef Sequencer::ParseJson ( const fs::path& path )
     {
         try
         {
-            JsonTree tree { loadFile( path ) };
+            auto scene = std::make_shared<Scene>();
+            scene->Tree = JsonTree { loadFile( path ) };
+            auto& tree = scene->Tree;
             
-            float duration = tree["Duration"].getValue<float>();;
-            std::vector<ElementRef> elements;
+            scene->Duration = tree["Duration"].getValue<float>();
+            auto& elements = scene->Elements;
             
+            // Instances are made on a second pass, once the elements they name exist, keeping their place
             for ( auto& e : tree["Elements" ] )
             {
-                auto elem = MakeElement ( e );
-                if ( elem ) elements.push_back( elem );
+                elements.push_back( e.hasChild( "Instance" ) ? nullptr : MakeElement ( e ) );
             }
             
-            std::vector<Event> events;
-            for ( auto& e : tree["Events"] )
+            std::size_t index = 0;
+            for ( auto& e : tree["Elements" ] )
             {
-                events.emplace_back( e );
+                if ( e.hasChild( "Instance" ) )
+                {
+                    auto name = e["Instance"].getValue();
+                    auto source = std::find_if ( elements.begin(), elements.end(), [&name] ( const ElementRef& s ) { return s && !s->IsInstance() && s->Name() == name; } );
+                    
+                    if ( source == elements.end() ) throw std::runtime_error ( "instance of a missing element " + name );
+                    elements[index] = MakeElement ( e, *source );
+                }
+                
+                index++;
             }
             
-            _elements = elements;
-            _events = events;
-            Duration = duration;
+            for ( auto& e : tree["Events"] )
+            {
+                scene->Events.emplace_back( e );
+            }
             
-            return true;
+            return scene;
         }catch ( const std::exception& e )
         {
             std::cout << "Error loading sequencer: " << e.what() << std::endl;
-            return false;
+            return nullptr;
         }
     }
     
+    SceneChanges Sequencer::Apply ( const SceneRef& scene )
+    {
+        SceneChanges changes;
+        auto& incoming = scene->Elements;
+        
+        // Pair each incoming element with a live one of the same type: same name and id, then the
+        // same name, then the same id, which catches a rename
+        std::unordered_map<std::string, std::size_t> names;
+        std::unordered_map<int, std::size_t> ids;
+        for ( std::size_t j = 0; j < _elements.size(); j++ )
+        {
+            names.emplace ( _elements[j]->Name(), j );
+            ids.emplace ( _elements[j]->ID(), j );
+        }
+        
+        std::vector<ElementRef> match ( incoming.size() );
+        std::vector<bool> taken ( _elements.size(), false );
+        
+        auto pair = [&] ( auto find )
+        {
+            for ( std::size_t i = 0; i < incoming.size(); i++ )
+            {
+                if ( match[i] ) continue;
+                
+                std::size_t j = find ( *incoming[i] );
+                if ( j == _elements.size() || taken[j] || _elements[j]->GetType() != incoming[i]->GetType() ) continue;
+                
+                match[i] = _elements[j];
+                taken[j] = true;
+            }
+        };
+        
+        auto byName = [&] ( const Element& e ) { auto it = names.find ( e.Name() ); return it != names.end() ? it->second : _elements.size(); };
+        auto byID = [&] ( const Element& e ) { auto it = ids.find ( e.ID() ); return it != ids.end() ? it->second : _elements.size(); };
+        
+        pair ( [&] ( const Element& e ) { std::size_t j = byName ( e ); return j < _elements.size() && _elements[j]->ID() == e.ID() ? j : _elements.size(); } );
+        pair ( byName );
+        pair ( byID );
+        
+        std::unordered_map<const Element *, std::size_t> indices;
+        for ( std::size_t i = 0; i < incoming.size(); i++ ) indices.emplace ( incoming[i].get(), i );
+        
+        // Templates first, so instances can be pointed at the live template
+        std::vector<ElementRef> elements ( incoming.size() );
+        for ( int pass = 0; pass < 2; pass++ )
+        {
+            for ( std::size_t i = 0; i < incoming.size(); i++ )
+            {
+                auto& e = incoming[i];
+                if ( e->IsInstance() != ( pass == 1 ) ) continue;
+                
+                auto index = e->IsInstance() ? indices.find ( e->Template().get() ) : indices.end();
+                ElementRef source = index != indices.end() ? elements[index->second] : nullptr;
+                
+                if ( match[i] )
+                {
+                    auto name = match[i]->Name();
+                    if ( match[i]->Patch ( *e, source ) )
+                    {
+                        changes.Changed.push_back ( e->Name() );
+                        if ( name != e->Name() ) changes.Renamed.push_back ( e->Name() );
+                    }else
+                    {
+                        changes.Unchanged++;
+                    }
+                    
+                    elements[i] = match[i];
+                }else
+                {
+                    // An incoming instance shares its tracks with an incoming template, so it's rebuilt on the live one
+                    if ( source )
+                    {
+                        elements[i] = MakeElement ( e->GetType() );
+                        elements[i]->Patch ( *e, source );
+                    }else
+                    {
+                        elements[i] = e;
+                    }
+                    
+                    changes.Added.push_back ( e->Name() );
+                }
+            }
+        }
+        
+        for ( std::size_t j = 0; j < _elements.size(); j++ )
+        {
+            if ( !taken[j] ) changes.Removed.push_back ( _elements[j]->Name() );
+        }
+        
+        // The per type arrays only change with the membership or order
+        if ( elements != _elements )
+        {
+            _elements.swap ( elements );
+            
+            _emitters.clear();
+            _attractors.clear();
+            _obstacles.clear();
+            for ( auto& e : _elements ) Index ( e );
+        }
+        
+        auto sameEvent = [] ( const Event& a, const Event& b ) { return a.Time == b.Time && a.Name == b.Name; };
+        if ( scene->Events.size() != _events.size() || !std::equal ( _events.begin(), _events.end(), scene->Events.begin(), sameEvent ) )
+        {
+            // Events that were already there keep whether they've fired this loop
+            for ( auto& e : scene->Events )
+            {
+                auto old = std::find_if ( _events.begin(), _events.end(), [&] ( const Event& o ) { return sameEvent ( o, e ); } );
+                if ( old != _events.end() ) e.Fired = old->Fired;
+            }
+            
+            _events.swap ( scene->Events );
+            changes.Timeline = true;
+        }
+        
+        if ( Duration != scene->Duration )
+        {
+            Duration = scene->Duration;
+            changes.Timeline = true;
+        }
+        
+        // A new set of elements, count their samples even if nothing needs baking
+        _bakedRate = -1.0f;
+        Bake();
+        return changes;
+    }
+    
+    bool Sequencer::Load ( const fs::path& path )
+    {
+        auto scene = Parse ( path, BakeRate );
+        if ( !scene ) return false;
+        
+        Apply ( scene );
+        return true;
+    }
+    
     bool Sequencer::Save ( const fs::path& path )
     {
         if ( path.empty() ) return false;
@@ -163,45 +424,49 @@ namespace Time
         tree.pushBack( elements );
         tree.write ( path );
         
+        // Nodes map this rather than parse the JSON
+        if ( path.extension() != kCompiledExtension ) Compile ( path );
+        
         return true;
     }
     
-    template <typename T>
-    std::vector<std::shared_ptr<T>> Collect ( const std::vector<ElementRef>& elements, ElementType type )
+    bool Sequencer::Compile ( const fs::path& path )
     {
-        std::vector<std::shared_ptr<T>> result;
-        for ( auto& e : elements )
+        auto scene = ParseJson ( path );
+        if ( !scene ) return false;
+        
+        SceneWriter writer ( scene->Elements );
+        for ( auto& e : scene->Elements ) writer.Add ( e );
+        for ( auto& e : scene->Events ) writer.AddEvent ( e.Time, e.Name );
+        
+        // Anything else in the file, such as the layer alphas, goes along as JSON
+        JsonTree settings = JsonTree::makeObject();
+        for ( auto& child : scene->Tree )
         {
-            if ( e->GetType() == type ) result.push_back ( std::static_pointer_cast<T>( e ) );
+            auto& key = child.getKey();
+            if ( key != "Duration" && key != "Elements" && key != "Events" ) settings.pushBack ( child );
         }
         
-        return result;
-    }
-    
-    std::vector<EmitterRef> Sequencer::GetEmitters ( ) const
-    {
-        return Collect<Emitter> ( _elements, ElementType::Emitter );
-    }
-    
-    std::vector<AttractorRef> Sequencer::GetAttractors ( ) const
-    {
-        return Collect<Attractor> ( _elements, ElementType::Attractor );
-    }
-    
-    std::vector<ObstacleRef> Sequencer::GetObstacles ( ) const
-    {
-        return Collect<Obstacle> ( _elements, ElementType::Obstacle );
+        return writer.Write ( CompiledPath ( path ), scene->Duration, settings.hasChildren() ? settings.serialize() : "" );
     }
     
     void Sequencer::Inspect ( )
     {
         ui::ScopedId id { "Sequencer" };
         ui::Text ( "Time: %.2f", _time );
+        ui::DragFloat ( "Bake Rate", &BakeRate, 1.0f, 0.0f, 240.0f );
+        if ( BakeRate > 0.0f ) ui::Text ( "Baked Samples: %d", (int)_bakedSamples );
         for ( auto& e : _elements )
         {
             e->Inspect ( );
         }
         
+        if ( _queuedInstance )
+        {
+            CreateInstance ( _queuedInstance );
+            _queuedInstance = nullptr;
+        }
+        
         if ( ui::Button ( "+ Emitter" ) ) CreateElement( ElementType::Emitter );
         ui::SameLine();
         
@@ -222,4 +487,240 @@ namespace Time
             Load ( app::getOpenFilePath() );
         }
     }
+    
+    ///
+    /// Benchmark
+    ///
+    
+    namespace
+    {
+        // Evaluation as it was before PropertyT cached its segment, kept to measure against
+        const std::vector<EaseFn>& ReferenceEaseFns ( )
+        {
+            static std::vector<EaseFn> kEaseFns =
+            {
+                ci::EaseNone{},
+                ci::EaseInQuad{},  ci::EaseOutQuad{}, ci::EaseInOutQuad{}, ci::EaseOutInQuad{},
+                ci::EaseInCubic{}, ci::EaseOutCubic{}, ci::EaseInOutCubic{}, ci::EaseOutInCubic{},
+                ci::EaseInQuad{}, ci::EaseOutQuad{}, ci::EaseInOutQuad{}, ci::EaseOutInQuad{},
+                ci::EaseInQuart{}, ci::EaseOutQuart{}, ci::EaseInOutQuart{}, ci::EaseOutInQuart{},
+                ci::EaseInQuint{}, ci::EaseOutQuint{}, ci::EaseInOutQuint{}, ci::EaseOutInQuint{},
+                ci::EaseInSine{}, ci::EaseOutSine{}, ci::EaseInOutSine{}, ci::EaseOutInSine{},
+                ci::EaseInExpo{}, ci::EaseOutExpo{}, ci::EaseInOutExpo{}, ci::EaseOutInExpo{},
+                ci::EaseInCirc{}, ci::EaseOutCirc{}, ci::EaseInOutCirc{},ci::EaseOutInCirc{},
+                ci::EaseInBounce{}, ci::EaseOutBounce{}, ci::EaseInOutBounce{}, ci::EaseOutInBounce{},
+                ci::EaseInBack{}, ci::EaseOutBack{}, ci::EaseInOutBack{}, ci::EaseOutInBack{},
+            };
+            
+            return kEaseFns;
+        }
+        
+        template <typename T>
+        T ReferenceValueAtTime ( const PropertyT<T>& property, float t )
+        {
+            auto keyframes = property.Keyframes();
+            if ( keyframes.size() == 1 ) return keyframes[0].Value;
+            
+            if ( t < keyframes.front().Time ) return keyframes.front().Value;
+            if ( t > keyframes.back().Time ) return keyframes.back().Value;
+            
+            for ( int i = 0; i < keyframes.size() - 1; i++ )
+            {
+                auto& a = keyframes[i+0];
+                auto& b = keyframes[i+1];
+                
+                if ( t >= a.Time && t <= b.Time )
+                {
+                    float percent = ci::lmap ( t, a.Time, b.Time, 0.0f, 1.0f );
+                    return ci::lerp ( a.Value, b.Value, ReferenceEaseFns()[a.EaseFnIndex] ( percent ) );
+                }
+            }
+            
+            return keyframes.back().Value;
+        }
+        
+        struct PropertySet
+        {
+            std::vector<const FloatProperty *>  Floats;
+            std::vector<const Vec2Property *>   Vec2s;
+            std::vector<const ColorProperty *>  Colors;
+        };
+        
+        void Gather ( const ElementRef& element, PropertySet& set )
+        {
+            set.Vec2s.push_back ( &element->Position() );
+            set.Floats.push_back ( &element->Radius() );
+            
+            switch ( element->GetType() )
+            {
+                case ElementType::Emitter :
+                {
+                    auto e = std::static_pointer_cast<const Emitter>( element );
+                    set.Vec2s.push_back ( &e->Velocity() );
+                    set.Colors.push_back ( &e->Color() );
+                    set.Floats.push_back ( &e->Temperature() );
+                    set.Floats.push_back ( &e->Density() );
+                    break;
+                }
+                    
+                case ElementType::Attractor :
+                {
+                    set.Floats.push_back ( &std::static_pointer_cast<const Attractor>( element )->Force() );
+                    break;
+                }
+                    
+                case ElementType::Obstacle :
+                {
+                    set.Floats.push_back ( &std::static_pointer_cast<const Obstacle>( element )->Rotation() );
+                    break;
+                }
+            }
+        }
+        
+        inline float Sum ( float v ) { return v; }
+        inline float Sum ( const vec2& v ) { return v.x + v.y; }
+        inline float Sum ( const Colorf& v ) { return v.r + v.g + v.b; }
+        
+        inline float Difference ( float a, float b ) { return std::abs ( a - b ); }
+        inline float Difference ( const vec2& a, const vec2& b ) { return std::max ( std::abs ( a.x - b.x ), std::abs ( a.y - b.y ) ); }
+        inline float Difference ( const Colorf& a, const Colorf& b ) { return std::max ( { std::abs ( a.r - b.r ), std::abs ( a.g - b.g ), std::abs ( a.b - b.b ) } ); }
+        
+        // Seconds to evaluate every property at every time. Times are the outer loop, as in a frame.
+        template <typename T, typename Evaluate>
+        double Measure ( const std::vector<const PropertyT<T> *>& properties, const std::vector<float>& times, Evaluate evaluate, float& sink )
+        {
+            auto start = std::chrono::steady_clock::now();
+            for ( float t : times )
+            {
+                for ( auto p : properties ) sink += Sum ( evaluate ( *p, t ) );
+            }
+            
+            return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        }
+        
+        template <typename T>
+        float MaxError ( const std::vector<const PropertyT<T> *>& properties, const std::vector<float>& times )
+        {
+            float error = 0.0f;
+            for ( float t : times )
+            {
+                for ( auto p : properties ) error = std::max ( error, Difference ( p->ValueAtTime ( t ), ReferenceValueAtTime ( *p, t ) ) );
+            }
+            
+            return error;
+        }
+        
+        // Copies with their own keyframes and nothing remembered from earlier reads, baked at rate if
+        // it's over 0, so no measurement reuses the samples, segment or value another one left behind
+        template <typename T>
+        std::vector<PropertyT<T>> Fresh ( const std::vector<const PropertyT<T> *>& properties, float rate )
+        {
+            std::vector<PropertyT<T>> copies ( properties.size() );
+            for ( std::size_t i = 0; i < properties.size(); i++ )
+            {
+                copies[i].TakeKeyframes ( *properties[i] );
+                copies[i].Invalidate();
+                copies[i].Bake ( rate );
+            }
+            
+            return copies;
+        }
+        
+        template <typename T>
+        std::vector<const PropertyT<T> *> Pointers ( const std::vector<PropertyT<T>>& copies )
+        {
+            std::vector<const PropertyT<T> *> pointers;
+            for ( auto& p : copies ) pointers.push_back ( &p );
+            return pointers;
+        }
+        
+        struct Pass
+        {
+            double                              Reference{0.0};
+            double                              Playback{0.0};
+            double                              Seek{0.0};
+            float                               MaxError{0.0f};
+        };
+        
+        // Seconds for each way of reading properties, each from its own fresh copies
+        template <typename T>
+        void Run ( const std::vector<const PropertyT<T> *>& properties, float rate, const std::vector<float>& playback, const std::vector<float>& seeks, Pass& pass, float& sink )
+        {
+            auto current = [] ( const PropertyT<T>& p, float t ) { return p.ValueAtTime ( t ); };
+            auto reference = [] ( const PropertyT<T>& p, float t ) { return ReferenceValueAtTime ( p, t ); };
+            
+            if ( rate <= 0.0f )
+            {
+                auto copies = Fresh ( properties, rate );
+                pass.Reference += Measure ( Pointers ( copies ), playback, reference, sink );
+            }
+            
+            auto copies = Fresh ( properties, rate );
+            pass.Playback += Measure ( Pointers ( copies ), playback, current, sink );
+            
+            copies = Fresh ( properties, rate );
+            pass.Seek += Measure ( Pointers ( copies ), seeks, current, sink );
+            
+            copies = Fresh ( properties, rate );
+            pass.MaxError = std::max ( pass.MaxError, MaxError ( Pointers ( copies ), seeks ) );
+        }
+    }
+    
+    PropertyTiming Sequencer::BenchmarkProperties ( int loops ) const
+    {
+        PropertyTiming timing;
+        
+        PropertySet set;
+        for ( auto& e : _elements ) Gather ( e, set );
+        
+        auto countInline = [&timing] ( auto& properties )
+        {
+            for ( auto p : properties ) timing.Inline += p->Keyframes().IsInline() ? 1 : 0;
+        };
+        
+        countInline ( set.Floats );
+        countInline ( set.Vec2s );
+        countInline ( set.Colors );
+        
+        timing.Properties = static_cast<int>( set.Floats.size() + set.Vec2s.size() + set.Colors.size() );
+        if ( timing.Properties == 0 || Duration <= 0.0f ) return timing;
+        
+        std::vector<float> playback;
+        for ( int l = 0; l < std::max ( loops, 1 ); l++ )
+        {
+            for ( float t = 0.0f; t < Duration; t += 1.0f / 60.0f ) playback.push_back ( t );
+        }
+        
+        std::vector<float> seeks = playback;
+        std::shuffle ( seeks.begin(), seeks.end(), std::mt19937 ( 5 ) );
+        
+        float sink = 0.0f;
+        Pass keyframes, baked;
+        
+        Run ( set.Floats, 0.0f, playback, seeks, keyframes, sink );
+        Run ( set.Vec2s, 0.0f, playback, seeks, keyframes, sink );
+        Run ( set.Colors, 0.0f, playback, seeks, keyframes, sink );
+        
+        if ( BakeRate > 0.0f )
+        {
+            Run ( set.Floats, BakeRate, playback, seeks, baked, sink );
+            Run ( set.Vec2s, BakeRate, playback, seeks, baked, sink );
+            Run ( set.Colors, BakeRate, playback, seeks, baked, sink );
+        }
+        
+        if ( sink == 0.0f ) std::cout << "Property benchmark read nothing" << std::endl;
+        
+        timing.Evaluations = static_cast<int>( playback.size() ) * timing.Properties;
+        timing.Reference = keyframes.Reference * 1e9 / timing.Evaluations;
+        timing.Playback = keyframes.Playback * 1e9 / timing.Evaluations;
+        timing.Seek = keyframes.Seek * 1e9 / timing.Evaluations;
+        timing.MaxError = keyframes.MaxError;
+        
+        timing.BakeRate = std::max ( BakeRate, 0.0f );
+        timing.BakedPlayback = baked.Playback * 1e9 / timing.Evaluations;
+        timing.BakedSeek = baked.Seek * 1e9 / timing.Evaluations;
+        timing.BakedError = baked.MaxError;
+        
+        return timing;
+    }
 }
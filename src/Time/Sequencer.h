@@ -13,6 +13,36 @@
 
 namespace Time
 {
+    struct PropertyTiming
+    {
+        int                                 Properties{0};
+        int                                 Inline{0};          // Keyframes stored without a heap allocation
+        int                                 Evaluations{0};     // Per measurement
+        double                              Reference{0.0};     // Nanoseconds per evaluation, linear scan and EaseFn table
+        double                              Playback{0.0};      // Nanoseconds per evaluation from the keyframes, time moving forward a frame at a time
+        double                              Seek{0.0};          // Nanoseconds per evaluation from the keyframes, random times
+        float                               MaxError{0.0f};     // Largest difference from the reference, any component
+        
+        // The same, baked at the sequencer's BakeRate. All 0 when it doesn't bake.
+        float                               BakeRate{0.0f};
+        double                              BakedPlayback{0.0};
+        double                              BakedSeek{0.0};
+        float                               BakedError{0.0f};
+    };
+    
+    // What a reload changed, by element name
+    struct SceneChanges
+    {
+        std::vector<std::string>            Added;
+        std::vector<std::string>            Removed;
+        std::vector<std::string>            Changed;            // Patched in place
+        std::vector<std::string>            Renamed;            // New names, also in Changed
+        int                                 Unchanged{0};
+        bool                                Timeline{false};    // The duration or events changed
+        
+        inline bool                         Empty           ( ) const { return Added.empty() && Removed.empty() && Changed.empty() && !Timeline; }
+    };
+    
     class Sequencer : public ci::Noncopyable
     {
     public:
@@ -24,29 +54,69 @@ namespace Time
         
         inline float                        Time            ( ) const { return _time; }
         
+        struct                              Scene;
+        using SceneRef                      = std::shared_ptr<Scene>;
+        
+        // Reads a scene file and builds its elements, baked at bakeRate, without touching the
+        // current scene, so it is safe on any thread. Null if the file can't be read. A compiled
+        // scene beside the JSON, and at least as new, is mapped instead.
+        static SceneRef                     Parse           ( const ci::fs::path& path, float bakeRate = 0.0f );
+        
+        // Writes the JSON scene at path to CompiledPath ( path ), see CompiledScene.h
+        static bool                         Compile         ( const ci::fs::path& path );
+        static ci::fs::path                 CompiledPath    ( const ci::fs::path& path );
+        
+        // Makes scene current by patching the live scene to match it. Elements are paired by name
+        // and id, and a pair keeps the live element, with its overrides, replacing only the tracks
+        // that differ. Unpaired elements are added or removed. Main thread.
+        SceneChanges                        Apply           ( const SceneRef& scene );
+        
         bool                                Load            ( const ci::fs::path& path );
         bool                                Save            ( const ci::fs::path& path );
         
-        std::vector<EmitterRef>             GetEmitters     ( ) const;
-        std::vector<AttractorRef>           GetAttractors   ( ) const;
-        std::vector<ObstacleRef>            GetObstacles    ( ) const;
+        // Each type is kept in its own array, in scene order, so these are free to call every frame.
+        // Only valid until the next AddElement, CreateElement, or Load or Apply that adds or removes elements.
+        const std::vector<EmitterRef>&      GetEmitters     ( ) const { return _emitters; }
+        const std::vector<AttractorRef>&    GetAttractors   ( ) const { return _attractors; }
+        const std::vector<ObstacleRef>&     GetObstacles    ( ) const { return _obstacles; }
         
         const std::vector<ElementRef>&      GetElements     ( ) const { return _elements; }
-        std::vector<ElementRef>&            GetElements     ( ) { return _elements; }
         
         void                                AddElement      ( const ElementRef& element );
         ElementRef                          CreateElement   ( ElementType type );
+        
+        // Adds an instance of source, see Element::Instance. QueueInstance waits for the end of
+        // Inspect, for elements asking while the list is being drawn.
+        ElementRef                          CreateInstance  ( const ElementRef& source );
+        void                                QueueInstance   ( const ElementRef& source ) { _queuedInstance = source; }
         ElementRef                          FindElement     ( const std::string& name );
         
         void                                Inspect         ( );
+        
+        // Evaluates every property of the loaded scene at 60fps over the whole timeline, loops
+        // times, against the linear scan evaluation used to do. Blocks until done.
+        PropertyTiming                      BenchmarkProperties ( int loops ) const;
         void                                OnLoop          ( std::function<void()> handler ) { _loopHandler = handler; }
         
+        // Events are queued on channel as they fire and go out in the owner's next Flush, with the
+        // rest of the frame. Not owned, clear it before the channel goes away.
+        void                                SetOSCChannel   ( OSCChannel * channel ) { _oscChannel = channel; }
+        
+        inline std::size_t                  BakedSamples    ( ) const { return _bakedSamples; }
+        
         float                               Duration{20.0f};
+        float                               Rate{1.0f};     // Applied by StepBy. Slewed by clock sync on the slave.
+        float                               BakeRate{0.0f}; // Samples per second element properties are baked at, 0 evaluates keyframes
         
     protected:
         
         void                                OnLoop          ( );
         void                                FireEvents      ( );
+        void                                Bake            ( );
+        void                                Index           ( const ElementRef& element );
+        
+        static SceneRef                     ParseJson       ( const ci::fs::path& path );
+        static SceneRef                     ParseCompiled   ( const ci::fs::path& path );
         
         struct Event
         {
@@ -62,9 +132,24 @@ namespace Time
         
         std::vector<Event>                  _events;
         std::vector<ElementRef>             _elements;
+        std::vector<EmitterRef>             _emitters;
+        std::vector<AttractorRef>           _attractors;
+        std::vector<ObstacleRef>            _obstacles;
+        ElementRef                          _queuedInstance;
         float                               _time{0.0f};
-        OSCChannelRef                       _oscChannel;
+        OSCChannel *                        _oscChannel{nullptr};
         std::function<void()>               _loopHandler;
+        std::size_t                         _bakedSamples{0};
+        float                               _bakedRate{-1.0f};
+        uint32_t                            _bakedRevisions{0};     // PropertyRevisions at the last Bake
+    };
+    
+    struct Sequencer::Scene
+    {
+        float                               Duration{20.0f};
+        std::vector<ElementRef>             Elements;
+        std::vector<Event>                  Events;
+        ci::JsonTree                        Tree;               // Settings stored alongside the scene. The whole file for JSON.
     };
 }
 
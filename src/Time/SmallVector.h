@@ -0,0 +1,118 @@
+//
+//  SmallVector.h
+//  Fluid
+//
+//  A vector that keeps its first N elements inline, so the short lists that
+//  make up most of a scene never touch the heap. Past N it moves everything
+//  into a std::vector and stays there.
+//
+
+#ifndef Fluid_SmallVector_h
+#define Fluid_SmallVector_h
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Time
+{
+    // Only as much of the std::vector interface as the properties use. T must be default constructible.
+    template <typename T, std::size_t N>
+    class SmallVector
+    {
+    public:
+
+        using value_type            = T;
+        using iterator              = T *;
+        using const_iterator        = const T *;
+
+        inline std::size_t          size        ( ) const { return _size; }
+        inline bool                 empty       ( ) const { return _size == 0; }
+        inline bool                 IsInline    ( ) const { return !_spilled; }
+
+        inline T *                  data        ( ) { return _spilled ? _heap.data() : _inline.data(); }
+        inline const T *            data        ( ) const { return _spilled ? _heap.data() : _inline.data(); }
+
+        inline T&                   operator[]  ( std::size_t i ) { return data()[i]; }
+        inline const T&             operator[]  ( std::size_t i ) const { return data()[i]; }
+
+        inline T&                   front       ( ) { return data()[0]; }
+        inline const T&             front       ( ) const { return data()[0]; }
+        inline T&                   back        ( ) { return data()[_size - 1]; }
+        inline const T&             back        ( ) const { return data()[_size - 1]; }
+
+        inline iterator             begin       ( ) { return data(); }
+        inline iterator             end         ( ) { return data() + _size; }
+        inline const_iterator       begin       ( ) const { return data(); }
+        inline const_iterator       end         ( ) const { return data() + _size; }
+
+        template <typename ... Args>
+        T&                          emplace_back ( Args&& ... args )
+        {
+            if ( !_spilled && _size < N )
+            {
+                _inline[_size] = T ( std::forward<Args>( args )... );
+                return _inline[_size++];
+            }
+
+            if ( !_spilled ) Spill ( );
+            _heap.emplace_back ( std::forward<Args>( args )... );
+            _size++;
+            return _heap.back();
+        }
+
+        inline void                 push_back   ( const T& value ) { emplace_back ( value ); }
+
+        void                        pop_back    ( )
+        {
+            if ( _spilled ) _heap.pop_back();
+            else _inline[_size - 1] = T();
+            _size--;
+        }
+
+        iterator                    erase       ( const_iterator position )
+        {
+            std::size_t index = position - begin();
+            std::move ( begin() + index + 1, end(), begin() + index );
+            pop_back ( );
+            return begin() + index;
+        }
+
+        void                        resize      ( std::size_t size )
+        {
+            while ( _size < size ) emplace_back ( );
+            while ( _size > size ) pop_back ( );
+        }
+
+        void                        clear       ( ) { resize ( 0 ); }
+
+        template <typename Iterator>
+        void                        assign      ( Iterator first, Iterator last )
+        {
+            clear ( );
+            for ( ; first != last; ++first ) emplace_back ( *first );
+        }
+
+    protected:
+
+        void                        Spill       ( )
+        {
+            _heap.reserve ( N * 2 );
+            for ( std::size_t i = 0; i < _size; i++ )
+            {
+                _heap.push_back ( std::move ( _inline[i] ) );
+                _inline[i] = T();
+            }
+            _spilled = true;
+        }
+
+        std::array<T, N>            _inline;
+        std::vector<T>              _heap;
+        std::size_t                 _size{0};
+        bool                        _spilled{false};
+    };
+}
+
+#endif /* Fluid_SmallVector_h */